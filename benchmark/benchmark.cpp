@@ -0,0 +1,512 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <map>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <utils/format.h>
+#include <utils/log.h>
+
+using namespace std;
+using namespace utils::str;
+
+namespace {
+
+/**
+ * The number of timed runs of every benchmark, the reported time is the average of these.
+ */
+const int BENCHMARK_REPETITIONS = 5;
+
+/**
+ * The number of values formatted by each run of the numeric benchmarks.
+ */
+const size_t BENCHMARK_VALUE_COUNT = 200000;
+
+/**
+ * Prevents the compiler from removing the benchmarked work, every run adds the size of its output.
+ */
+volatile size_t benchmarkSink = 0;
+
+
+void BeginBenchmark(const char* description)
+{
+    cout << endl
+         << description << endl
+         << endl;
+}
+
+
+/**
+ * Runs a benchmark once to warm up, then BENCHMARK_REPETITIONS times while timing it, and reports the average time
+ * spent per value.
+ *
+ * @param[in] description  The description of the benchmark.
+ * @param[in] count  The number of values processed by a single run.
+ * @param[in] function  The benchmark, returning the number of characters it wrote.
+ */
+template <typename Function>
+void RunBenchmark(const char* description, size_t count, Function function)
+{
+    benchmarkSink += function();
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int repetition = 0; repetition < BENCHMARK_REPETITIONS; ++repetition) {
+        benchmarkSink += function();
+    }
+    const chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+
+    cout << "  " << left << setw(56) << description << right << setw(10) << fixed << setprecision(1)
+         << elapsed.count() / (BENCHMARK_REPETITIONS * count) << " ns/value" << endl;
+}
+
+
+/**
+ * Formats every value by FormatType with a single format specifier.
+ */
+size_t FormatEach(const vector<double>& values, const char* formatSpecifier)
+{
+    ostringstream output;
+    for (double value : values) {
+        FormatType(value, formatSpecifier, output);
+    }
+    return output.str().size();
+}
+
+
+/**
+ * Formats every value by a stream in fixed point or scientific notation, the way fixed precision values were written
+ * before they were formatted natively.
+ */
+size_t StreamEach(const vector<double>& values, ios_base::fmtflags notation, int precision, double scale)
+{
+    ostringstream output;
+    output.setf(notation, ios_base::floatfield);
+    output << setprecision(precision);
+    for (double value : values) {
+        output << value * scale;
+    }
+    return output.str().size();
+}
+
+
+/**
+ * Formats every string by FormatType with a single format specifier.
+ */
+template <typename String>
+size_t FormatStrings(const vector<String>& values, const char* formatSpecifier)
+{
+    ostringstream output;
+    for (const String& value : values) {
+        FormatType(value, formatSpecifier, output);
+    }
+    return output.str().size();
+}
+
+
+/**
+ * Benchmarks the fixed point and percentage presentation types on values typical for monitoring output, prices with
+ * two decimals, latencies in milliseconds with three decimals, and ratios written as percentages.
+ */
+void BenchmarkFixedPrecision()
+{
+    BeginBenchmark("Fixed precision formatting of monitoring values.");
+
+    mt19937_64 generator(42);
+    uniform_int_distribution<int> cents(1, 1000000);
+    lognormal_distribution<double> milliseconds(1.0, 1.5);
+    uniform_real_distribution<double> ratio(0.0, 1.0);
+
+    vector<double> prices;
+    vector<double> latencies;
+    vector<double> ratios;
+    for (size_t index = 0; index < BENCHMARK_VALUE_COUNT; ++index) {
+        prices.push_back(cents(generator) / 100.0);
+        latencies.push_back(milliseconds(generator));
+        ratios.push_back(ratio(generator));
+    }
+
+    const size_t count = BENCHMARK_VALUE_COUNT;
+    RunBenchmark("prices, {:.2f}", count, [&]() { return FormatEach(prices, ".2f"); });
+    RunBenchmark("prices, stream with std::fixed", count, [&]() { return StreamEach(prices, ios_base::fixed, 2, 1.0); });
+    RunBenchmark("prices, {:>12,.2f}", count, [&]() { return FormatEach(prices, ">12,.2f"); });
+    RunBenchmark("latencies, {:.3f}", count, [&]() { return FormatEach(latencies, ".3f"); });
+    RunBenchmark("latencies, stream with std::fixed", count, [&]() { return StreamEach(latencies, ios_base::fixed, 3, 1.0); });
+    RunBenchmark("ratios, {:.1%}", count, [&]() { return FormatEach(ratios, ".1%"); });
+    RunBenchmark("ratios, stream with std::fixed", count, [&]() { return StreamEach(ratios, ios_base::fixed, 1, 100.0); });
+    RunBenchmark("ratios, {:.12f} (exact engine)", count, [&]() { return FormatEach(ratios, ".12f"); });
+    RunBenchmark("latencies, FormatColumn {:.3f}", count, [&]() {
+        ostringstream output;
+        FormatColumn(latencies, ".3f", output);
+        return output.str().size();
+    });
+}
+
+
+/**
+ * Benchmarks the scientific presentation types on values typical for physics and telemetry output, spanning many
+ * orders of magnitude.
+ */
+void BenchmarkScientific()
+{
+    BeginBenchmark("Scientific notation formatting of measurements.");
+
+    mt19937_64 generator(42);
+    uniform_real_distribution<double> mantissa(1.0, 10.0);
+    uniform_int_distribution<int> exponent(-30, 30);
+
+    vector<double> measurements;
+    for (size_t index = 0; index < BENCHMARK_VALUE_COUNT; ++index) {
+        measurements.push_back(mantissa(generator) * pow(10.0, exponent(generator)));
+    }
+
+    const size_t count = BENCHMARK_VALUE_COUNT;
+    RunBenchmark("measurements, {:e}", count, [&]() { return FormatEach(measurements, "e"); });
+    RunBenchmark("measurements, stream with std::scientific", count, [&]() {
+        return StreamEach(measurements, ios_base::scientific, 6, 1.0);
+    });
+    RunBenchmark("measurements, {:.3E}", count, [&]() { return FormatEach(measurements, ".3E"); });
+    RunBenchmark("measurements, {:.16e}", count, [&]() { return FormatEach(measurements, ".16e"); });
+    RunBenchmark("measurements, {:.20e} (exact engine)", count, [&]() { return FormatEach(measurements, ".20e"); });
+    RunBenchmark("measurements, {} (shortest round trip)", count, [&]() { return FormatEach(measurements, ""); });
+    RunBenchmark("measurements, {:a}", count, [&]() { return FormatEach(measurements, "a"); });
+}
+
+
+/**
+ * Benchmarks formatting whole containers with a single format specifier, which is applied to every element.  The
+ * element by element loops show the cost of parsing the format specifier for every element.
+ */
+void BenchmarkContainers()
+{
+    BeginBenchmark("Formatting large containers.");
+
+    mt19937_64 generator(42);
+    lognormal_distribution<double> milliseconds(1.0, 1.5);
+    uniform_int_distribution<int> counts(-1000000, 1000000);
+
+    vector<double> latencies;
+    vector<int> integers;
+    map<int, double> latencyById;
+    for (size_t index = 0; index < BENCHMARK_VALUE_COUNT; ++index) {
+        latencies.push_back(milliseconds(generator));
+        integers.push_back(counts(generator));
+        latencyById[static_cast<int>(index)] = latencies.back();
+    }
+
+    const size_t count = BENCHMARK_VALUE_COUNT;
+    RunBenchmark("vector<double>, {:.3f}", count, [&]() {
+        ostringstream output;
+        FormatType(latencies, ".3f", output);
+        return output.str().size();
+    });
+    RunBenchmark("vector<double>, {:.3f}, CSV delimiters", count, [&]() {
+        ostringstream output;
+        FormatType(Delimit(latencies, GetCsvDelimiters()), ".3f", output);
+        return output.str().size();
+    });
+    RunBenchmark("vector<double>, element by element {:.3f}", count, [&]() { return FormatEach(latencies, ".3f"); });
+    RunBenchmark("vector<int>, {:>8}", count, [&]() {
+        ostringstream output;
+        FormatType(integers, ">8", output);
+        return output.str().size();
+    });
+    const size_t selectorCount = 10000;
+    RunBenchmark("vector<double>, Format(\"{0[123456]:.3f}\")", selectorCount, [&]() {
+        size_t size = 0;
+        for (size_t index = 0; index < selectorCount; ++index) {
+            size += Format("{0[123456]:.3f}", latencies).size();
+        }
+        return size;
+    });
+    RunBenchmark("vector<double>, Format(\"{:.3f}\", Limit(values, 10))", selectorCount, [&]() {
+        size_t size = 0;
+        for (size_t index = 0; index < selectorCount; ++index) {
+            size += Format("{:.3f}", Limit(latencies, 10)).size();
+        }
+        return size;
+    });
+    RunBenchmark("vector<double>, Format(\"{0[-5:]:.3f}\")", selectorCount, [&]() {
+        size_t size = 0;
+        for (size_t index = 0; index < selectorCount; ++index) {
+            size += Format("{0[-5:]:.3f}", latencies).size();
+        }
+        return size;
+    });
+    list<double> recent(latencies.begin(), latencies.begin() + 1000);
+    RunBenchmark("list<double>, Format(\"{0[10:20]:.3f}\")", selectorCount, [&]() {
+        size_t size = 0;
+        for (size_t index = 0; index < selectorCount; ++index) {
+            size += Format("{0[10:20]:.3f}", recent).size();
+        }
+        return size;
+    });
+    unordered_map<string, string> attributes;
+    for (int attribute = 0; attribute < 64; ++attribute) {
+        attributes[Format("attribute_{}", attribute)] = Format("value {}", attribute * 7);
+    }
+    RunBenchmark("unordered_map<string, string>, 3 key selectors", selectorCount, [&]() {
+        size_t size = 0;
+        for (size_t index = 0; index < selectorCount; ++index) {
+            size += Format("{0[attribute_3]} {0[attribute_42]:>12} {1[404]}", attributes, latencyById).size();
+        }
+        return size;
+    });
+    vector<array<double, 3>> positions;
+    vector<vector<double>> positionVectors;
+    vector<tuple<int, int, int>> colors;
+    for (size_t index = 0; index + 2 < latencies.size(); index += 3) {
+        positions.push_back({{latencies[index], latencies[index + 1], latencies[index + 2]}});
+        positionVectors.push_back({latencies[index], latencies[index + 1], latencies[index + 2]});
+        colors.push_back(make_tuple(integers[index] & 0xff, integers[index + 1] & 0xff, integers[index + 2] & 0xff));
+    }
+    RunBenchmark("vector<vector<double>> of 3, {:.3f}", positionVectors.size(), [&]() {
+        ostringstream output;
+        FormatType(positionVectors, ".3f", output);
+        return output.str().size();
+    });
+    RunBenchmark("vector<array<double, 3>>, {:.3f}", positions.size(), [&]() {
+        ostringstream output;
+        FormatType(positions, ".3f", output);
+        return output.str().size();
+    });
+    RunBenchmark("vector<tuple<int, int, int>>, {:3}", colors.size(), [&]() {
+        ostringstream output;
+        FormatType(colors, "3", output);
+        return output.str().size();
+    });
+    vector<map<string, double>> samples(latencies.size() / 4);
+    for (size_t index = 0; index < samples.size(); ++index) {
+        samples[index]["p50"] = latencies[index * 4];
+        samples[index]["p90"] = latencies[index * 4 + 1];
+        samples[index]["p99"] = latencies[index * 4 + 2];
+        samples[index]["max"] = latencies[index * 4 + 3];
+    }
+    RunBenchmark("vector<map<string, double>>, {:j:j:.3f}", samples.size(), [&]() {
+        ostringstream output;
+        FormatType(samples, "j:j:.3f", output);
+        return output.str().size();
+    });
+    RunBenchmark("map<int, double>, {:.3f}", count, [&]() {
+        ostringstream output;
+        FormatType(latencyById, ".3f", output);
+        return output.str().size();
+    });
+}
+
+
+/**
+ * Benchmarks formatting a large vector in parallel, from one thread up to one thread for every processor core, the
+ * output is the same for any number of threads.
+ */
+void BenchmarkParallel()
+{
+    BeginBenchmark("Formatting a large container in parallel.");
+
+    mt19937_64 generator(42);
+    lognormal_distribution<double> milliseconds(1.0, 1.5);
+
+    const size_t count = BENCHMARK_VALUE_COUNT * 20;
+    vector<double> latencies;
+    latencies.reserve(count);
+    for (size_t index = 0; index < count; ++index) {
+        latencies.push_back(milliseconds(generator));
+    }
+
+    const unsigned cores = max(thread::hardware_concurrency(), 1u);
+    for (unsigned threadCount = 1;; threadCount = min(threadCount * 2, cores)) {
+        const string description = Format("vector<double>, {{:.3f}}, {} thread(s)", threadCount);
+        RunBenchmark(description.c_str(), count, [&]() {
+            ostringstream output;
+            FormatTypeParallel(latencies, ".3f", output, threadCount);
+            return output.str().size();
+        });
+        if (threadCount == cores) {
+            break;
+        }
+    }
+}
+
+
+/**
+ * Benchmarks the time spent by the logging thread, when formatting log messages synchronously, and when capturing
+ * them for a DeferredLog to format on its background thread.
+ */
+void BenchmarkDeferredLog()
+{
+    BeginBenchmark("Logging messages, formatted synchronously or on a background thread.");
+
+    const size_t count = BENCHMARK_VALUE_COUNT / 10;
+    const char* const formatStr = "{:>8} order {} filled {:.4f} @ {:.2f}\n";
+    const string symbol = "ACME";
+
+    RunBenchmark("Format, 4 arguments", count, [&]() {
+        size_t size = 0;
+        for (size_t index = 0; index < count; ++index) {
+            size += Format(formatStr, symbol, index, index * 0.25, 101.5).size();
+        }
+        return size;
+    });
+
+    // The sink discards everything, the background thread still formats every message.
+    ostream discard(nullptr);
+    DeferredLog log(discard, 16 * 1024 * 1024);
+    RunBenchmark("DeferredLog::Log, 4 arguments", count, [&]() {
+        for (size_t index = 0; index < count; ++index) {
+            log.Log(formatStr, symbol, index, index * 0.25, 101.5);
+        }
+        return count;
+    });
+    RunBenchmark("DeferredLog::Log and Flush, 4 arguments", count, [&]() {
+        for (size_t index = 0; index < count; ++index) {
+            log.Log(formatStr, symbol, index, index * 0.25, 101.5);
+        }
+        log.Flush();
+        return count;
+    });
+}
+
+
+/**
+ * Benchmarks capturing log messages in a BinaryLog against formatting them to text, and compares the size of the
+ * binary log to the size of the text.
+ */
+void BenchmarkBinaryLog()
+{
+    BeginBenchmark("Logging messages in binary form, compared to text.");
+
+    const size_t count = BENCHMARK_VALUE_COUNT / 10;
+    const char* const formatStr = "{:>8} order {} filled {:.4f} @ {:.2f}, latency {} us\n";
+    const string symbol = "ACME";
+
+    RunBenchmark("Format, 5 arguments", count, [&]() {
+        size_t size = 0;
+        for (size_t index = 0; index < count; ++index) {
+            size += Format(formatStr, symbol, index, index * 0.25, 101.5, index % 97).size();
+        }
+        return size;
+    });
+
+    // The output discards everything, the log still collects every message in its buffer.
+    ostream discard(nullptr);
+    BinaryLog log(discard);
+    RunBenchmark("BinaryLog::Log, 5 arguments", count, [&]() {
+        for (size_t index = 0; index < count; ++index) {
+            log.Log(formatStr, symbol, index, index * 0.25, 101.5, index % 97);
+        }
+        return count;
+    });
+
+    ostringstream binary;
+    string text;
+    {
+        BinaryLog sizedLog(binary);
+        for (size_t index = 0; index < count; ++index) {
+            sizedLog.Log(formatStr, symbol, index, index * 0.25, 101.5, index % 97);
+            text += Format(formatStr, symbol, index, index * 0.25, 101.5, index % 97);
+        }
+    }
+    const size_t binarySize = binary.str().size();
+    cout << "  " << left << setw(56) << "Text log size" << right << setw(10) << text.size() << " bytes" << endl;
+    cout << "  " << left << setw(56) << "Binary log size" << right << setw(10) << binarySize << " bytes ("
+         << fixed << setprecision(1) << 100.0 * binarySize / text.size() << "%)" << endl;
+
+    RunBenchmark("DecodeBinaryLog, 5 arguments", count, [&]() {
+        istringstream input(binary.str());
+        ostringstream output;
+        DecodeBinaryLog(input, output);
+        return output.str().size();
+    });
+}
+
+
+/**
+ * Benchmarks strings typical for log output, short names padded into columns, and previews of large payloads where
+ * only the first few characters are written.
+ */
+void BenchmarkStrings()
+{
+    BeginBenchmark("String formatting of names and payload previews.");
+
+    mt19937_64 generator(42);
+    uniform_int_distribution<int> nameLength(3, 24);
+    uniform_int_distribution<int> letter('a', 'z');
+
+    vector<string> names;
+    for (size_t index = 0; index < BENCHMARK_VALUE_COUNT; ++index) {
+        string name(static_cast<size_t>(nameLength(generator)), ' ');
+        for (char& character : name) {
+            character = static_cast<char>(letter(generator));
+        }
+        names.push_back(name);
+    }
+
+    vector<string> multilingualNames;
+    const char* const syllables[] = {"na", "mé", "日本", "ñö", "ka", "Ωμ"};
+    uniform_int_distribution<int> syllable(0, 5);
+    for (size_t index = 0; index < BENCHMARK_VALUE_COUNT; ++index) {
+        string name;
+        for (int count = nameLength(generator) / 3; count >= 0; --count) {
+            name += syllables[syllable(generator)];
+        }
+        multilingualNames.push_back(name);
+    }
+
+    const size_t payloadCount = 1000;
+    vector<string> payloads(payloadCount, string(64 * 1024, 'x'));
+    vector<const char*> payloadPointers;
+    for (const string& payload : payloads) {
+        payloadPointers.push_back(payload.c_str());
+    }
+
+    const size_t count = BENCHMARK_VALUE_COUNT;
+    RunBenchmark("names, {}", count, [&]() { return FormatStrings(names, ""); });
+    RunBenchmark("names, {:<32}", count, [&]() { return FormatStrings(names, "<32"); });
+    RunBenchmark("names, {:*^32.8}", count, [&]() { return FormatStrings(names, "*^32.8"); });
+    RunBenchmark("UTF-8 names, {:<32}", count, [&]() { return FormatStrings(multilingualNames, "<32"); });
+    RunBenchmark("UTF-8 names, {:*^32.8}", count, [&]() { return FormatStrings(multilingualNames, "*^32.8"); });
+    RunBenchmark("UTF-8 names, {:j}", count, [&]() { return FormatStrings(multilingualNames, "j"); });
+    RunBenchmark("64 KiB payloads, {}", payloadCount, [&]() { return FormatStrings(payloads, ""); });
+    RunBenchmark("64 KiB payloads, Format(\"id={}: {}\")", payloadCount, [&]() {
+        size_t size = 0;
+        for (size_t index = 0; index < payloadCount; ++index) {
+            size += Format("id={}: {}", index, payloads[index]).size();
+        }
+        return size;
+    });
+    RunBenchmark("64 KiB payloads, {:j}", payloadCount, [&]() { return FormatStrings(payloads, "j"); });
+    RunBenchmark("64 KiB payloads, {:q}", payloadCount, [&]() { return FormatStrings(payloads, "q"); });
+    RunBenchmark("64 KiB payloads, std::string {:.64}", payloadCount, [&]() {
+        return FormatStrings(payloads, ".64");
+    });
+    RunBenchmark("64 KiB payloads, const char* {:.64}", payloadCount, [&]() {
+        return FormatStrings(payloadPointers, ".64");
+    });
+}
+
+}
+
+int main()
+{
+    cout << "Type safe string format" << endl
+         << endl
+         << "Benchmarking string format methods, build with optimizations for meaningful numbers." << endl;
+
+    BenchmarkFixedPrecision();
+    BenchmarkScientific();
+    BenchmarkContainers();
+    BenchmarkParallel();
+    BenchmarkStrings();
+    BenchmarkDeferredLog();
+    BenchmarkBinaryLog();
+
+    return 0;
+}
@@ -0,0 +1,1247 @@
+#include <bitset>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <locale>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <utils/format.h>
+
+using namespace std;
+using namespace utils::str;
+
+namespace {
+
+/**
+ * The number of values formatted with the same format specifier, every batch is formatted by FormatColumn on the fast
+ * side, and one value at a time by the reference kernels.
+ */
+const size_t BATCH_SIZE = 4096;
+
+/**
+ * The number of randomized values checked per kernel family when no count is given on the command line.
+ */
+const unsigned long long DEFAULT_VALUE_COUNT = 200000;
+
+/**
+ * The maximum number of mismatches reported in detail, all mismatches are counted.
+ */
+const int MAX_REPORTED_MISMATCHES = 20;
+
+
+//
+// Reference implementation
+//
+// The reference is the stream based implementation format.cpp used before the native kernels, carried over with only
+// the option characters spelled out: PreprocessStreamForInteger and PreprocessStreamForDecimal configure a stream from
+// the specifiers, the stream writes the value, and PostprocessStreamForInteger and PostprocessStreamForDecimal add the
+// padding the stream cannot do itself.  Later changes that deliberately moved away from this output are listed by
+// IsDocumentedChange, those cases are covered by the corpus instead.
+//
+
+/**
+ * Integer value that identifies that precision has not been specified.
+ */
+const int PRECISION_NOT_SET = -1;
+
+/**
+ * The maximum precision for doubles (unless overwritten manually).
+ */
+const streamsize DOUBLE_MAX_DEFAULT_PRECISION = 16;
+
+/**
+ * The minimum precision for double (that is always show one decimal.
+ */
+const streamsize DOUBLE_MIN_DEFAULT_PRECISION = 1;
+
+
+class AlwaysCommaAsThousandsSep
+    : public numpunct<char>
+{
+public:
+    /**
+     * Make sure we use , as thousands separator.
+     *
+     * @return Returns , since this is the character we wish to use for thousands separation.
+     */
+    char do_thousands_sep() const
+    {
+        return ',';
+    }
+
+    /**
+     * Make sure we use . as decimal separator.
+     *
+     * @return Returns . since this is the character we wish to use for decimal separation.
+     */
+    char do_decimal_point() const
+    {
+        return '.';
+    }
+
+    /**
+     * Specify that we wish the thousands separator to be placed every three digits.
+     *
+     * @return Returns a string where the first character is character with binary value 3, this indicate the group
+     *         size. Should be set already, but we want to be absolutely certain no matter the locale.
+     */
+    string do_grouping() const
+    {
+        return "\3";
+    }
+};
+
+
+/**
+ * Code inspired by Stack Overflow: http://stackoverflow.com/a/18652393/111143
+ */
+struct FormatDynamicDecimal
+{
+    const long double precision;
+    const long double value;
+    const streamsize scientificLimit = 5;
+    const streamsize scientificCeil;
+    const streamsize maxPrecision;
+    const streamsize minPrecision;
+
+    FormatDynamicDecimal(long double value, streamsize minPrecision, streamsize maxPrecision, streamsize scientificCeil)
+        : precision(sqrt(numeric_limits<double>::epsilon())), value(value), scientificCeil(scientificCeil),
+          maxPrecision(maxPrecision), minPrecision(minPrecision)
+    {
+    }
+
+    friend ostream& operator << (ostream& stream, const FormatDynamicDecimal& rhs)
+    {
+        // We use n to calculate and store the precision to use.
+        streamsize n = 0;
+        // The calculated log10 of the value in an int version.
+        unsigned intLogVersion = 0;
+        // The number integer digits in the value.
+        unsigned intDigits = 0;
+        // Whether or not the value is above the scientific ceil value, this is whether the absolute value is so large
+        // that it must be written using scientific notation.
+        bool aboveScientificCeil = false;
+        // The absolute integer version of the number, we use the abs value to avoid having to deal with the sign
+        // character.
+        unsigned long long intVersion = static_cast<unsigned long long>(abs(rhs.value));
+        // By default we use fixed notation and control the number of digits to write, based on our calculations.
+        ios_base::fmtflags newFlags = ios_base::fixed;
+
+        // If the number is not 0, then we might need to use scientific notation because the number is too large.
+        // Besides calculating the log10 of the value only makes sense for values larger than 0.
+        if (intVersion > 0) {
+            intLogVersion = static_cast<unsigned>(log10(abs(rhs.value)));
+            // The number integer digits is the log10 integer value plus 1 since the log10 is the exponent needed in a
+            // y = 10 ^ exp to calculate the value y.
+            intDigits = intLogVersion + 1;
+            // We only see the value as above scientific ceil if the scientific ceil is larger than 0.
+            aboveScientificCeil = (intDigits > rhs.scientificCeil) && (rhs.scientificCeil > 0);
+        }
+        // If the number is above the scientific ceil value we calculate the number of trailing zeroes, these are the
+        // digits we can safely avoid writing and thus shouldn't be included in the calculated precision. Note: if we
+        // are above the scientific ceil, we will drop the decimal values, since they are considered insignificant.
+        // The number 1000 would have 3 trailing zeroes and the number 10100 would have 2.
+        if (aboveScientificCeil) {
+            streamsize trailingZeroes = 0;
+            if (intVersion > 0) {
+                for (unsigned factor = 10; (intVersion % factor) == 0; factor *= 10) {
+                    ++trailingZeroes;
+                }
+            }
+            // There is no need to consider the tailing zeroes in the precision we use, so we subtract them from it.
+            n = intLogVersion - trailingZeroes;
+        }
+        else if (intDigits < rhs.maxPrecision) {
+            // Leading zeroes is the number of zeroes after the decimal sign before any other significant digit,
+            // leading zeroes is always 0 if the integer value is above 0.
+            int leadingZeroes = 0;
+            // Remember leading zeroes only makes sense when the integer version of the number is 0. This variable is
+            // used to store when we are processing a digit that is a leading zero or not.
+            bool inLeadingZeroes = intVersion == 0;
+            // This is the value that is left when we subtract the truncated value, this is used to check if we have
+            // processed all digits. We check the value against our precision which is a small enough value that it
+            // should be capable of detecting when we have reached the last digit.
+            long double f = abs(rhs.value - trunc(rhs.value));
+            while (rhs.precision < f) {
+                // Multiply by 10 so we can extract the actual digit.
+                f *= 10;
+                if (inLeadingZeroes && trunc(f) < rhs.precision) {
+                    ++leadingZeroes;
+                }
+                else {
+                    inLeadingZeroes = false;
+                }
+                // Remove this digit so we can extract the next.
+                f -= trunc(f);
+                // Since this as a significant digit (or a leading zero) we should increase the required precision.
+                ++n;
+            }
+            // The precision we have found should not be any less than the minimum precision, the format string may
+            // have specified that we should display at least a number of digits, and so we must respect that.
+            n = max(n, rhs.minPrecision);
+
+            // If the number of digits we have found is above the scientific limit and we have leading zeroes we should
+            // use scientific notation, and discard the leading zeroes, we know n will be larger than the number of
+            // leading zeroes so we can safely subtract them. We subtract one so we have atleast the one digit before
+            // the decimal point.
+            if (n >= rhs.scientificLimit && leadingZeroes > 0) {
+                newFlags = ios_base::scientific;
+                n -= leadingZeroes + 1;
+            }
+        }
+
+        // We do not want to use more than at most the maximum specified precision, so adjust down to it if needed.
+        n = min(n, rhs.maxPrecision);
+        if (aboveScientificCeil) {
+            // Since we are above the scientific ceil we should use scientific notation.
+            newFlags = ios_base::scientific;
+            // If we have reached the max precision we need to remove one, since scientific notation takes up one.
+            if (n == rhs.maxPrecision) {
+                --n;
+            }
+        }
+        else if (intDigits + n > rhs.maxPrecision) {
+            // The number of integer digits plus the precision we strive to use, is more than the maximum precision,
+            // so there is not enough digits to show the integer with the digits. We need to cut off a few digits,
+            // since we obviously value the integer part more than the decimal part, we will attempt to keep that part
+            // and cut decimals off as required.
+            if (intDigits < n) {
+                n -= intDigits;
+            }
+            else {
+                n = 0;
+            }
+        }
+        // Set the precision and flags, storing the old ones, write the value and be a good boy and restore the
+        // originals.
+        n = stream.precision(n);
+        ios_base::fmtflags oldFlags = stream.setf(newFlags, ios_base::floatfield);
+        stream << rhs.value;
+        stream.flags(oldFlags);
+        stream.precision(n);
+
+        return stream;
+    }
+};
+
+
+/**
+ * Prepares the stream for writing a decimal number, see PreprocessStreamForDecimal in format.cpp before the native
+ * kernels.
+ */
+void PreprocessStreamForDecimal(const BasicFormatSpecifiers& specifiers, ostream& ostr, long double& value,
+        bool& useValue, bool& useDynamic, streamsize& minPrecision, streamsize& maxPrecision,
+        streamsize& scientificCeil)
+{
+    // By default use the value.
+    useValue = true;
+
+    // By default use dynamic notation
+    useDynamic = true;
+
+    // By default do not use the scientific ceil, that is upper limit for switching to scientific notation
+    scientificCeil = 0;
+
+    // The default minimum precision to use
+    minPrecision = 1;
+
+    // Set the minimum width of the output
+    ostr << setw(specifiers.width);
+
+    // Set the fill character if it needs to be set
+    if (specifiers.fill) {
+        ostr << setfill(specifiers.fill);
+    }
+
+    // Set the precision
+    if (specifiers.precision >= 0) {
+        ostr << setprecision(specifiers.precision);
+    }
+
+    // If thousands separator is set imbue a locale, since the PEP-3101 dictates that the thousands separator should
+    // be a ',' we use a custom numpunct class reporting the thousands separator as a comma.
+    if (specifiers.thousandSeparator) {
+        locale loc(ostr.getloc(), new AlwaysCommaAsThousandsSep);
+        ostr.imbue(loc);
+    }
+
+    switch (specifiers.sign) {
+        // Nothing really needs to be done for this, this is default behavior, show a sign character for negatives
+        // only.
+        case '-':
+            break;
+
+        // When setting the sign character to +, numbers will always have a sign of either + or -. Negative numbers
+        // will have a - sign, and 0 and positive numbers will have a +.
+        case '+':
+            ostr << showpos;
+            break;
+
+        // Like with +, this will always show a sign character, however the sign character for 0 or positive numbers
+        // will be a space. This sets the width of the stream to 0, as it requires some post processing, it is simply
+        // not supported directly by the underlying stream.
+        case ' ':
+            ostr << setw(0);
+            break;
+
+        // Ignore unknown sign characters.
+        default:
+            break;
+    }
+
+    switch (specifiers.align) {
+        // Will align the value to the left:
+        // [-xxxx    ]
+        case '<':
+            ostr << left;
+            break;
+
+        // Will align the value to the right, and the sign to the left:
+        // [-    xxxx]
+        case '=':
+            ostr << internal;
+            break;
+
+        // Will center the value and sign:
+        // [  -xxxx  ]
+        case '^':
+            // This needs to be processed afterwards, for now make sure we only have the raw data
+            ostr << setw(0);
+            break;
+
+        // Will align the value to the right:
+        // [    -xxxx]
+        case '>':
+        default:
+            ostr << right;
+    }
+
+    switch (specifiers.type) {
+        case 'E':
+            ostr << uppercase;
+            // fall through
+        case 'e':
+            if (specifiers.precision == PRECISION_NOT_SET) {
+                useDynamic = false;
+                ostr << setprecision(6);
+            }
+            ostr << scientific;
+            break;
+
+        case 'G':
+            ostr << uppercase;
+            // fall through
+        case 'g':
+            {
+                minPrecision = 0;
+                maxPrecision = 6;
+                scientificCeil = 6;
+            }
+            break;
+
+        case 'n':
+            {
+                minPrecision = 0;
+                maxPrecision = 6;
+                scientificCeil = 6;
+                ostr.imbue(locale(""));
+            }
+            break;
+
+        case '%':
+            value *= 100.0;
+            // fall through
+        case 'F':
+            ostr << uppercase;
+            // fall through
+        case 'f':
+            if (specifiers.precision == PRECISION_NOT_SET) {
+                useDynamic = false;
+                ostr << setprecision(6);
+            }
+            ostr << fixed;
+            break;
+
+        // Ordinary decimal number
+        case 'd':
+        default:
+            break;
+    }
+}
+
+
+/**
+ * Pads a decimal number written by the stream, see PostprocessStreamForDecimal in format.cpp before the native
+ * kernels.
+ *
+ * [left padding][sign][type][fill][written string][right padding]
+ */
+void PostprocessStreamForDecimal(string&& writtenString, const BasicFormatSpecifiers& specifiers, ostream& ostr,
+        const long double& value)
+{
+    int contentWidth = static_cast<int>(writtenString.size());
+    bool addPadding = (specifiers.sign == ' ' || specifiers.align == '^');
+    char fillCharToUse = specifiers.fill ? specifiers.fill : ' ';
+
+    // If the sign is a space, we should make room for it in the calculations, it has not been added to the
+    // writtenString yet.
+    if (specifiers.sign == ' ' && value >= 0) {
+        ++contentWidth;
+    }
+    else if (specifiers.sign == ' ' && value < 0 && specifiers.align == '=') {
+        // Remove sign, we do not need to add to contentWidth here since the sign was included.
+        writtenString.erase(0, 1);
+    }
+
+    // If the number should be prefixed with the base (0b, 0o, 0x, 0X) make room for it.
+    if (specifiers.alternateForm && strchr("boxX", specifiers.type) != nullptr) {
+        contentWidth += 2;
+    }
+
+    // Calculate the paddings: [left][sign][center][value][right]
+    int paddingLeft = 0;
+    int paddingCenter = 0;
+    int paddingRight = 0;
+    if (addPadding) {
+        switch (specifiers.align) {
+            case '<':
+                paddingRight = specifiers.width - contentWidth;
+                break;
+
+            case '^':
+                paddingLeft = (specifiers.width - contentWidth) / 2;
+                paddingRight = specifiers.width - paddingLeft - contentWidth;
+                break;
+
+            case '=':
+                paddingCenter = specifiers.width - contentWidth;
+                break;
+
+            case '>':
+            default:
+                paddingLeft = specifiers.width - contentWidth;
+                break;
+        }
+    }
+
+    // Add the left padding if any.
+    if (addPadding && paddingLeft > 0) {
+        ostr << setw(paddingLeft) << setfill(fillCharToUse) << fillCharToUse << setw(0) << setfill('\0');
+    }
+
+    // Write the sign characters.
+    if (specifiers.sign == ' ' && value >= 0) {
+        ostr << ' ';
+    }
+    else if (specifiers.sign == ' ' && value < 0 && specifiers.align == '=') {
+        ostr << '-';
+    }
+
+    // Add the center padding if any.
+    if (addPadding && paddingCenter > 0) {
+        ostr << setw(paddingCenter) << setfill(fillCharToUse) << fillCharToUse << setw(0) << setfill('\0');
+    }
+
+    // If alternate form, prefix with the base.
+    if (specifiers.alternateForm) {
+        switch (specifiers.type) {
+            case 'b':
+                ostr << "0b";
+                break;
+
+            case 'o':
+                ostr << "0o";
+                break;
+
+            case 'x':
+                ostr << "0x";
+                break;
+
+            case 'X':
+                ostr << "0X";
+                break;
+
+            default:
+                // Ignore unknown alternate forms
+                break;
+        }
+    }
+
+    // Write the value.
+    ostr << writtenString;
+
+    if (specifiers.type == '%') {
+        ostr << '%';
+    }
+
+    // Add the right padding.
+    if (addPadding && paddingRight > 0) {
+        ostr << setw(paddingRight) << setfill(fillCharToUse) << fillCharToUse;
+    }
+}
+
+
+/**
+ * Prepares the stream for writing an integer, see PreprocessStreamForInteger in format.cpp before the native kernels.
+ */
+void PreprocessStreamForInteger(const BasicFormatSpecifiers& specifiers, ostream& ostr, long long& value,
+        bool& useValue)
+{
+    // By default use the value.
+    useValue = true;
+
+    // Set the minimum width of the output
+    ostr << setw(specifiers.width);
+
+    // Set the fill character if it needs to be set
+    if (specifiers.fill) {
+        ostr << setfill(specifiers.fill);
+    }
+
+    // If thousands separator is set imbue a locale, since the PEP-3101 dictates that the thousands separator should
+    // be a ',' we use a custom numpunct class reporting the thousands separator as a comma.
+    if (specifiers.thousandSeparator) {
+        locale loc(ostr.getloc(), new AlwaysCommaAsThousandsSep);
+        ostr.imbue(loc);
+    }
+
+    switch (specifiers.sign) {
+        // Nothing really needs to be done for this, this is default behavior, show a sign character for negatives
+        // only.
+        case '-':
+            break;
+
+        // When setting the sign character to +, numbers will always have a sign of either + or -. Negative numbers
+        // will have a - sign, and 0 and positive numberes will have a +.
+        case '+':
+            ostr << showpos;
+            break;
+
+        // Like with +, this will always show a sign character, however the sign character for 0 or positive numbers
+        // will be a space. This sets the width of the stream to 0, as it requires some post processing, it is simply
+        // not supported directly by the underlying stream.
+        case ' ':
+            ostr << setw(0);
+            break;
+
+        // Ignore unkown sign character settings.
+        default:
+            break;
+    }
+
+    switch (specifiers.align) {
+        // Will align the value to the left:
+        // [-xxxx    ]
+        case '<':
+            ostr << left;
+            break;
+
+        // Will align the value to the right, and the sign to the left:
+        // [-    xxxx]
+        case '=':
+            ostr << internal;
+            break;
+
+        // Will center the value and sign:
+        // [  -xxxx  ]
+        case '^':
+            // This needs to be processed afterwards, for now make sure we only have the raw data
+            ostr << setw(0);
+            break;
+
+        // Will align the value to the right:
+        // [    -xxxx]
+        case '>':
+        default:
+            ostr << right;
+    }
+
+    switch (specifiers.type) {
+        // Write number as binary number (skip leading zeroes).
+        case 'b':
+            {
+                // Generally this needs to be done later
+                ostr << noshowpos;
+                // Use the bitset's built in to string method
+                bitset<64> helper{static_cast<unsigned long long>(value)};
+                string binaryString = helper.to_string();
+                // Find first significant bit, 63 since we show at least one bit
+                int index = 0;
+                while (index < 63 && binaryString[index] == '0') {
+                    ++index;
+                }
+                ostr << (binaryString.c_str() + index);
+                // Since we have already output the value, let's not do it again
+                useValue = false;
+            };
+            break;
+
+        // Print the number in octal format
+        case 'o':
+            ostr << oct;
+            break;
+
+        // Print the number in hex format using upper case letters (A-Z) and apparently (found out through tests in
+        // Python 3.3.2) also upper case 0X.
+        case 'X':
+            // Hex format
+            ostr << uppercase;
+            // fall through
+        case 'x':
+            ostr << hex;
+            break;
+
+        // Print the number in the localized version, using the thousands separator character of the locale.
+        case 'n':
+            ostr.imbue(locale(""));
+            break;
+
+        // Ordinary integer number
+        case 'd':
+        default:
+            break;
+    }
+}
+
+
+/**
+ * Pads an integer written by the stream, see PostprocessStreamForInteger in format.cpp before the native kernels.
+ *
+ * [left padding][sign][type][fill][written string][right padding]
+ */
+void PostprocessStreamForInteger(string&& writtenString, const BasicFormatSpecifiers& specifiers, ostream& ostr,
+        const long long& value)
+{
+    int contentWidth = static_cast<int>(writtenString.size());
+    bool addPadding = (specifiers.sign == ' ' || specifiers.align == '^');
+    char fillCharToUse = specifiers.fill ? specifiers.fill : ' ';
+
+    // If the sign is a space, we should make room for it in the calculations, it has not been added to the
+    // writtenString yet.
+    if (specifiers.sign == ' ' && value >= 0) {
+        ++contentWidth;
+    }
+    else if (specifiers.sign == ' ' && value < 0 && specifiers.align == '=') {
+        // Remove sign, we do not need to add to contentWidth here since the sign was included.
+        writtenString.erase(0, 1);
+    }
+
+    // If the number should be prefixed with the base (0b, 0o, 0x, 0X) make room for it.
+    if (specifiers.alternateForm && strchr("boxX", specifiers.type) != nullptr) {
+        contentWidth += 2;
+    }
+
+    // Calculate the paddings: [left][sign][center][value][right]
+    int paddingLeft = 0;
+    int paddingCenter = 0;
+    int paddingRight = 0;
+    if (addPadding) {
+        switch (specifiers.align) {
+            case '<':
+                paddingRight = specifiers.width - contentWidth;
+                break;
+
+            case '^':
+                paddingLeft = (specifiers.width - contentWidth) / 2;
+                paddingRight = specifiers.width - paddingLeft - contentWidth;
+                break;
+
+            case '=':
+                paddingCenter = specifiers.width - contentWidth;
+                break;
+
+            case '>':
+            default:
+                paddingLeft = specifiers.width - contentWidth;
+                break;
+        }
+    }
+
+    // Add the left padding if any.
+    if (addPadding && paddingLeft > 0) {
+        ostr << setw(paddingLeft) << setfill(fillCharToUse) << fillCharToUse << setw(0) << setfill('\0');
+    }
+
+    // Write the sign characters.
+    if (specifiers.sign == ' ' && value >= 0) {
+        ostr << ' ';
+    }
+    else if (specifiers.sign == ' ' && value < 0 && specifiers.align == '=') {
+        ostr << '-';
+    }
+
+    // Add the center padding if any.
+    if (addPadding && paddingCenter > 0) {
+        ostr << setw(paddingCenter) << setfill(fillCharToUse) << fillCharToUse << setw(0) << setfill('\0');
+    }
+
+    // If alternate form, prefix with the base.
+    if (specifiers.alternateForm) {
+        switch (specifiers.type) {
+            case 'b':
+                ostr << "0b";
+                break;
+
+            case 'o':
+                ostr << "0o";
+                break;
+
+            case 'x':
+                ostr << "0x";
+                break;
+
+            case 'X':
+                ostr << "0X";
+                break;
+
+            default:
+                // Ignore unknown alternate forms.
+                break;
+        }
+    }
+
+    // Write the value.
+    ostr << writtenString;
+
+    // Add the right padding.
+    if (addPadding && paddingRight > 0) {
+        ostr << setw(paddingRight) << setfill(fillCharToUse) << fillCharToUse;
+    }
+}
+
+
+/**
+ * Formats an integer the way FormatType(long long) did before the native kernels.
+ */
+void ReferenceInteger(long long value, const BasicFormatSpecifiers& specifiers, ostream& output)
+{
+    bool useValue = true;
+    stringstream buffer;
+    PreprocessStreamForInteger(specifiers, buffer, value, useValue);
+    if (useValue) {
+        buffer << value;
+    }
+    PostprocessStreamForInteger(buffer.str(), specifiers, output, value);
+}
+
+
+/**
+ * Formats a decimal number the way FormatType(long double) did before the native kernels, float and double were
+ * widened to long double.
+ */
+void ReferenceDecimal(long double value, const BasicFormatSpecifiers& specifiers, ostream& output)
+{
+    bool useValue = true;
+    bool useDynamic = true;
+    streamsize minPrecision = DOUBLE_MIN_DEFAULT_PRECISION;
+    streamsize maxPrecision = DOUBLE_MAX_DEFAULT_PRECISION;
+    streamsize scientificCeil = 0;
+    stringstream buffer;
+    PreprocessStreamForDecimal(specifiers, buffer, value, useValue, useDynamic, minPrecision, maxPrecision,
+                               scientificCeil);
+    if (useValue) {
+        if (useDynamic && specifiers.precision == PRECISION_NOT_SET) {
+            FormatDynamicDecimal fdd(value, minPrecision, maxPrecision, scientificCeil);
+            buffer << fdd;
+        }
+        else {
+            buffer << value;
+        }
+    }
+    PostprocessStreamForDecimal(buffer.str(), specifiers, output, value);
+}
+
+
+/**
+ * Formats a float or double with the hexadecimal presentation types 'a' and 'A' by printf, the stream code did not
+ * have these.
+ */
+void ReferenceHexadecimal(double value, const BasicFormatSpecifiers& specifiers, ostream& output)
+{
+    string format = "%";
+    if (specifiers.align == '<') {
+        format += '-';
+    }
+    if (specifiers.sign == '+' || specifiers.sign == ' ') {
+        format += specifiers.sign;
+    }
+    if (specifiers.alternateForm) {
+        format += '#';
+    }
+    if (specifiers.align == '=') {
+        format += '0';
+    }
+    format += "*.*";
+    format += specifiers.type;
+    char written[128];
+    snprintf(written, sizeof(written), format.c_str(), specifiers.width, specifiers.precision, value);
+    output << written;
+}
+
+
+/**
+ * Formats a float or double by the stream code, or by printf for the hexadecimal presentation types.
+ */
+template <typename F>
+void ReferenceFloatingPoint(F value, const BasicFormatSpecifiers& specifiers, ostream& output)
+{
+    if (specifiers.type == 'a' || specifiers.type == 'A') {
+        ReferenceHexadecimal(value, specifiers, output);
+    }
+    else {
+        ReferenceDecimal(value, specifiers, output);
+    }
+}
+
+
+//
+// Randomized comparison
+//
+
+/**
+ * The results of comparing a kernel family, the fast side against the reference side.
+ */
+struct Comparison
+{
+    const char* name;
+    unsigned long long values = 0;
+    // The values not compared, see IsDocumentedChange.
+    unsigned long long documented = 0;
+    unsigned long long mismatches = 0;
+    double fastNanoseconds = 0;
+    double referenceNanoseconds = 0;
+
+    explicit Comparison(const char* name)
+        : name(name)
+    {
+    }
+};
+
+
+int reportedMismatches = 0;
+
+
+/**
+ * Whether the output for an integer deliberately differs from the reference, these cases are not compared:
+ *  - Values above the range of long long, the reference has no unsigned path.
+ *  - A '#' with a width, the prefix of b, o, x and X now counts towards the width, and no type no longer reserves
+ *    room for a prefix it does not write.
+ *  - The space sign of a negative b, o, x or X value aligned by '=', the old post processing replaced the first
+ *    two's complement digit by a '-'.
+ */
+template <typename T>
+bool IsDocumentedChange(T value, const BasicFormatSpecifiers& specifiers)
+{
+    const bool twosComplement = specifiers.type && strchr("boxX", specifiers.type) != nullptr;
+    return (value > 0 && static_cast<unsigned long long>(value) > static_cast<unsigned long long>(LLONG_MAX)) ||
+           (specifiers.alternateForm && specifiers.width > 0 && (twosComplement || !specifiers.type)) ||
+           (specifiers.sign == ' ' && specifiers.align == '=' && value < 0 && twosComplement);
+}
+
+
+/**
+ * Whether the output for a float or double deliberately differs from the reference, these cases are not compared,
+ * the Python corpus covers them instead:
+ *  - No precision with no type, 'g', 'G' or 'n', these write the shortest round trip digits.
+ *  - NaN, which is written without a sign.
+ *  - A '#', which keeps the decimal point, and the trailing zeroes of the general formats.
+ *  - '%' with a width, the '%' now counts towards the width, and -0.0 with a space sign, which no longer gets an
+ *    extra space.
+ *
+ * The hexadecimal types 'a' and 'A' are compared against printf, except for NaN, for zero padded infinity, which
+ * printf pads with spaces, and for the layouts printf cannot write: other fills than spaces, centering, and '=' other
+ * than zero padding.
+ */
+template <typename F>
+bool IsDocumentedFloatingPointChange(F value, const BasicFormatSpecifiers& specifiers)
+{
+    const char type = specifiers.type;
+    if (type == 'a' || type == 'A') {
+        const bool spaces = (!specifiers.fill || specifiers.fill == ' ') && specifiers.align != '^' &&
+                            specifiers.align != '=';
+        return isnan(value) || (isinf(value) && specifiers.align == '=') ||
+               !(spaces || (specifiers.fill == '0' && specifiers.align == '='));
+    }
+    return (specifiers.precision == PRECISION_NOT_SET && (!type || strchr("gGn", type) != nullptr)) ||
+           isnan(value) || specifiers.alternateForm ||
+           (type == '%' && specifiers.width > 0) || (specifiers.sign == ' ' && value == 0 && signbit(value));
+}
+
+
+bool IsDocumentedChange(float value, const BasicFormatSpecifiers& specifiers)
+{
+    return IsDocumentedFloatingPointChange(value, specifiers);
+}
+
+
+bool IsDocumentedChange(double value, const BasicFormatSpecifiers& specifiers)
+{
+    return IsDocumentedFloatingPointChange(value, specifiers);
+}
+
+
+template <typename T>
+string DescribeValue(T value)
+{
+    return to_string(value);
+}
+
+string DescribeValue(float value)
+{
+    ostringstream stream;
+    stream << hexfloat << value << " (" << setprecision(9) << defaultfloat << value << ")";
+    return stream.str();
+}
+
+string DescribeValue(double value)
+{
+    ostringstream stream;
+    stream << hexfloat << value << " (" << setprecision(17) << defaultfloat << value << ")";
+    return stream.str();
+}
+
+
+void ReportMismatch(const char* name, const string& value, const string& specifier, const string& fast,
+        const string& reference)
+{
+    if (reportedMismatches++ < MAX_REPORTED_MISMATCHES) {
+        cout << "  MISMATCH " << name << " " << value << " with '" << specifier << "'" << endl
+             << "    fast:      [" << fast << "]" << endl
+             << "    reference: [" << reference << "]" << endl;
+    }
+}
+
+
+/**
+ * Parses a format specifier with the default values format.cpp uses, precision not set, no fill or alignment, and
+ * '-' as sign.
+ */
+BasicFormatSpecifiers ParseSpecifier(const string& specifier)
+{
+    BasicFormatSpecifiers specifiers;
+    specifiers.precision = PRECISION_NOT_SET;
+    specifiers.width = 0;
+    specifiers.align = '\0';
+    specifiers.fill = '\0';
+    specifiers.sign = '-';
+    specifiers.type = '\0';
+    specifiers.alternateForm = false;
+    specifiers.thousandSeparator = false;
+    int pos = 0;
+    ConvertToBasicFormatSpecifiers(specifier.c_str(), specifiers, pos);
+    return specifiers;
+}
+
+
+/**
+ * Formats a batch of values with one format specifier by both sides, timing them, and compares the outputs line by
+ * line.  Values for which IsDocumentedChange is true are formatted by both sides, but not compared.
+ */
+template <typename T, typename Reference>
+void CompareBatch(const vector<T>& values, const string& specifier, Reference reference, Comparison& comparison)
+{
+    const BasicFormatSpecifiers specifiers = ParseSpecifier(specifier);
+
+    const chrono::steady_clock::time_point fastStart = chrono::steady_clock::now();
+    ostringstream fastStream;
+    FormatColumn(values.data(), values.size(), specifier.c_str(), fastStream, "\n");
+    const string fast = fastStream.str();
+    const chrono::steady_clock::time_point fastEnd = chrono::steady_clock::now();
+
+    ostringstream expectedStream;
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i > 0) {
+            expectedStream << '\n';
+        }
+        reference(values[i], specifiers, expectedStream);
+    }
+    const string expected = expectedStream.str();
+    const chrono::steady_clock::time_point referenceEnd = chrono::steady_clock::now();
+
+    comparison.fastNanoseconds += chrono::duration<double, nano>(fastEnd - fastStart).count();
+    comparison.referenceNanoseconds += chrono::duration<double, nano>(referenceEnd - fastEnd).count();
+
+    istringstream fastLines(fast);
+    istringstream expectedLines(expected);
+    string fastLine;
+    string expectedLine;
+    for (size_t i = 0; i < values.size(); ++i) {
+        getline(fastLines, fastLine);
+        getline(expectedLines, expectedLine);
+        if (IsDocumentedChange(values[i], specifiers)) {
+            ++comparison.documented;
+            continue;
+        }
+        ++comparison.values;
+        if (fastLine != expectedLine) {
+            ++comparison.mismatches;
+            ReportMismatch(comparison.name, DescribeValue(values[i]), specifier, fastLine, expectedLine);
+        }
+    }
+}
+
+
+/**
+ * Generates a random format specifier from the layout options and the given presentation types.
+ */
+string RandomSpecifier(mt19937_64& generator, const string& types, bool floatingPoint)
+{
+    const char* const layouts[] = {"", "", "<", ">", "^", "=", "*<", "*>", "*^", "_=", "0>", " ^"};
+    const char* const signs[] = {"", "", "+", "-", " "};
+    string specifier = layouts[generator() % (sizeof(layouts) / sizeof(layouts[0]))];
+    specifier += signs[generator() % (sizeof(signs) / sizeof(signs[0]))];
+    if (generator() % 3 == 0) {
+        specifier += '#';
+    }
+    if (specifier.find_first_of("<>=^") == string::npos && generator() % 4 == 0) {
+        specifier += '0';
+    }
+    if (generator() % 2 == 0) {
+        specifier += to_string(generator() % 30);
+    }
+
+    const char type = types[generator() % types.size()];
+    if (type != 'n' && type != 'b' && generator() % 4 == 0) {
+        specifier += ',';
+    }
+    if (floatingPoint && generator() % 3 != 0) {
+        specifier += "." + to_string(generator() % 21);
+    }
+    if (type != ' ') {
+        specifier += type;
+    }
+    return specifier;
+}
+
+
+/**
+ * Generates a random integer, either random bits, a small value, or a value near a power of two or ten.
+ */
+template <typename T>
+T RandomInteger(mt19937_64& generator)
+{
+    typedef typename make_unsigned<T>::type Unsigned;
+    const unsigned long long bits = generator();
+    switch (generator() % 4) {
+        case 0:
+            return static_cast<T>(static_cast<Unsigned>(bits));
+
+        case 1:
+            return static_cast<T>(static_cast<long long>(bits % 2001) - 1000);
+
+        case 2:
+            {
+                const int shift = static_cast<int>(generator() % numeric_limits<Unsigned>::digits);
+                return static_cast<T>((static_cast<Unsigned>(1) << shift) + static_cast<Unsigned>(bits % 3) - 1);
+            }
+
+        default:
+            {
+                Unsigned power = 1;
+                for (unsigned long long i = generator() % numeric_limits<Unsigned>::digits10; i > 0; --i) {
+                    power *= 10;
+                }
+                const Unsigned value = power + static_cast<Unsigned>(bits % 3) - 1;
+                return static_cast<T>(numeric_limits<T>::is_signed && (bits & 8) ? Unsigned(0) - value : value);
+            }
+    }
+}
+
+
+/**
+ * Generates a random floating point value, either random bits (including NaN, infinity and subnormals), a decimal
+ * value with few digits like a price, a value exactly at a rounding tie, or a random value of moderate magnitude.
+ */
+template <typename F, typename Bits>
+F RandomFloatingPoint(mt19937_64& generator)
+{
+    const unsigned long long bits = generator();
+    const F sign = (bits & 1) ? F(-1) : F(1);
+    switch (generator() % 4) {
+        case 0:
+            {
+                const Bits pattern = static_cast<Bits>(bits);
+                F value;
+                memcpy(&value, &pattern, sizeof(value));
+                return value;
+            }
+
+        case 1:
+            return sign * static_cast<F>(static_cast<double>(bits % 100000000) / pow(10.0, static_cast<double>(generator() % 9)));
+
+        case 2:
+            return sign * static_cast<F>(ldexp(static_cast<double>((bits >> 8) % 100000 * 2 + 1),
+                                               -static_cast<int>(generator() % 24)));
+
+        default:
+            return sign * static_cast<F>(static_cast<double>(bits >> 11) / static_cast<double>(1ull << 53) *
+                                         pow(10.0, static_cast<double>(generator() % 61) - 30));
+    }
+}
+
+
+template <typename T>
+void CompareIntegers(unsigned long long count, mt19937_64& generator, Comparison& comparison)
+{
+    vector<T> values(BATCH_SIZE);
+    for (unsigned long long done = 0; done < count; done += BATCH_SIZE) {
+        values.resize(static_cast<size_t>(min<unsigned long long>(BATCH_SIZE, count - done)));
+        for (T& value : values) {
+            value = RandomInteger<T>(generator);
+        }
+        const string specifier = RandomSpecifier(generator, " bdoxXn", false);
+        CompareBatch(values, specifier, ReferenceInteger, comparison);
+    }
+}
+
+
+template <typename F, typename Bits>
+void CompareFloatingPoint(unsigned long long count, mt19937_64& generator, Comparison& comparison)
+{
+    vector<F> values(BATCH_SIZE);
+    for (unsigned long long done = 0; done < count; done += BATCH_SIZE) {
+        values.resize(static_cast<size_t>(min<unsigned long long>(BATCH_SIZE, count - done)));
+        for (F& value : values) {
+            value = RandomFloatingPoint<F, Bits>(generator);
+        }
+        const string specifier = RandomSpecifier(generator, " eEfFgGn%aA", true);
+        CompareBatch(values, specifier, ReferenceFloatingPoint<F>, comparison);
+    }
+}
+
+
+//
+// Python corpus
+//
+
+/**
+ * Checks every case of the Python generated corpus, see generate_corpus.py, against FormatType.
+ *
+ * @return Returns the number of failed cases, or -1 if the corpus could not be read.
+ */
+long CheckCorpus(const char* path, unsigned long long& cases)
+{
+    ifstream corpus(path);
+    if (!corpus) {
+        cout << "  Unable to read the corpus " << path << endl;
+        return -1;
+    }
+
+    long failures = 0;
+    string line;
+    while (getline(corpus, line)) {
+        string fields[4];
+        size_t start = 0;
+        for (int i = 0; i < 3; ++i) {
+            const size_t tab = line.find('\t', start);
+            fields[i] = line.substr(start, tab - start);
+            start = tab + 1;
+        }
+        fields[3] = line.substr(start);
+
+        ostringstream output;
+        if (fields[0] == "i") {
+            FormatType(strtoll(fields[1].c_str(), nullptr, 10), fields[2].c_str(), output);
+        }
+        else if (fields[0] == "u") {
+            FormatType(strtoull(fields[1].c_str(), nullptr, 10), fields[2].c_str(), output);
+        }
+        else if (fields[0] == "d") {
+            FormatType(strtod(fields[1].c_str(), nullptr), fields[2].c_str(), output);
+        }
+        else {
+            FormatType(strtof(fields[1].c_str(), nullptr), fields[2].c_str(), output);
+        }
+        ++cases;
+        if (output.str() != fields[3]) {
+            ++failures;
+            ReportMismatch("corpus", fields[1], fields[2], output.str(), fields[3]);
+        }
+    }
+    return failures;
+}
+
+
+void PrintComparison(const Comparison& comparison)
+{
+    const double values = static_cast<double>(max<unsigned long long>(comparison.values + comparison.documented, 1));
+    cout << "  " << left << setw(22) << comparison.name << right << setw(14) << comparison.values
+         << setw(12) << comparison.documented << setw(12) << comparison.mismatches << fixed << setprecision(1)
+         << setw(14) << comparison.fastNanoseconds / values
+         << setw(14) << comparison.referenceNanoseconds / values
+         << setw(9) << comparison.referenceNanoseconds / max(comparison.fastNanoseconds, 1.0) << "x" << endl;
+}
+
+}
+
+/**
+ * Compares the native numeric kernels against the stream based reference on randomized values and against Python on
+ * the corpus, reporting the throughput of both sides.
+ *
+ * Usage: string-format-differential [--values N] [--seed S] [--corpus FILE]
+ *
+ * N is the number of randomized values per kernel family, use hundreds of millions for a full run.  The exit code is
+ * 0 when everything matches.
+ */
+int main(int argc, char* argv[])
+{
+    unsigned long long count = DEFAULT_VALUE_COUNT;
+    unsigned long long seed = 42;
+    const char* corpus = nullptr;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--values") == 0) {
+            count = strtoull(argv[i + 1], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[i + 1], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--corpus") == 0) {
+            corpus = argv[i + 1];
+        }
+    }
+
+    cout << "Type safe string format" << endl
+         << endl
+         << "Comparing the numeric kernels against the stream based reference, seed " << seed << "." << endl
+         << endl;
+
+    mt19937_64 generator(seed);
+    vector<Comparison> comparisons = {
+        Comparison("int"), Comparison("long long"), Comparison("unsigned long long"), Comparison("float"),
+        Comparison("double")
+    };
+    CompareIntegers<int>(count, generator, comparisons[0]);
+    CompareIntegers<long long>(count, generator, comparisons[1]);
+    CompareIntegers<unsigned long long>(count, generator, comparisons[2]);
+    CompareFloatingPoint<float, uint32_t>(count, generator, comparisons[3]);
+    CompareFloatingPoint<double, uint64_t>(count, generator, comparisons[4]);
+
+    cout << endl
+         << "  " << left << setw(22) << "kernel" << right << setw(14) << "values" << setw(12) << "documented"
+         << setw(12) << "mismatches" << setw(14) << "fast ns" << setw(14) << "reference ns" << setw(10) << "speedup" << endl;
+    unsigned long long mismatches = 0;
+    for (const Comparison& comparison : comparisons) {
+        PrintComparison(comparison);
+        mismatches += comparison.mismatches;
+    }
+
+    long corpusFailures = 0;
+    if (corpus) {
+        unsigned long long cases = 0;
+        corpusFailures = CheckCorpus(corpus, cases);
+        cout << endl << "  Python corpus: " << cases << " cases, " << max(corpusFailures, 0L) << " failures" << endl;
+    }
+
+    return mismatches == 0 && corpusFailures == 0 ? 0 : 1;
+}
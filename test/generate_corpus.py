@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+"""
+Generates pep3101_corpus.txt, the expected outputs of Python's format() for the edge cases of the PEP-3101 format
+specification mini-language, which are checked by string-format-differential.
+
+Every line of the corpus holds four tab separated fields, the type of the value ('i' for a signed 64-bit integer,
+'u' for an unsigned 64-bit integer, 'd' for a double and 'f' for a float), the value (decimal for integers,
+hexadecimal for floating point values), the format specifier, and the expected output.
+
+The library deliberately differs from Python in a few places, for these cases the expected output is the output of
+the library, see library_format.
+
+Usage: python3 generate_corpus.py > pep3101_corpus.txt
+"""
+
+from decimal import Decimal
+import itertools
+import math
+import re
+import struct
+import sys
+
+
+INT64_MIN = -(1 << 63)
+INT64_MAX = (1 << 63) - 1
+UINT64_MAX = (1 << 64) - 1
+
+
+def to_float32(value):
+    return struct.unpack('f', struct.pack('f', value))[0]
+
+
+def layouts():
+    """The fill, alignment, sign, alternate form, zero padding and width combinations."""
+    yield ''
+    for fill_align in ('', '<', '>', '^', '=', '*<', '*>', '*^', '*=', '0>', ' ^'):
+        for sign in ('', '+', '-', ' '):
+            for alternate in ('', '#'):
+                for width in ('', '1', '12', '25'):
+                    yield fill_align + sign + alternate + width
+    for sign in ('', '+', ' '):
+        for alternate in ('', '#'):
+            for width in ('01', '08', '015'):
+                yield sign + alternate + width
+
+
+INTEGERS = [
+    0, 1, -1, 7, -8, 9, 10, 42, -42, 99, 100, 255, -255, 256, 999, 1000, -1000, 1023, 1024, 65535, 65536, 999999,
+    1000000, -1234567, 2147483647, -2147483648, 4294967295, 4294967296, 10 ** 15, 10 ** 18 - 1, 10 ** 18,
+    INT64_MAX, INT64_MIN, INT64_MIN + 1,
+]
+
+UNSIGNED = [(1 << 63), UINT64_MAX - 1, UINT64_MAX, 10 ** 19, 12345678901234567890]
+
+DOUBLES = [
+    0.0, -0.0, 1.0, -1.0, 0.5, 0.1, 0.2, 0.3, 0.1 + 0.2, 1.5, 2.5, -2.5, 0.125, 0.375, 1.005, 2.675, 9.5, 9.95,
+    9.995, 99.5, 999.9999, 0.05, 0.0005, 1e-4, 1e-5, 1.23456789e-7, 123456.789, 1234567.0, 1e15, 1e16, 1e17,
+    9007199254740993.0, 1e21, 1e22, 1e23, 3.141592653589793, 2.718281828459045, 6.02214076e23, 1.602176634e-19,
+    -6.62607015e-34, 1.7976931348623157e308, 5e-324, 2.2250738585072014e-308, 2.225073858507201e-308, 0.015625,
+    0.9999995, 12345.678, -0.000123, 5e-5, 4.35, 0.045, 1e100, 123456789012345678.0,
+    math.inf, -math.inf, math.nan,
+]
+
+FLOATS = [
+    to_float32(value) for value in (
+        0.0, 1.0, -1.0, 0.1, 0.2, 0.3, 1.5, 2.5, 0.125, 3.14159265, 16777216.0, 16777217.0, 1e10, 1e-10,
+        3.4028234663852886e38, 1.401298464324817e-45, 1.1754943508222875e-38, 123.456, -987.654,
+    )
+]
+
+INTEGER_TYPES = ['', 'b', 'o', 'x', 'X', 'd']
+FLOAT_TYPES = ['', 'e', 'E', 'f', 'F', 'g', 'G', '%']
+PRECISIONS = ['', '.0', '.1', '.3', '.6', '.10', '.17']
+
+# The standard format specifier, [[fill]align][sign][#][0][width][,][.precision][type].
+SPEC_PATTERN = re.compile(r'^(?:(.)?([<>=^]))?([-+ ])?(#)?(0)?(\d+)?(,)?(\.\d+)?([a-zA-Z%])?$')
+
+
+def pad(text, fill, align, width, prefix):
+    """Pads a formatted value to the width, '=' pads after the sign and the prefix of the alternate form."""
+    padding = int(width or 0) - len(text)
+    if padding <= 0:
+        return text
+    fill = fill or ' '
+    if align == '<':
+        return text + fill * padding
+    if align == '^':
+        return fill * (padding // 2) + text + fill * (padding - padding // 2)
+    if align == '=':
+        split = (1 if text[:1] in ('+', '-', ' ') else 0) + prefix
+        return text[:split] + fill * padding + text[split:]
+    return fill * padding + text
+
+
+def library_format(value, spec):
+    """
+    Formats a value like the library does, which is format() except for the places where the library deliberately
+    differs from Python:
+     - Binary, octal and hexadecimal integers are written without a sign, negative values in two's complement.
+     - Zero padding is not grouped by the thousands separator.
+     - Percentages multiply the exact value by 100, Python multiplies it in floating point, which may round.
+     - A precision without a presentation type follows printf's %g, so 1.0 is written as "1" with '.3'.
+     - Without a presentation type and a precision the alternate form does not change the output.
+    """
+    fill, align, sign, alternate, zero, width, grouping, precision, type_ = SPEC_PATTERN.match(spec).groups()
+    if zero and not align:
+        fill, align = '0', '='
+
+    def join(*parts):
+        return ''.join(part or '' for part in parts)
+
+    if type_ in ('b', 'o', 'x', 'X') and (value < 0 or sign == '+'):
+        value, sign = value % (1 << 64), None
+    if isinstance(value, float) and math.isfinite(value) and type_ == '%':
+        text = format(Decimal(value), join(sign, grouping, precision or '.6', '%'))
+        if alternate and '.' not in text:
+            text = text[:-1] + '.%'
+    elif isinstance(value, float) and not type_:
+        if precision:
+            text = format(value, join(sign, alternate, grouping, precision, 'g'))
+        else:
+            text = format(value, join(sign, grouping))
+    else:
+        text = format(value, join(sign, alternate, grouping, precision, type_))
+    return pad(text, fill, align or '>', width, 2 if alternate and type_ in ('b', 'o', 'x', 'X') else 0)
+
+
+def emit(kind, text, spec, value):
+    try:
+        format(value, spec)
+    except ValueError:
+        return
+    expected = library_format(value, spec)
+    if '\t' in expected or '\n' in expected:
+        return
+    sys.stdout.write('%s\t%s\t%s\t%s\n' % (kind, text, spec, expected))
+
+
+def float_text(value):
+    if math.isnan(value):
+        return 'nan'
+    if math.isinf(value):
+        return 'inf' if value > 0 else '-inf'
+    return value.hex()
+
+
+SHORT_LAYOUTS = ['', '+', ' ', '#', '>12', '<12', '^12', '=12', '012', '*^25', '#012', '+#25', ',', '0=+15,']
+
+
+def main():
+    # Every value with every type and a few layouts, then every layout with a few values.
+    for value in INTEGERS + UNSIGNED:
+        kind = 'u' if value > INT64_MAX else 'i'
+        for layout, type_ in itertools.product(SHORT_LAYOUTS, INTEGER_TYPES):
+            if ',' in layout and type_ not in ('', 'd'):
+                continue
+            emit(kind, str(value), layout + type_, value)
+    for value in (0, 42, -42, 1234567, INT64_MIN):
+        for layout, type_ in itertools.product(layouts(), INTEGER_TYPES):
+            emit('i', str(value), layout + type_, value)
+
+    for value in DOUBLES:
+        for layout in ('', '+', '#', '012', '*^25', ','):
+            emit('d', float_text(value), layout, value)
+            for precision, type_ in itertools.product(PRECISIONS[1:], FLOAT_TYPES):
+                emit('d', float_text(value), layout + precision + type_, value)
+            for type_ in FLOAT_TYPES[1:]:
+                emit('d', float_text(value), layout + type_, value)
+    for value in (-1.5, 1234567.125, -0.0, math.inf, math.nan):
+        for layout in layouts():
+            for spec in ('', '.2', 'e', '.3f', ',.1f', 'g', 'G', '.0%'):
+                emit('d', float_text(value), layout + spec, value)
+
+    for value in FLOATS:
+        for layout in ('', '+', '>12', '*^15', '=+12'):
+            for precision, type_ in itertools.product(PRECISIONS, FLOAT_TYPES[1:]):
+                emit('f', float_text(value), layout + precision + type_, value)
+
+
+if __name__ == '__main__':
+    main()
@@ -1,8 +1,14 @@
+#include <array>
+#include <cstdint>
 #include <iostream>
 #include <map>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
 #include <vector>
 
 #include <utils/format.h>
+#include <utils/log.h>
 
 using namespace std;
 using namespace utils::str;
@@ -72,5 +78,183 @@ int main(int argc, char* argv[])
     BeginTest(testIndex++, "Referencing specific indexes and keys in vectors and maps.");
     cout << "  Format(\"{0.0}, {0[2]}, {0[4]}\", testVec, testMap) =>" << endl;
     cout << "  " << Format("{0.1}, {0[2]}, {0[1]}", testMap) << endl;
+
+    BeginTest(testIndex++, "Formatting integers of every width.");
+    cout << "  Format(\"{}, {}, {:,}, {:#x}\", 18446744073709551615ull, size_t(42), int64_t(-1234567), uint16_t(65535)) =>" << endl;
+    cout << "  " << Format("{}, {}, {:,}, {:#x}", 18446744073709551615ull, size_t(42), int64_t(-1234567), uint16_t(65535)) << endl;
+#ifdef FORMAT_HAS_INT128
+    cout << "  Format(\"{}, {:>42}\", -(static_cast<__int128>(1) << 100), ~static_cast<unsigned __int128>(0)) =>" << endl;
+    cout << "  " << Format("{}, {:>42}", -(static_cast<__int128>(1) << 100), ~static_cast<unsigned __int128>(0)) << endl;
+#endif  // FORMAT_HAS_INT128
+
+    BeginTest(testIndex++, "Formatting a column of numbers with a single format specifier.");
+    cout << "  vector<double> prices = {1.5, 22.25, 333.125};" << endl;
+    cout << "  vector<uint8_t> bytes = {1, 2, 255};" << endl;
+    cout << "  FormatColumn(testVec, \">6\", cout, \", \"), FormatColumn(prices, \"08.2f\", cout, \", \")," << endl;
+    cout << "  FormatColumn(bytes, \"#04x\", cout, \" \") =>" << endl;
+    vector<double> prices = {1.5, 22.25, 333.125};
+    vector<uint8_t> bytes = {1, 2, 255};
+    cout << "  ";
+    FormatColumn(testVec, ">6", cout, ", ");
+    cout << endl << "  ";
+    FormatColumn(prices, "08.2f", cout, ", ");
+    cout << endl << "  ";
+    FormatColumn(bytes, "#04x", cout, " ");
+    cout << endl;
+
+    BeginTest(testIndex++, "Writing floating point numbers in their shortest form.");
+    cout << "  Format(\"{}, {}, {}, {:g}, {}\", 0.1 + 0.2, 1e-10, 1e16, 1234567.0, 0.1f) =>" << endl;
+    cout << "  " << Format("{}, {}, {}, {:g}, {}", 0.1 + 0.2, 1e-10, 1e16, 1234567.0, 0.1f) << endl;
+
+    BeginTest(testIndex++, "Writing floating point numbers in scientific notation.");
+    cout << "  Format(\"{:e}, {:.2E}, {:.0e}, {:+.3e}\", 123456.0, 6.02214076e23, 2.5, -1.0005e-300) =>" << endl;
+    cout << "  " << Format("{:e}, {:.2E}, {:.0e}, {:+.3e}", 123456.0, 6.02214076e23, 2.5, -1.0005e-300) << endl;
+
+    BeginTest(testIndex++, "Writing the exact bits of floating point numbers in hexadecimal.");
+    cout << "  Format(\"{:a}, {:A}, {:.3a}, {:>12a}\", 0.1, -3.75, 1.0 / 3, 0.1f) =>" << endl;
+    cout << "  " << Format("{:a}, {:A}, {:.3a}, {:>12a}", 0.1, -3.75, 1.0 / 3, 0.1f) << endl;
+
+    BeginTest(testIndex++, "Formatting part of a buffer without copying it.");
+    cout << "  const char* buffer = \"key=value;next\";" << endl;
+    cout << "  Format(\"[{:>8}], [{:.3}], [{}]\", StringSlice(buffer + 4, 5), StringSlice(buffer, 3), StringSlice(buffer + 10, 4)) =>" << endl;
+    const char* buffer = "key=value;next";
+    cout << "  " << Format("[{:>8}], [{:.3}], [{}]", StringSlice(buffer + 4, 5), StringSlice(buffer, 3), StringSlice(buffer + 10, 4)) << endl;
+
+    BeginTest(testIndex++, "Truncating and padding strings.");
+    cout << "  string payload(100000, 'x');" << endl;
+    cout << "  Format(\"[{:.8}], [{:*^12.4}], [{:>6}]\", payload, \"preview\", \"abc\") =>" << endl;
+    string payload(100000, 'x');
+    cout << "  " << Format("[{:.8}], [{:*^12.4}], [{:>6}]", payload, "preview", "abc") << endl;
+
+    BeginTest(testIndex++, "Aligning and truncating UTF-8 encoded strings by their characters.");
+    cout << "  Format(\"[{:<8}], [{:>6}], [{:.4}]\", \"h\\u00e9llo\", \"\\u65e5\\u672c\", \"\\u03b1\\u03b2\\u03b3\\u03b4\\u03b5\") =>" << endl;
+    cout << "  " << Format("[{:<8}], [{:>6}], [{:.4}]", "h\u00e9llo", "\u65e5\u672c", "\u03b1\u03b2\u03b3\u03b4\u03b5") << endl;
+
+    BeginTest(testIndex++, "Escaping strings for JSON, CSV and HTML.");
+    cout << "  Format(\"{{\\\"msg\\\": {:j}}}, {:q}, {:h}\", \"say \\\"hi\\\"\\n\", \"a,b\", \"<b>&</b>\") =>" << endl;
+    cout << "  " << Format("{{\"msg\": {:j}}}, {:q}, {:h}", "say \"hi\"\n", "a,b", "<b>&</b>") << endl;
+
+    BeginTest(testIndex++, "Writing string arguments as is, straight into the result.");
+    cout << "  Format(\"{0}/{1!s}/{0:.2}/{1}\", string(\"usr\"), \"local\") =>" << endl;
+    cout << "  " << Format("{0}/{1!s}/{0:.2}/{1}", string("usr"), "local") << endl;
+
+    BeginTest(testIndex++, "Formatting every element of nested containers with one format specifier.");
+    cout << "  map<int, vector<double>> series = {{1, {0.5, 0.25}}, {2, {0.125}}};" << endl;
+    cout << "  Format(\"{:.1%}\", series) =>" << endl;
+    map<int, vector<double>> series = {{1, {0.5, 0.25}}, {2, {0.125}}};
+    cout << "  " << Format("{:.1%}", series) << endl;
+
+    BeginTest(testIndex++, "Selecting elements of vectors and nested containers by index.");
+    cout << "  vector<vector<double>> matrix = {{1.5, 2.5}, {3.5, 4.5}};" << endl;
+    cout << "  Format(\"{0[3]}, {1[1][0]:.2f}, {1[1]}, {0[9]}\", testVec, matrix) =>" << endl;
+    vector<vector<double>> matrix = {{1.5, 2.5}, {3.5, 4.5}};
+    cout << "  " << Format("{0[3]}, {1[1][0]:.2f}, {1[1]}, {0[9]}", testVec, matrix) << endl;
+
+    BeginTest(testIndex++, "Selecting values of maps with integer keys.");
+    cout << "  map<int, string> statusText = {{200, \"OK\"}, {404, \"Not Found\"}};" << endl;
+    cout << "  Format(\"{0[404]}, {0[200]:>4}, {0[500]}\", statusText) =>" << endl;
+    map<int, string> statusText = {{200, "OK"}, {404, "Not Found"}};
+    cout << "  " << Format("{0[404]}, {0[200]:>4}, {0[500]}", statusText) << endl;
+
+    BeginTest(testIndex++, "Selecting slices of containers.");
+    cout << "  Format(\"{0[2:4]}, {0[-2:]}, {0[:1]:03}\", testVec) =>" << endl;
+    cout << "  " << Format("{0[2:4]}, {0[-2:]}, {0[:1]:03}", testVec) << endl;
+
+    BeginTest(testIndex++, "Formatting containers in parallel.");
+    cout << "  Format(\"{:>3}\", Parallel(testVec, 4)) =>" << endl;
+    cout << "  " << Format("{:>3}", Parallel(testVec, 4)) << endl;
+
+    BeginTest(testIndex++, "Limiting the number of elements formatted.");
+    cout << "  Format(\"{}\", Limit(testVec, 3)) =>" << endl;
+    cout << "  " << Format("{}", Limit(testVec, 3)) << endl;
+
+    BeginTest(testIndex++, "Formatting tuples and arrays of a fixed size.");
+    cout << "  tuple<string, int, double> record(\"rgb\", 255, 0.5);" << endl;
+    cout << "  array<float, 3> position = {{1.0f, 2.5f, -3.0f}};" << endl;
+    cout << "  int channels[3] = {255, 128, 0};" << endl;
+    cout << "  Format(\"{} {:.2f} {:02x}\", record, position, channels) =>" << endl;
+    tuple<string, int, double> record("rgb", 255, 0.5);
+    array<float, 3> position = {{1.0f, 2.5f, -3.0f}};
+    int channels[3] = {255, 128, 0};
+    cout << "  " << Format("{} {:.2f} {:02x}", record, position, channels) << endl;
+
+    BeginTest(testIndex++, "Choosing the delimiters of containers.");
+    cout << "  vector<string> tags = {\"fast\", \"safe\"};" << endl;
+    cout << "  Format(\"{} {:j}\", Delimit(testVec, GetCsvDelimiters()), Delimit(tags, GetJsonDelimiters())) =>" << endl;
+    vector<string> tags = {"fast", "safe"};
+    cout << "  " << Format("{} {:j}", Delimit(testVec, GetCsvDelimiters()), Delimit(tags, GetJsonDelimiters())) << endl;
+
+    BeginTest(testIndex++, "Selecting part of a container with its own delimiters, limit or threads.");
+    cout << "  Format(\"{0[1:3]} {1[1:]} {2[1]}\", Delimit(testVec, GetCsvDelimiters()), Limit(testVec, 2), "
+            "Parallel(testVec, 2)) =>" << endl;
+    cout << "  " << Format("{0[1:3]} {1[1:]} {2[1]}", Delimit(testVec, GetCsvDelimiters()), Limit(testVec, 2),
+                           Parallel(testVec, 2)) << endl;
+
+    BeginTest(testIndex++, "Formatting containers and their elements by separate format specifiers.");
+    cout << "  Format(\"{:*^36:>4}, {:>32:n:.1f}\", testVec, vector<map<string, double>>{testMap}) =>" << endl;
+    cout << "  " << Format("{:*^36:>4}, {:>32:n:.1f}", testVec, vector<map<string, double>>{testMap}) << endl;
+
+    BeginTest(testIndex++, "Using a colon as fill character of the elements of containers, with or without a split.");
+    cout << "  Format(\"{0::>6} {0:::>6}\", tags) =>" << endl;
+    cout << "  " << Format("{0::>6} {0:::>6}", tags) << endl;
+
+    BeginTest(testIndex++, "Formatting log messages on a background thread.");
+    cout << "  stringstream messages;" << endl;
+    cout << "  DeferredLog log(messages);" << endl;
+    cout << "  log.Log(\"{:>8.3f} ms, {} of {:#x}; \", 12.34567, testStr, 255u);" << endl;
+    cout << "  log.Log(\"{1}: {0!r}\", \"deferred\", 'x');" << endl;
+    cout << "  log.Flush();" << endl;
+    cout << "  messages.str() =>" << endl;
+    stringstream messages;
+    DeferredLog log(messages);
+    log.Log("{:>8.3f} ms, {} of {:#x}; ", 12.34567, testStr, 255u);
+    log.Log("{1}: {0!r}", "deferred", 'x');
+    log.Flush();
+    cout << "  " << messages.str() << endl;
+
+    BeginTest(testIndex++, "Logging messages in binary form, and decoding them later.");
+    cout << "  stringstream binary;" << endl;
+    cout << "  BinaryLog binaryLog(binary);" << endl;
+    cout << "  binaryLog.Log(\"{:<12}|{:^+7.2f}|\", testStr.c_str(), 2.5);" << endl;
+    cout << "  binaryLog.Log(\"{0}, {0:o}\", 8);" << endl;
+    cout << "  binaryLog.Flush();" << endl;
+    cout << "  DecodeBinaryLog(binary, cout) =>" << endl;
+    stringstream binary;
+    BinaryLog binaryLog(binary);
+    binaryLog.Log("{:<12}|{:^+7.2f}|", testStr.c_str(), 2.5);
+    binaryLog.Log("{0}, {0:o}", 8);
+    binaryLog.Flush();
+    cout << "  ";
+    DecodeBinaryLog(binary, cout);
+    cout << endl;
+
+    BeginTest(testIndex++, "Decoding a binary log truncated in the middle of a message.");
+    cout << "  string truncated = binary.str();" << endl;
+    cout << "  truncated.resize(truncated.size() - 3);" << endl;
+    cout << "  stringstream truncatedLog(truncated);" << endl;
+    cout << "  DecodeBinaryLog(truncatedLog, cout) =>" << endl;
+    string truncated = binary.str();
+    truncated.resize(truncated.size() - 3);
+    stringstream truncatedLog(truncated);
+    cout << "  ";
+    try {
+        DecodeBinaryLog(truncatedLog, cout);
+        cout << endl;
+    }
+    catch (const runtime_error& e) {
+        cout << endl << "  runtime_error: " << e.what() << endl;
+    }
+
+    BeginTest(testIndex++, "Refusing to log a string too long for the 32-bit length of captured strings.");
+    cout << "  StringSlice huge(testStr.c_str(), static_cast<size_t>(UINT32_MAX) + 1);" << endl;
+    cout << "  binaryLog.Log(\"{}\", huge) =>" << endl;
+    StringSlice huge(testStr.c_str(), static_cast<size_t>(UINT32_MAX) + 1);
+    try {
+        binaryLog.Log("{}", huge);
+        cout << "  logged" << endl;
+    }
+    catch (const length_error& e) {
+        cout << "  length_error: " << e.what() << endl;
+    }
     return 0;
 }
@@ -0,0 +1,47 @@
+#include <exception>
+#include <fstream>
+#include <iostream>
+
+#include <utils/log.h>
+
+using namespace std;
+using namespace utils::str;
+
+/**
+ * Decodes a log written by BinaryLog and writes its messages as text, to a file if a second path is given and to the
+ * standard output otherwise.
+ */
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || argc > 3) {
+        cerr << "Usage: " << argv[0] << " <binary log> [text log]" << endl;
+        return 2;
+    }
+
+    ifstream input(argv[1], ios::binary);
+    if (!input) {
+        cerr << "Unable to open " << argv[1] << endl;
+        return 1;
+    }
+
+    ofstream file;
+    if (argc == 3) {
+        file.open(argv[2], ios::binary);
+        if (!file) {
+            cerr << "Unable to open " << argv[2] << endl;
+            return 1;
+        }
+    }
+    ostream& output = argc == 3 ? file : cout;
+
+    try {
+        DecodeBinaryLog(input, output);
+    }
+    catch (const exception& e) {
+        output.flush();
+        cerr << argv[1] << ": " << e.what() << endl;
+        return 1;
+    }
+    output.flush();
+    return output ? 0 : 1;
+}
@@ -29,16 +29,28 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "format.h"
 
 #include <algorithm>
-#include <bitset>
+#include <atomic>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <exception>
 #include <iomanip>
 #include <limits>
+#include <mutex>
 #include <string>
+#include <system_error>
+#include <thread>
 #include <cstdlib>
 
+// SSE2 is used for the decimal digit conversion when available, define FORMAT_DISABLE_SIMD to use the portable code
+// only.
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(FORMAT_DISABLE_SIMD)
+#  define FORMAT_USE_SSE2 1
+#  include <emmintrin.h>
+#endif
+
 using namespace utils::str;
 
 namespace {
@@ -72,6 +84,12 @@ const char FORMAT_EXPLICIT_TYPE = '!';
 const char FORMAT_SELECTOR_OBJ = '.';
 const char FORMAT_SELECTOR_ARRAY_BEGIN = '[';
 const char FORMAT_SELECTOR_ARRAY_END = ']';
+const char FORMAT_SLICE_SEP = ':';
+
+/**
+ * Character splitting the format specifier of a container into a container level and an element level.
+ */
+const char FORMAT_CONTAINER_SPLIT = ':';
 
 /**
  * Character used to toggle left alignment.
@@ -200,6 +218,33 @@ const char FORMAT_GENERAL_DECIM_TOGGLE = 'g';
  */
 const char FORMAT_GENERAL_DECIM_UC_TOGGLE = 'G';
 
+/**
+ * Format the number as a hexadecimal floating point number, like C's %a.
+ */
+const char FORMAT_HEX_FLOAT_TOGGLE = 'a';
+
+/**
+ * Format the number as an upper case hexadecimal floating point number, like C's %A.
+ */
+const char FORMAT_HEX_FLOAT_UC_TOGGLE = 'A';
+
+/**
+ * Format the string as a JSON string, enclosed in double quotes with quotes, backslashes and control characters
+ * escaped.
+ */
+const char FORMAT_JSON_TOGGLE = 'j';
+
+/**
+ * Format the string as a CSV field, enclosed in double quotes with the quotes doubled if it contains a quote, a comma
+ * or a line break, as described in RFC 4180.
+ */
+const char FORMAT_CSV_TOGGLE = 'q';
+
+/**
+ * Format the string as HTML text, with the characters &, <, >, " and ' replaced by character references.
+ */
+const char FORMAT_HTML_TOGGLE = 'h';
+
 /**
  * Integer value used as index for text fragments.
  */
@@ -411,6 +456,10 @@ void InitializeFormatFragment(FormatFragment& fragment, int index = FORMAT_TEXT_
 {
     fragment.index = index;
     fragment.explicitConversion = '\0';
+    fragment.reference = nullptr;
+    fragment.referenceLength = 0;
+    fragment.elementLimit = 0;
+    fragment.delimiters = nullptr;
 #ifndef FORMAT_DISABLE_THROW_OUT_OF_RANGE
     // By default format parameters are not handled.
     fragment.handled = index < 0;
@@ -803,23 +852,37 @@ void ReadTypeSpecifier(const char* formatParameter, BasicFormatSpecifiers& fragm
             || type == FORMAT_FIXED_UC_TOGGLE
             || type == FORMAT_GENERAL_DECIM_TOGGLE
             || type == FORMAT_GENERAL_DECIM_UC_TOGGLE
+            || type == FORMAT_HEX_FLOAT_TOGGLE
+            || type == FORMAT_HEX_FLOAT_UC_TOGGLE
             || type == FORMAT_LOCALIZED_NUMBER_TOGGLE
             || type == FORMAT_OCTAL_TOGGLE
             || type == FORMAT_LOWERCASE_HEX_TOGGLE
             || type == FORMAT_UPPERCASE_HEX_TOGGLE
-            || type == FORMAT_PERCENTAGE_MODE) {
+            || type == FORMAT_PERCENTAGE_MODE
+            || type == FORMAT_JSON_TOGGLE
+            || type == FORMAT_CSV_TOGGLE
+            || type == FORMAT_HTML_TOGGLE) {
         fragment.type = type;
         ++pos;
     }
 }
 
 
+/**
+ * Checks whether a character may be part of an identifier, that is the name of a selector or environment variable.
+ */
+bool IsIdentifierCharacter(char c) noexcept
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+
 void ReadIdentifier(const char* formatParameter, std::ostream& ostr, int& pos) noexcept
 {
     char c = formatParameter[pos];
 
     while (c) {
-        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_') {
+        if (IsIdentifierCharacter(c)) {
             ostr << c;
         }
         else {
@@ -944,13 +1007,71 @@ void ReadExplicitTypeConversion(const char* formatParameter, FormatFragment& fra
 }
 
 
+/**
+ * Reads one position of a slice selector, an optional minus sign followed by decimal digits.  Positions too large for
+ * std::ptrdiff_t are stored as the largest std::ptrdiff_t value, or its negation.
+ *
+ * @exception IllegalFormatStringException An exception is thrown if a minus sign is not followed by a digit.
+ *
+ * @param[in] formatParameter  The format string to read the position from.
+ * @param[in,out] pos  The position to start reading from, updated to the character after the position read.
+ * @param[out] bound  The position read, this is not changed if no position is written.
+ *
+ * @return Returns true if a position is read, false if the position is left out.
+ */
+bool ReadSliceBound(const char* formatParameter, int& pos, std::ptrdiff_t& bound)
+{
+    const bool isNegative = formatParameter[pos] == '-';
+    if (isNegative) {
+        ++pos;
+    }
+    if (formatParameter[pos] < '0' || formatParameter[pos] > '9') {
+        if (isNegative) {
+            throw IllegalFormatStringException(formatParameter, pos, "Illegal slice syntax, expected a digit");
+        }
+        return false;
+    }
+
+    const std::ptrdiff_t limit = std::numeric_limits<std::ptrdiff_t>::max();
+    std::ptrdiff_t value = 0;
+    while (formatParameter[pos] >= '0' && formatParameter[pos] <= '9') {
+        const std::ptrdiff_t digitValue = formatParameter[pos] - '0';
+        value = value > (limit - digitValue) / 10 ? limit : value * 10 + digitValue;
+        ++pos;
+    }
+    bound = isNegative ? -value : value;
+    return true;
+}
+
+
 void ReadSelector(const char* formatParameter, FormatFragment& fragment, int& pos)
 {
     char selectorType = formatParameter[pos];
     if (selectorType == FORMAT_SELECTOR_OBJ || selectorType == FORMAT_SELECTOR_ARRAY_BEGIN) {
-        std::stringstream buffer;
         ++pos;
-        ReadIdentifier(formatParameter, buffer, pos);
+        const int start = pos;
+        while (IsIdentifierCharacter(formatParameter[pos])) {
+            ++pos;
+        }
+
+        FormatSelector selector;
+        selector.isSlice = false;
+        selector.sliceBegin = 0;
+        selector.sliceEnd = std::numeric_limits<std::ptrdiff_t>::max();
+
+        // Slices, such as [10:20] or [-5:], are only allowed within brackets.
+        if (selectorType == FORMAT_SELECTOR_ARRAY_BEGIN
+            && (formatParameter[pos] == FORMAT_SLICE_SEP || formatParameter[pos] == '-')) {
+            pos = start;
+            ReadSliceBound(formatParameter, pos, selector.sliceBegin);
+            if (formatParameter[pos] != FORMAT_SLICE_SEP) {
+                throw IllegalFormatStringException(formatParameter, pos, "Illegal slice syntax, expected :");
+            }
+            ++pos;
+            ReadSliceBound(formatParameter, pos, selector.sliceEnd);
+            selector.isSlice = true;
+        }
+        const int end = pos;
         char endSelector = formatParameter[pos];
         if (selectorType == FORMAT_SELECTOR_ARRAY_BEGIN && endSelector != FORMAT_SELECTOR_ARRAY_END) {
             throw IllegalFormatStringException(formatParameter, pos, "Illegal selector syntax");
@@ -958,7 +1079,28 @@ void ReadSelector(const char* formatParameter, FormatFragment& fragment, int& po
         if (endSelector == FORMAT_SELECTOR_ARRAY_END) {
             ++pos;
         }
-        fragment.selectors.push(buffer.str());
+
+        // Selectors written as decimal integers are parsed here, once, to be used as indexes.
+        selector.name.assign(formatParameter + start, static_cast<std::size_t>(end - start));
+        selector.isIndex = !selector.isSlice && !selector.name.empty();
+        selector.index = 0;
+        for (char digit : selector.name) {
+            if (!selector.isIndex) {
+                break;
+            }
+            if (digit < '0' || digit > '9') {
+                selector.isIndex = false;
+                break;
+            }
+            const std::size_t digitValue = static_cast<std::size_t>(digit - '0');
+            if (selector.index > (std::numeric_limits<std::size_t>::max() - digitValue) / 10) {
+                selector.index = std::numeric_limits<std::size_t>::max();
+            }
+            else {
+                selector.index = selector.index * 10 + digitValue;
+            }
+        }
+        fragment.selectors.push(selector);
     }
 }
 
@@ -1109,9 +1251,12 @@ void ParseFormatParameter(const char* formatParameter, std::vector<FormatFragmen
 
 
 /**
- * This function prepares the output stream for outputting the integer format from the format specifiers in
+ * This function prepares the output stream for outputting the decimal number format from the format specifiers in
  * @p specifiers.
  *
+ * Only the number itself is written by the stream, the width, fill and alignment are not set on the stream, since
+ * the written number is padded afterwards by AppendLayout.
+ *
  * When calling this function make sure to check the value of @p useValue, if this is false then do not print the
  * value to the stream as this has already been done.
  *
@@ -1141,14 +1286,6 @@ void PreprocessStreamForDecimal(const BasicFormatSpecifiers& specifiers, std::os
     // The default minimum precision to use
     minPrecision = 1;
 
-    // Set the minimum width of the output
-    ostr << std::setw(specifiers.width);
-
-    // Set the fill character if it needs to be set
-    if (specifiers.fill) {
-        ostr << std::setfill(specifiers.fill);
-    }
-
     // Set the precision
     if (specifiers.precision >= 0) {
         ostr << std::setprecision(specifiers.precision);
@@ -1161,55 +1298,10 @@ void PreprocessStreamForDecimal(const BasicFormatSpecifiers& specifiers, std::os
         ostr.imbue(loc);
     }
 
-    switch (specifiers.sign) {
-        // Nothing really needs to be done for this, this is default behavior, show a sign character for negatives
-        // only.
-        case FORMAT_SIGN_NEGATIVES_TOGGLE:
-            break;
-
-        // When setting the sign character to +, numbers will always have a sign of either + or -. Negative numbers
-        // will have a - sign, and 0 and positive numbers will have a +.
-        case FORMAT_SIGN_ALWAYS_TOGGLE:
-            ostr << std::showpos;
-            break;
-
-        // Like with +, this will always show a sign character, however the sign character for 0 or positive numbers
-        // will be a space. This sets the width of the stream to 0, as it requires some post processing, it is simply
-        // not supported directly by the underlying stream.
-        case FORMAT_SIGN_POSITIVE_SPACE_TOGGLE:
-            ostr << std::setw(0);
-            break;
-
-        // Ignore unknown sign characters.
-        default:
-            break;
-    }
-
-    switch (specifiers.align) {
-        // Will align the value to the left:
-        // [-xxxx    ]
-        case FORMAT_ALIGN_LEFT:
-            ostr << std::left;
-            break;
-
-        // Will align the value to the right, and the sign to the left:
-        // [-    xxxx]
-        case FORMAT_ALIGN_INTERNAL:
-            ostr << std::internal;
-            break;
-
-        // Will center the value and sign:
-        // [  -xxxx  ]
-        case FORMAT_ALIGN_CENTER:
-            // This needs to be processed afterwards, for now make sure we only have the raw data
-            ostr << std::setw(0);
-            break;
-
-        // Will align the value to the right:
-        // [    -xxxx]
-        case FORMAT_ALIGN_RIGHT:
-        default:
-            ostr << std::right;
+    // When setting the sign character to +, numbers will always have a sign of either + or -. Negative numbers will
+    // have a - sign, and 0 and positive numbers will have a +.  The space sign is added by the layout.
+    if (specifiers.sign == FORMAT_SIGN_ALWAYS_TOGGLE) {
+        ostr << std::showpos;
     }
 
     switch (specifiers.type) {
@@ -1267,862 +1359,3888 @@ void PreprocessStreamForDecimal(const BasicFormatSpecifiers& specifiers, std::os
 
 
 /**
- * Post processing written doubles to the output stream.
+ * The parts a formatted value consists of, before it is padded to the width of the field.
  *
- * Prints the written string in the following format to the ostr stream:
+ * The parts are laid out by AppendLayout in the following order, where the fill is distributed according to the
+ * alignment:
  *
- * [left padding][sign][type][fill][written string][right padding]
+ * [fill][sign][prefix][fill][body][suffix][fill]
  *
- * @param[in] writtenString  The actual string that should be written to the output string if no post processing is
- *            needed.
- * @param[in] specifiers  The format specifiers used for this
- * @param[out] ostr  The output string to write the finalized string to.
- * @param[in] value  The value that should be formatted and output.
+ * None of the parts are owned, they must remain valid until the value has been laid out.
  */
-void PostprocessStreamForDecimal(std::string&& writtenString, const BasicFormatSpecifiers& specifiers,
-        std::ostream& ostr, const long double& value)
+struct LayoutParts
 {
-    int contentWidth = static_cast<int>(writtenString.size());
-    bool addPadding = (specifiers.sign == FORMAT_SIGN_POSITIVE_SPACE_TOGGLE || specifiers.align == FORMAT_ALIGN_CENTER);
-    char fillCharToUse = specifiers.fill ? specifiers.fill : ' ';
-
-    // If the sign is a space, we should make room for it in the calculations, it has not been added to the
-    // writtenString yet.
-    if (specifiers.sign == FORMAT_SIGN_POSITIVE_SPACE_TOGGLE && value >= 0) {
-        ++contentWidth;
-    }
-    else if (specifiers.sign == FORMAT_SIGN_POSITIVE_SPACE_TOGGLE && value < 0 && specifiers.align == FORMAT_ALIGN_INTERNAL) {
-        // Remove sign, we do not need to add to contentWidth here since the sign was included.
-        writtenString.erase(0, 1);
-    }
-
-    // If the number should be prefixed with the base (0b, 0o, 0x, 0X) make room for it.
-    if (specifiers.alternateForm && strchr("boxX", specifiers.type) != nullptr) {
-        contentWidth += 2;
-    }
-
-    // Calculate the paddings: [left][sign][center][value][right]
-    int paddingLeft = 0;
-    int paddingCenter = 0;
-    int paddingRight = 0;
-    if (addPadding) {
-        switch (specifiers.align) {
-            case FORMAT_ALIGN_LEFT:
-                paddingRight = specifiers.width - contentWidth;
-                break;
-
-            case FORMAT_ALIGN_CENTER:
-                paddingLeft = (specifiers.width - contentWidth) / 2;
-                paddingRight = specifiers.width - paddingLeft - contentWidth;
-                break;
-
-            case FORMAT_ALIGN_INTERNAL:
-                paddingCenter = specifiers.width - contentWidth;
-                break;
+    /**
+     * The sign character of the value, or '\0' if the value has no sign.
+     */
+    char sign;
 
-            case FORMAT_ALIGN_RIGHT:
-            default:
-                paddingLeft = specifiers.width - contentWidth;
-                break;
-        }
-    }
+    /**
+     * The alternate form prefix (such as "0x") and its length.
+     */
+    const char* prefix;
+    std::size_t prefixLength;
 
-    // Add the left padding if any.
-    if (addPadding && paddingLeft > 0) {
-        ostr << std::setw(paddingLeft)
-             << std::setfill(fillCharToUse)
-             << fillCharToUse
-             << std::setw(0)
-             << std::setfill('\0');
-    }
+    /**
+     * The digits or text of the value and its length.
+     */
+    const char* body;
+    std::size_t bodyLength;
 
-    // Write the sign characters.
-    if (specifiers.sign == FORMAT_SIGN_POSITIVE_SPACE_TOGGLE && value >= 0) {
-        ostr << ' ';
-    }
-    else if (specifiers.sign == FORMAT_SIGN_POSITIVE_SPACE_TOGGLE && value < 0 && specifiers.align == FORMAT_ALIGN_INTERNAL) {
-        ostr << '-';
-    }
+    /**
+     * The text following the value (such as '%' for percentages) and its length.
+     */
+    const char* suffix;
+    std::size_t suffixLength;
 
-    // Add the center padding if any.
-    if (addPadding && paddingCenter > 0) {
-        ostr << std::setw(paddingCenter)
-             << std::setfill(fillCharToUse)
-             << fillCharToUse
-             << std::setw(0)
-             << std::setfill('\0');
+    LayoutParts(const char* body, std::size_t bodyLength) noexcept
+        : sign('\0'), prefix(nullptr), prefixLength(0), body(body), bodyLength(bodyLength), suffix(nullptr),
+          suffixLength(0)
+    {
     }
+};
 
-    // If alternate form, prefix with the base.
-    if (specifiers.alternateForm) {
-        switch (specifiers.type) {
-            case FORMAT_BINARY_TOGGLE:
-                ostr << "0b";
-                break;
-
-            case FORMAT_OCTAL_TOGGLE:
-                ostr << "0o";
-                break;
-
-            case FORMAT_LOWERCASE_HEX_TOGGLE:
-                ostr << "0x";
-                break;
 
-            case FORMAT_UPPERCASE_HEX_TOGGLE:
-                ostr << "0X";
-                break;
+/**
+ * Gets the alternate form prefix of a presentation type, that is the base prefix written by the alternate form
+ * option.
+ *
+ * @param[in] type  The presentation type to get the prefix of.
+ *
+ * @return Returns "0b", "0o", "0x", or "0X" for the binary, octal and hexadecimal presentation types, for all other
+ *         types nullptr is returned.
+ */
+const char* GetAlternateFormPrefix(char type) noexcept
+{
+    switch (type) {
+        case FORMAT_BINARY_TOGGLE:
+            return "0b";
 
-            default:
-                // Ignore unknown alternate forms
-                break;
-        }
-    }
+        case FORMAT_OCTAL_TOGGLE:
+            return "0o";
 
-    // Write the value.
-    ostr << writtenString;
+        case FORMAT_LOWERCASE_HEX_TOGGLE:
+            return "0x";
 
-    if (specifiers.type == FORMAT_PERCENTAGE_MODE) {
-        ostr << FORMAT_PERCENTAGE_MODE;
-    }
+        // Python (tested in 3.3.2) uses an upper case 0X with the upper case hex type.
+        case FORMAT_UPPERCASE_HEX_TOGGLE:
+            return "0X";
 
-    // Add the right padding.
-    if (addPadding && paddingRight > 0) {
-        ostr << std::setw(paddingRight)
-             << std::setfill(fillCharToUse)
-             << fillCharToUse;
+        default:
+            return nullptr;
     }
 }
 
 
 /**
- * This function prepares the output stream for outputting the integer format from the format specifiers in
- * @p specifiers.
+ * Appends a formatted value to a string, padding it to the width and alignment of the format specifiers.
  *
- * When calling this function make sure to check the value of @p useValue, if this is false then do not print the
- * value to the stream as this has already been done.
+ * This is the layout engine shared by all presentation types, the padding is calculated up front from the lengths of
+ * the parts, so the sink is grown once and the parts and fill are copied straight into it.  The width covers all of
+ * the parts, including the sign, prefix and suffix, as described in PEP-3101:
  *
- * @param[in]     specifiers  The format specifiers, this is the parsed format options.
- * @param[in,out] ostr  The stream to configure, and to use for output.
- * @param[in,out] value  The value to format and output.
- * @param[out]    useValue  A boolean value of true or false, specifying whether to write the value or not, if this is
- *                set to false, the value should not be written by the caller, because it is already written.
+ * @arg @c '<' [sign][prefix][body][suffix][fill]
+ * @arg @c '>' [fill][sign][prefix][body][suffix]
+ * @arg @c '=' [sign][prefix][fill][body][suffix]
+ * @arg @c '^' [fill][sign][prefix][body][suffix][fill], with the smaller half of the fill to the left.
+ *
+ * @param[in] parts  The parts of the value to lay out.
+ * @param[in] specifiers  The format specifiers holding the width, fill and alignment.
+ * @param[in] defaultAlign  The alignment to use if the format specifiers does not specify one.
+ * @param[out] sink  The string to append the laid out value to.
  */
-void PreprocessStreamForInteger(const BasicFormatSpecifiers& specifiers, std::ostream& ostr, long long& value,
-        bool& useValue)
+void AppendLayout(const LayoutParts& parts, const BasicFormatSpecifiers& specifiers, char defaultAlign,
+        std::string& sink)
 {
-    // By default use the value.
-    useValue = true;
-
-    // Set the minimum width of the output
-    ostr << std::setw(specifiers.width);
-
-    // Set the fill character if it needs to be set
-    if (specifiers.fill) {
-        ostr << std::setfill(specifiers.fill);
-    }
-
-    // If thousands separator is set imbue a locale, since the PEP-3101 dictates that the thousands separator should
-    // be a ',' we use a custom numpunct class reporting the thousands separator as a comma.
-    if (specifiers.thousandSeparator) {
-        std::locale loc(ostr.getloc(), new AlwaysCommaAsThousandsSep);
-        ostr.imbue(loc);
-    }
-
-    switch (specifiers.sign) {
-        // Nothing really needs to be done for this, this is default behavior, show a sign character for negatives
-        // only.
-        case FORMAT_SIGN_NEGATIVES_TOGGLE:
-            break;
-
-        // When setting the sign character to +, numbers will always have a sign of either + or -. Negative numbers
-        // will have a - sign, and 0 and positive numberes will have a +.
-        case FORMAT_SIGN_ALWAYS_TOGGLE:
-            ostr << std::showpos;
-            break;
-
-        // Like with +, this will always show a sign character, however the sign character for 0 or positive numbers
-        // will be a space. This sets the width of the stream to 0, as it requires some post processing, it is simply
-        // not supported directly by the underlying stream.
-        case FORMAT_SIGN_POSITIVE_SPACE_TOGGLE:
-            ostr << std::setw(0);
-            break;
-
-        // Ignore unkown sign character settings.
-        default:
-            break;
-    }
-
-    switch (specifiers.align) {
-        // Will align the value to the left:
-        // [-xxxx    ]
+    std::size_t contentWidth = (parts.sign ? 1 : 0) + parts.prefixLength + parts.bodyLength + parts.suffixLength;
+    std::size_t width = specifiers.width > 0 ? static_cast<std::size_t>(specifiers.width) : 0;
+    std::size_t padding = width > contentWidth ? width - contentWidth : 0;
+
+    // Calculate the paddings: [left][sign][prefix][center][body][suffix][right]
+    std::size_t paddingLeft = 0;
+    std::size_t paddingCenter = 0;
+    std::size_t paddingRight = 0;
+    switch (specifiers.align ? specifiers.align : defaultAlign) {
         case FORMAT_ALIGN_LEFT:
-            ostr << std::left;
+            paddingRight = padding;
             break;
 
-        // Will align the value to the right, and the sign to the left:
-        // [-    xxxx]
-        case FORMAT_ALIGN_INTERNAL:
-            ostr << std::internal;
+        case FORMAT_ALIGN_CENTER:
+            paddingLeft = padding / 2;
+            paddingRight = padding - paddingLeft;
             break;
 
-        // Will center the value and sign:
-        // [  -xxxx  ]
-        case FORMAT_ALIGN_CENTER:
-            // This needs to be processed afterwards, for now make sure we only have the raw data
-            ostr << std::setw(0);
+        case FORMAT_ALIGN_INTERNAL:
+            paddingCenter = padding;
             break;
 
-        // Will align the value to the right:
-        // [    -xxxx]
         case FORMAT_ALIGN_RIGHT:
         default:
-            ostr << std::right;
-    }
-
-    switch (specifiers.type) {
-        // Write number as binary number (skip leading zeroes).
-        case FORMAT_BINARY_TOGGLE:
-            {
-                // Generally this needs to be done later
-                ostr << std::noshowpos;
-                // Use the bitset's built in to string method
-                std::bitset<64> helper{static_cast<unsigned long long>(value)};
-                std::string binaryString = helper.to_string();
-                // Find first significant bit, 63 since we show at least one bit
-                int index = 0;
-                while (index < 63 && binaryString[index] == '0') {
-                    ++index;
-                }
-                ostr << (binaryString.c_str() + index);
-                // Since we have already output the value, let's not do it again
-                useValue = false;
-            };
-            break;
-
-        // Normally this would print the unicode character corresponding to the number, but this has been left out for
-        // now, it might be introduced at some later point
-        case FORMAT_UNICODE_CHAR_TOGGLE:
-            break;
-
-        // Print the number in octal format
-        case FORMAT_OCTAL_TOGGLE:
-            ostr << std::oct;
-            break;
-
-        // Print the number in hex format using upper case letters (A-Z) and apparently (found out through tests in
-        // Python 3.3.2) also upper case 0X.
-        case FORMAT_UPPERCASE_HEX_TOGGLE:
-            // Hex format
-            ostr << std::uppercase;
-            /* no break */
-        case FORMAT_LOWERCASE_HEX_TOGGLE:
-            ostr << std::hex;
+            paddingLeft = padding;
             break;
+    }
 
-        // Print the number in the localized version, using the thousands separator character of the locale.
-        case FORMAT_LOCALIZED_NUMBER_TOGGLE:
-            ostr.imbue(std::locale(""));
-            break;
+    const char fillCharToUse = specifiers.fill ? specifiers.fill : ' ';
+    const std::size_t offset = sink.size();
+    sink.resize(offset + contentWidth + padding);
+    char* out = &sink[offset];
 
-        // Ordinary integer number
-        case FORMAT_NORMAL_NUMBER_TOGGLE:
-        default:
-            break;
+    std::memset(out, fillCharToUse, paddingLeft);
+    out += paddingLeft;
+    if (parts.sign) {
+        *out++ = parts.sign;
     }
+    if (parts.prefixLength > 0) {
+        std::memcpy(out, parts.prefix, parts.prefixLength);
+        out += parts.prefixLength;
+    }
+    std::memset(out, fillCharToUse, paddingCenter);
+    out += paddingCenter;
+    if (parts.bodyLength > 0) {
+        std::memcpy(out, parts.body, parts.bodyLength);
+        out += parts.bodyLength;
+    }
+    if (parts.suffixLength > 0) {
+        std::memcpy(out, parts.suffix, parts.suffixLength);
+        out += parts.suffixLength;
+    }
+    std::memset(out, fillCharToUse, paddingRight);
 }
 
 
 /**
- * Post processing written text to the output stream.
- *
- * Prints the written string in the following format to the ostr stream:
+ * Compile time description of an integer type, used by the integer kernels.
  *
- * [left padding][sign][type][fill][written string][right padding]
+ * @c unsigned_type is the unsigned type of the same width, used to hold the magnitude of a value. @c bits_type is the
+ * unsigned type used when a negative value is written in binary, octal or hexadecimal, these have always been written
+ * as 64-bit two's complement, so this is kept for all types up to 64 bits, while the 128-bit types use their own width.
+ * @c arithmetic_type is the type the special functions (abs, inc, etc.) operate in, types narrower than long long are
+ * widened to avoid overflowing, like they have always been.  The standard std::make_unsigned is not used since it does
+ * not know the 128-bit integer types when compiling in strict ISO mode.
  *
- * @param[in] writtenString  The actual string that should be written to the output string if no post processing is
- *            needed.
- * @param[in] specifiers  The format specifiers used for this
- * @param[out] ostr  The output string to write the finalized string to.
- * @param[in] value  The value that should be formatted and output.
+ * @tparam T The integer type to describe.
  */
-void PostprocessStreamForInteger(std::string&& writtenString, const BasicFormatSpecifiers& specifiers,
-        std::ostream& ostr, const long long& value)
+template <typename T>
+struct IntegerTraits;
+
+template <>
+struct IntegerTraits<short>
 {
-    int contentWidth = static_cast<int>(writtenString.size());
-    bool addPadding = (specifiers.sign == FORMAT_SIGN_POSITIVE_SPACE_TOGGLE || specifiers.align == FORMAT_ALIGN_CENTER);
-    char fillCharToUse = specifiers.fill ? specifiers.fill : ' ';
+    typedef unsigned short unsigned_type;
+    typedef unsigned long long bits_type;
+    typedef long long arithmetic_type;
+};
 
-    // If the sign is a space, we should make room for it in the calculations, it has not been added to the
-    // writtenString yet.
-    if (specifiers.sign == FORMAT_SIGN_POSITIVE_SPACE_TOGGLE && value >= 0) {
-        ++contentWidth;
-    }
-    else if (specifiers.sign == FORMAT_SIGN_POSITIVE_SPACE_TOGGLE && value < 0
-            && specifiers.align == FORMAT_ALIGN_INTERNAL) {
-        // Remove sign, we do not need to add to contentWidth here since the sign was included.
-        writtenString.erase(0, 1);
-    }
+template <>
+struct IntegerTraits<unsigned short>
+{
+    typedef unsigned short unsigned_type;
+    typedef unsigned long long bits_type;
+    typedef unsigned long long arithmetic_type;
+};
 
-    // If the number should be prefixed with the base (0b, 0o, 0x, 0X) make room for it.
-    if (specifiers.alternateForm && strchr("boxX", specifiers.type) != nullptr) {
-        contentWidth += 2;
-    }
+template <>
+struct IntegerTraits<int>
+{
+    typedef unsigned int unsigned_type;
+    typedef unsigned long long bits_type;
+    typedef long long arithmetic_type;
+};
 
-    // Calculate the paddings: [left][sign][center][value][right]
-    int paddingLeft = 0;
-    int paddingCenter = 0;
-    int paddingRight = 0;
-    if (addPadding) {
-        switch (specifiers.align) {
-            case FORMAT_ALIGN_LEFT:
-                paddingRight = specifiers.width - contentWidth;
-                break;
+template <>
+struct IntegerTraits<unsigned int>
+{
+    typedef unsigned int unsigned_type;
+    typedef unsigned long long bits_type;
+    typedef unsigned long long arithmetic_type;
+};
 
-            case FORMAT_ALIGN_CENTER:
-                paddingLeft = (specifiers.width - contentWidth) / 2;
-                paddingRight = specifiers.width - paddingLeft - contentWidth;
-                break;
+template <>
+struct IntegerTraits<long>
+{
+    typedef unsigned long unsigned_type;
+    typedef unsigned long long bits_type;
+    typedef long arithmetic_type;
+};
 
-            case FORMAT_ALIGN_INTERNAL:
-                paddingCenter = specifiers.width - contentWidth;
-                break;
+template <>
+struct IntegerTraits<unsigned long>
+{
+    typedef unsigned long unsigned_type;
+    typedef unsigned long long bits_type;
+    typedef unsigned long arithmetic_type;
+};
 
-            case FORMAT_ALIGN_RIGHT:
-            default:
-                paddingLeft = specifiers.width - contentWidth;
-                break;
-        }
-    }
+template <>
+struct IntegerTraits<long long>
+{
+    typedef unsigned long long unsigned_type;
+    typedef unsigned long long bits_type;
+    typedef long long arithmetic_type;
+};
 
-    // Add the left padding if any.
-    if (addPadding && paddingLeft > 0) {
-        ostr << std::setw(paddingLeft)
-             << std::setfill(fillCharToUse)
-             << fillCharToUse
-             << std::setw(0)
-             << std::setfill('\0');
-    }
+template <>
+struct IntegerTraits<unsigned long long>
+{
+    typedef unsigned long long unsigned_type;
+    typedef unsigned long long bits_type;
+    typedef unsigned long long arithmetic_type;
+};
 
-    // Write the sign characters.
-    if (specifiers.sign == FORMAT_SIGN_POSITIVE_SPACE_TOGGLE && value >= 0) {
-        ostr << ' ';
-    }
-    else if (specifiers.sign == FORMAT_SIGN_POSITIVE_SPACE_TOGGLE && value < 0 && specifiers.align == FORMAT_ALIGN_INTERNAL) {
-        ostr << '-';
-    }
+#ifdef FORMAT_HAS_INT128
+template <>
+struct IntegerTraits<__int128>
+{
+    typedef unsigned __int128 unsigned_type;
+    typedef unsigned __int128 bits_type;
+    typedef __int128 arithmetic_type;
+};
 
-    // Add the center padding if any.
-    if (addPadding && paddingCenter > 0) {
-        ostr << std::setw(paddingCenter)
-             << std::setfill(fillCharToUse)
-             << fillCharToUse
-             << std::setw(0)
-             << std::setfill('\0');
-    }
+template <>
+struct IntegerTraits<unsigned __int128>
+{
+    typedef unsigned __int128 unsigned_type;
+    typedef unsigned __int128 bits_type;
+    typedef unsigned __int128 arithmetic_type;
+};
+#endif  // FORMAT_HAS_INT128
 
-    // If alternate form, prefix with the base.
-    if (specifiers.alternateForm) {
-        switch (specifiers.type) {
-            case FORMAT_BINARY_TOGGLE:
-                ostr << "0b";
-                break;
 
-            case FORMAT_OCTAL_TOGGLE:
-                ostr << "0o";
-                break;
+/**
+ * The largest number of characters an integer can be written as, this is a 128-bit integer written in binary.  With
+ * thousands separators a decimal, octal or hexadecimal number never gets longer than this.
+ */
+const int INTEGER_BUFFER_SIZE = 130;
 
-            case FORMAT_LOWERCASE_HEX_TOGGLE:
-                ostr << "0x";
-                break;
+/**
+ * Pairs of decimal digits for the numbers 00 to 99, this allows writing two digits per division.
+ */
+const char DECIMAL_DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
 
-            case FORMAT_UPPERCASE_HEX_TOGGLE:
-                ostr << "0X";
-                break;
+/**
+ * Digits used for bases up to 16, using lower case letters.
+ */
+const char LOWERCASE_DIGITS[] = "0123456789abcdef";
 
-            default:
-                // Ignore unknown alternate forms.
-                break;
-        }
-    }
+/**
+ * Digits used for bases up to 16, using upper case letters.
+ */
+const char UPPERCASE_DIGITS[] = "0123456789ABCDEF";
 
-    // Write the value.
-    ostr << writtenString;
 
-    // Add the right padding.
-    if (addPadding && paddingRight > 0) {
-        ostr << std::setw(paddingRight)
-             << std::setfill(fillCharToUse)
-             << fillCharToUse;
-    }
+#ifdef FORMAT_USE_SSE2
+/**
+ * Converts a value below 100000000 to its eight decimal digits using SSE2, the digits are returned as 16-bit lanes,
+ * most significant digit first.
+ *
+ * The value is split in two groups of four digits, which are then divided by 1000, 100, 10, and 1 in parallel using
+ * fixed-point multiplications, finally subtracting ten times the digits above gives the individual digits.  This is
+ * the algorithm by Wojciech Mula, as used in Milo Yip's itoa-benchmark.
+ *
+ * @param[in] value  The value to convert, must be less than 100000000.
+ *
+ * @return Returns the eight digits, as values 0-9, in eight 16-bit lanes.
+ */
+inline __m128i ConvertEightDigitsSse2(unsigned value) noexcept
+{
+    const __m128i abcdefgh = _mm_cvtsi32_si128(static_cast<int>(value));
+    // abcd = abcdefgh / 10000, efgh = abcdefgh % 10000
+    const __m128i abcd = _mm_srli_epi64(_mm_mul_epu32(abcdefgh, _mm_set1_epi32(static_cast<int>(0xd1b71759))), 45);
+    const __m128i efgh = _mm_sub_epi32(abcdefgh, _mm_mul_epu32(abcd, _mm_set1_epi32(10000)));
+    // [abcd * 4, abcd * 4, abcd * 4, abcd * 4, efgh * 4, efgh * 4, efgh * 4, efgh * 4]
+    const __m128i v1 = _mm_slli_epi64(_mm_unpacklo_epi16(abcd, efgh), 2);
+    const __m128i v2 = _mm_unpacklo_epi32(_mm_unpacklo_epi16(v1, v1), _mm_unpacklo_epi16(v1, v1));
+    // [a, ab, abc, abcd, e, ef, efg, efgh]
+    const __m128i v3 = _mm_mulhi_epu16(v2, _mm_setr_epi16(8389, 5243, 13108, -32768, 8389, 5243, 13108, -32768));
+    const __m128i v4 = _mm_mulhi_epu16(v3, _mm_setr_epi16(1 << 7, 1 << 11, 1 << 13, -32768,
+                                                          1 << 7, 1 << 11, 1 << 13, -32768));
+    // [a, b, c, d, e, f, g, h]
+    const __m128i v5 = _mm_slli_epi64(_mm_mullo_epi16(v4, _mm_set1_epi16(10)), 16);
+    return _mm_sub_epi16(v4, v5);
 }
 
 
 /**
- * Sets up the output stream for outputting a formatted string.
+ * Writes the decimal digits of a value of at least 100000000 backwards into a buffer, using SSE2 to generate sixteen
+ * digits in parallel.
  *
- * This function sets up the stream to comply with the format specifiers in parameter @p specifiers so that the value
- * output follows the desired formatting.  Not all formatting can be done within the function, these will be handled
- * by the PostprocessStreamForString method.
+ * @param[in] value  The value to write, must be at least 100000000.
+ * @param[out] end  Pointer to the character just after the last digit to write, there must be room for at least 20
+ *             characters before it.
  *
- * @param[in] specifiers  The format specifiers to use for formatting this string.
- * @param[out] ostr  The output stream to to format and use for formatted output, note that the actual string is not
- *             written to the stream yet.
- * @param[in] unnamed  This parameter is not used by this function, and is as such unnamed.
- * @param[out] useValue  Indicates whether or not the outer function should write the value to the stream, this is
- *             always true, indicating that it should.
+ * @return Returns a pointer to the first (most significant) digit written.
  */
-void PreprocessStreamForString(const BasicFormatSpecifiers& specifiers, std::ostream& ostr, const char*,
-        bool& useValue)
+inline char* WriteDecimalDigitsSse2(unsigned long long value, char* end) noexcept
 {
-    // By default use the value.
-    useValue = true;
+    const unsigned long long tenToSixteen = 10000000000000000ull;
+    unsigned long long top = value / tenToSixteen;
+    unsigned long long low = value % tenToSixteen;
+    const __m128i digits = _mm_add_epi8(_mm_packus_epi16(ConvertEightDigitsSse2(static_cast<unsigned>(low / 100000000)),
+                                                         ConvertEightDigitsSse2(static_cast<unsigned>(low % 100000000))),
+                                        _mm_set1_epi8('0'));
+    char* start = end - 16;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(start), digits);
+    if (top > 0) {
+        // At most four digits remain, value is below 2^64.
+        unsigned remaining = static_cast<unsigned>(top);
+        do {
+            *--start = static_cast<char>('0' + remaining % 10);
+            remaining /= 10;
+        } while (remaining > 0);
+        return start;
+    }
+    // Skip the leading zeroes, the value is at least 100000000 so there are at least nine digits.
+    unsigned nonZeroes = ~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(digits, _mm_set1_epi8('0'))));
+    int leadingZeroes = 0;
+    while ((nonZeroes & (1u << leadingZeroes)) == 0) {
+        ++leadingZeroes;
+    }
+    return start + leadingZeroes;
+}
+#endif  // FORMAT_USE_SSE2
 
-    // Set the minimum width of the output
-    ostr << std::setw(specifiers.width);
 
-    // Set the fill character if it needs to be set
-    if (specifiers.fill) {
-        ostr << std::setfill(specifiers.fill);
+/**
+ * Writes the decimal digits of an unsigned integer backwards into a buffer.
+ *
+ * The digits are written right to left, ending just before @p end, two digits at a time.  At least one digit is always
+ * written, so 0 is written as "0".
+ *
+ * @param[in] value  The value to write.
+ * @param[out] end  Pointer to the character just after the last digit to write.
+ *
+ * @return Returns a pointer to the first (most significant) digit written.
+ */
+template <typename U>
+char* WriteDecimalDigits(U value, char* end) noexcept
+{
+#ifdef FORMAT_USE_SSE2
+    if (value >= 100000000) {
+        return WriteDecimalDigitsSse2(static_cast<unsigned long long>(value), end);
+    }
+#endif  // FORMAT_USE_SSE2
+    while (value >= 100) {
+        unsigned index = static_cast<unsigned>(value % 100) * 2;
+        value /= 100;
+        *--end = DECIMAL_DIGIT_PAIRS[index + 1];
+        *--end = DECIMAL_DIGIT_PAIRS[index];
+    }
+    if (value >= 10) {
+        unsigned index = static_cast<unsigned>(value) * 2;
+        *--end = DECIMAL_DIGIT_PAIRS[index + 1];
+        *--end = DECIMAL_DIGIT_PAIRS[index];
+    }
+    else {
+        *--end = static_cast<char>('0' + static_cast<unsigned>(value));
     }
+    return end;
+}
 
-    switch (specifiers.align) {
-        // Will align the value to the right:
-        // [    xxxxx]
-        case FORMAT_ALIGN_RIGHT:
-            ostr << std::right;
-            break;
+#ifdef FORMAT_HAS_INT128
+/**
+ * Writes the decimal digits of an unsigned 128-bit integer backwards into a buffer.
+ *
+ * 128-bit division is expensive, so the value is split into chunks of 19 digits, each of which fits in 64 bits, and
+ * the chunks are written using 64-bit arithmetic only.
+ *
+ * @param[in] value  The value to write.
+ * @param[out] end  Pointer to the character just after the last digit to write.
+ *
+ * @return Returns a pointer to the first (most significant) digit written.
+ */
+template <>
+char* WriteDecimalDigits<unsigned __int128>(unsigned __int128 value, char* end) noexcept
+{
+    const unsigned long long chunkDivisor = 10000000000000000000ull;
+    while (value > std::numeric_limits<unsigned long long>::max()) {
+        unsigned long long chunk = static_cast<unsigned long long>(value % chunkDivisor);
+        value /= chunkDivisor;
+        char* chunkStart = WriteDecimalDigits(chunk, end);
+        // Inner chunks must be zero padded to their full 19 digits.
+        while (end - chunkStart < 19) {
+            *--chunkStart = '0';
+        }
+        end = chunkStart;
+    }
+    return WriteDecimalDigits(static_cast<unsigned long long>(value), end);
+}
+#endif  // FORMAT_HAS_INT128
 
-        // Will align the value to the right, and the sign to the left, however sign is not really used in strings so
-        // it does not really produce any difference from right aligning text, Python does not allow this for strings:
-        // [    xxxxx]
-        case FORMAT_ALIGN_INTERNAL:
-            ostr << std::internal;
-            break;
 
-        // Will center the text:
-        // [  xxxxx  ]
-        case FORMAT_ALIGN_CENTER:
-            // This needs to be processed afterwards, for now make sure we only have the raw data
-            ostr << std::setw(0);
+/**
+ * Writes the digits of an unsigned integer in a base that is a power of two (2, 8 or 16) backwards into a buffer.
+ *
+ * @param[in] value  The value to write.
+ * @param[in] bitsPerDigit  The number of bits per digit, 1 for binary, 3 for octal and 4 for hexadecimal.
+ * @param[in] digits  The characters to use for the digits.
+ * @param[out] end  Pointer to the character just after the last digit to write.
+ *
+ * @return Returns a pointer to the first (most significant) digit written.
+ */
+template <typename U>
+char* WritePowerOfTwoDigits(U value, unsigned bitsPerDigit, const char* digits, char* end) noexcept
+{
+    const unsigned mask = (1u << bitsPerDigit) - 1;
+    do {
+        *--end = digits[static_cast<unsigned>(value) & mask];
+        value >>= bitsPerDigit;
+    } while (value != 0);
+    return end;
+}
+
+
+/**
+ * Inserts thousands separators into a string of digits.
+ *
+ * The digits are grouped from the right, following the rules of std::numpunct::grouping: each character of
+ * @p grouping is the size of a group, the last size is repeated for the remaining digits, and a size of 0 or CHAR_MAX
+ * ends the grouping.
+ *
+ * @param[in] digits  The digits to group.
+ * @param[in] count  The number of digits.
+ * @param[in] grouping  The grouping rules.
+ * @param[in] separator  The separator to insert between the groups.
+ * @param[out] out  The buffer to write the grouped digits to, this must have room for up to 2 * @p count characters.
+ *
+ * @return Returns the number of characters written to @p out.
+ */
+int GroupDigits(const char* digits, int count, const std::string& grouping, char separator, char* out) noexcept
+{
+    // Count the separators first, the digits to the left of the last separator form the leading group.
+    int separators = 0;
+    int leading = count;
+    std::string::size_type index = 0;
+    while (index < grouping.size()) {
+        int size = static_cast<signed char>(grouping[index]);
+        if (size <= 0 || grouping[index] == std::numeric_limits<char>::max() || leading <= size) {
             break;
+        }
+        leading -= size;
+        ++separators;
+        if (index + 1 < grouping.size()) {
+            ++index;
+        }
+    }
 
-        // Will align the value to the left (default for strings):
-        // [xxxxx    ]
-        case FORMAT_ALIGN_LEFT:
-        default:
-            ostr << std::left;
+    // Write the groups from the right, in the order the grouping describes them.
+    const int length = count + separators;
+    const char* read = digits + count;
+    char* write = out + length;
+    index = 0;
+    for (int i = 0; i < separators; ++i) {
+        int size = static_cast<signed char>(grouping[index]);
+        read -= size;
+        write -= size;
+        std::memcpy(write, read, static_cast<size_t>(size));
+        *--write = separator;
+        if (index + 1 < grouping.size()) {
+            ++index;
+        }
     }
+    std::memcpy(out, digits, static_cast<size_t>(leading));
+    return length;
 }
 
 
 /**
- * Post processing written text to the output stream.
+ * Appends an integer of any width, formatted according to already parsed format specifiers, to a string.
  *
- * Prints the written string in the following format to the ostr stream:
+ * The digits are generated natively from @p value in its own width.  Decimal numbers are written as sign and
+ * magnitude, while binary, octal and hexadecimal numbers are written as two's complement without a sign, as described
+ * by IntegerTraits.  Binary numbers are never grouped.
  *
- * [left padding][sign][type][fill][written string][right padding]
- *
- * @param[in] writtenString  The actual string that should be written to the output string if no post processing is
- *            needed.
- * @param[in] specifiers  The format specifiers used for this
- * @param[out] ostr  The output string to write the finalized string to.
- * @param[in] unnamed  This parameter is not used here.
+ * @param[in] value  The value to format.
+ * @param[in] specifiers  The parsed format specifiers to use.
+ * @param[out] sink  The string to append the formatted value to.
  */
-void PostprocessStreamForString(std::string&& writtenString, const BasicFormatSpecifiers& specifiers,
-        std::ostream& ostr, const char*)
+template <typename T>
+void AppendInteger(T value, const BasicFormatSpecifiers& specifiers, std::string& sink)
 {
-    int contentWidth = static_cast<int>(writtenString.size());
-    bool addPadding = specifiers.align == FORMAT_ALIGN_CENTER;
-    char fillCharToUse = specifiers.fill ? specifiers.fill : ' ';
+    typedef typename IntegerTraits<T>::unsigned_type Unsigned;
+    typedef typename IntegerTraits<T>::bits_type Bits;
 
-    // Calculate the paddings: [left][value][right]
-    int paddingLeft = 0;
-    int paddingRight = 0;
+    char buffer[INTEGER_BUFFER_SIZE];
+    char* end = buffer + INTEGER_BUFFER_SIZE;
+    char* digits = end;
+    char sign = '\0';
+    bool isBinary = false;
+    bool isNegative = value < static_cast<T>(0);
 
-    if (specifiers.precision > 0 && specifiers.precision < contentWidth) {
-        writtenString = writtenString.substr(0, static_cast<std::string::size_type>(specifiers.precision));
-        contentWidth = specifiers.precision;
-        if (specifiers.width > specifiers.precision) {
-            addPadding = true;
-        }
-    }
+    switch (specifiers.type) {
+        case FORMAT_BINARY_TOGGLE:
+            digits = WritePowerOfTwoDigits(static_cast<Bits>(value), 1, LOWERCASE_DIGITS, end);
+            isBinary = true;
+            break;
 
-    if (addPadding) {
-        switch (specifiers.align) {
-            case FORMAT_ALIGN_LEFT:
-                paddingRight = specifiers.width - contentWidth;
-                break;
+        case FORMAT_OCTAL_TOGGLE:
+            digits = WritePowerOfTwoDigits(static_cast<Bits>(value), 3, LOWERCASE_DIGITS, end);
+            break;
 
-            case FORMAT_ALIGN_CENTER:
-                paddingLeft = (specifiers.width - contentWidth) / 2;
-                paddingRight = specifiers.width - paddingLeft - contentWidth;
-                break;
+        case FORMAT_LOWERCASE_HEX_TOGGLE:
+            digits = WritePowerOfTwoDigits(static_cast<Bits>(value), 4, LOWERCASE_DIGITS, end);
+            break;
 
-            case FORMAT_ALIGN_INTERNAL:
-            case FORMAT_ALIGN_RIGHT:
-            default:
-                paddingLeft = specifiers.width - contentWidth;
-                break;
-        }
+        case FORMAT_UPPERCASE_HEX_TOGGLE:
+            digits = WritePowerOfTwoDigits(static_cast<Bits>(value), 4, UPPERCASE_DIGITS, end);
+            break;
+
+        // Decimal numbers, the unicode character type 'c' has been left out for now, and is written as a decimal.
+        default:
+            if (isNegative) {
+                sign = '-';
+                digits = WriteDecimalDigits(static_cast<Unsigned>(Unsigned(0) - static_cast<Unsigned>(value)), end);
+            }
+            else {
+                if (specifiers.sign == FORMAT_SIGN_ALWAYS_TOGGLE) {
+                    sign = '+';
+                }
+                digits = WriteDecimalDigits(static_cast<Unsigned>(value), end);
+            }
+            break;
     }
 
-    // Add the left padding if any.
-    if (addPadding && paddingLeft > 0) {
-        ostr << std::setw(paddingLeft)
-             << std::setfill(fillCharToUse)
-             << fillCharToUse
-             << std::setw(0)
-             << std::setfill('\0');
+    // The space sign is used for all presentation types, for non-negative values only.
+    if (specifiers.sign == FORMAT_SIGN_POSITIVE_SPACE_TOGGLE && !isNegative) {
+        sign = ' ';
     }
 
-    // Write the value.
-    ostr << writtenString;
+    int digitCount = static_cast<int>(end - digits);
 
-    // Add the right padding.
-    if (addPadding && paddingRight > 0) {
-        ostr << std::setw(paddingRight)
-             << std::setfill(fillCharToUse)
-             << fillCharToUse;
+    // The localized number type uses the thousands separator of the current locale, this takes precedence over the
+    // thousands separator option, which always uses a ',' with groups of three digits, as dictated by PEP-3101.
+    char grouped[2 * INTEGER_BUFFER_SIZE];
+    if (!isBinary && specifiers.type == FORMAT_LOCALIZED_NUMBER_TOGGLE) {
+        std::locale locale("");
+        const std::numpunct<char>& punct = std::use_facet<std::numpunct<char> >(locale);
+        digitCount = GroupDigits(digits, digitCount, punct.grouping(), punct.thousands_sep(), grouped);
+        digits = grouped;
+    }
+    else if (!isBinary && specifiers.thousandSeparator) {
+        digitCount = GroupDigits(digits, digitCount, "\3", ',', grouped);
+        digits = grouped;
     }
-}
 
+    LayoutParts parts(digits, static_cast<std::size_t>(digitCount));
+    parts.sign = sign;
+    if (specifiers.alternateForm) {
+        parts.prefix = GetAlternateFormPrefix(specifiers.type);
+        parts.prefixLength = parts.prefix ? 2 : 0;
+    }
+    AppendLayout(parts, specifiers, FORMAT_ALIGN_RIGHT, sink);
 }
 
-namespace utils {
-namespace str {
-
 
 /**
- * The constructor, constructing an IllegalFormatStringException for a specific format string, for an error
- * occurring at position @p pos with the error message: @p message
+ * Writes the decimal representation of an integer to a string, this is used when explicitly converting an integer to
+ * a string.
  *
- * @param[in] formatStr  The format string causing the exception to be thrown.
- * @param[in] pos  The position in the format string where the problem was detected.
- * @param[in] message  The message describing the problem found.
+ * @param[in] value  The value to convert.
+ *
+ * @return Returns the decimal representation of @p value.
  */
-IllegalFormatStringException::IllegalFormatStringException(const std::string& formatStr, int pos, const std::string& message)
-    : std::runtime_error(message)
+template <typename T>
+std::string IntegerToString(T value)
 {
-    this->formatString = formatStr;
-    this->errorPosition = pos;
-    this->message = message;
-
-    std::stringstream errorDescription;
-
-    errorDescription << "Invalid string format, error at position: " << errorPosition << std::endl;
-    errorDescription << formatString << std::endl;
-    errorDescription << std::setfill(' ') << std::setw(errorPosition) << "" << std::setfill('\0') << std::setw(0) << "^" << std::endl;
-    errorDescription << message << std::endl;
-
-    this->fullDescription = errorDescription.str();
+    typedef typename IntegerTraits<T>::unsigned_type Unsigned;
+
+    char buffer[INTEGER_BUFFER_SIZE];
+    char* end = buffer + INTEGER_BUFFER_SIZE;
+    char* digits;
+    if (value < static_cast<T>(0)) {
+        digits = WriteDecimalDigits(static_cast<Unsigned>(Unsigned(0) - static_cast<Unsigned>(value)), end);
+        *--digits = '-';
+    }
+    else {
+        digits = WriteDecimalDigits(static_cast<Unsigned>(value), end);
+    }
+    return std::string(digits, end);
 }
 
 
-IllegalFormatStringException::~IllegalFormatStringException() noexcept
+/**
+ * Checks whether a string consists of ASCII characters only, in which case every byte is a character of its own.  The
+ * string is tested sixteen bytes at a time using SSE2 when available, and otherwise eight bytes at a time.
+ *
+ * @param[in] value  The string to test.
+ * @param[in] length  The length of @p value.
+ *
+ * @return Returns true if no byte of @p value has its high bit set.
+ */
+bool IsAscii(const char* value, std::size_t length) noexcept
 {
-    // Nothing to do here...
+    std::size_t index = 0;
+#ifdef FORMAT_USE_SSE2
+    for (; index + 16 <= length; index += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(value + index));
+        if (_mm_movemask_epi8(chunk) != 0) {
+            return false;
+        }
+    }
+#endif  // FORMAT_USE_SSE2
+    for (; index + 8 <= length; index += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, value + index, sizeof(word));
+        if ((word & 0x8080808080808080ull) != 0) {
+            return false;
+        }
+    }
+    for (; index < length; ++index) {
+        if (static_cast<unsigned char>(value[index]) >= 0x80) {
+            return false;
+        }
+    }
+    return true;
 }
 
 
 /**
- * Returns the position in the format string where the error was detected.
+ * Decodes the UTF-8 encoded code point at the start of a string.
  *
- * The position returned i 0 based, so a value of 0 indicates the first character in the format string.
+ * Invalid sequences, such as a stray continuation byte, a truncated sequence, an overlong encoding or a surrogate,
+ * are decoded as a single byte holding the replacement character U+FFFD, so every byte of the string belongs to
+ * exactly one character.
  *
- * @return Returns the position in the format string where the error was detected.
+ * @param[in] value  The string to decode from.
+ * @param[in] length  The length of @p value, at least 1.
+ * @param[out] codePoint  The decoded code point.
+ *
+ * @return Returns the number of bytes used by the code point.
  */
-int IllegalFormatStringException::GetErrorPosition() const noexcept
+std::size_t DecodeCodePoint(const char* value, std::size_t length, std::uint32_t& codePoint) noexcept
 {
-    return this->errorPosition;
+    const unsigned char lead = static_cast<unsigned char>(value[0]);
+    std::size_t size;
+    std::uint32_t minimum;
+    if (lead < 0x80) {
+        codePoint = lead;
+        return 1;
+    }
+    else if ((lead & 0xE0) == 0xC0) {
+        size = 2;
+        minimum = 0x80;
+        codePoint = lead & 0x1F;
+    }
+    else if ((lead & 0xF0) == 0xE0) {
+        size = 3;
+        minimum = 0x800;
+        codePoint = lead & 0x0F;
+    }
+    else if ((lead & 0xF8) == 0xF0) {
+        size = 4;
+        minimum = 0x10000;
+        codePoint = lead & 0x07;
+    }
+    else {
+        codePoint = 0xFFFD;
+        return 1;
+    }
+
+    if (size > length) {
+        codePoint = 0xFFFD;
+        return 1;
+    }
+    for (std::size_t index = 1; index < size; ++index) {
+        const unsigned char continuation = static_cast<unsigned char>(value[index]);
+        if ((continuation & 0xC0) != 0x80) {
+            codePoint = 0xFFFD;
+            return 1;
+        }
+        codePoint = (codePoint << 6) | (continuation & 0x3F);
+    }
+    if (codePoint < minimum || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+        codePoint = 0xFFFD;
+        return 1;
+    }
+    return size;
 }
 
 
+#ifdef FORMAT_ENABLE_DISPLAY_WIDTH
 /**
- * Returns the format string that is illegal.
- *
- * @return Returns the format string that is illegal.
+ * An inclusive range of code points, used by the display width tables.
  */
-const char* IllegalFormatStringException::GetFormatString() const noexcept
+struct CodePointRange
 {
-    return this->formatString.c_str();
-}
+    std::uint32_t first;
+    std::uint32_t last;
+};
 
+/**
+ * Code points that take up no columns, combining marks, zero width spaces and joiners, and variation selectors.
+ */
+const CodePointRange ZERO_WIDTH_RANGES[] = {
+    {0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD}, {0x0610, 0x061A}, {0x064B, 0x065F}, {0x0E31, 0x0E31},
+    {0x0E34, 0x0E3A}, {0x0E47, 0x0E4E}, {0x1AB0, 0x1AFF}, {0x1DC0, 0x1DFF}, {0x200B, 0x200F}, {0x20D0, 0x20FF},
+    {0xFE00, 0xFE0F}, {0xFE20, 0xFE2F}, {0xFEFF, 0xFEFF}, {0xE0100, 0xE01EF}
+};
 
 /**
- * Returns the error message describing the error occurring from parsing the format string.
- *
- * @return Returns the error message describing the error occurring from parsing the format string.
+ * Code points that take up two columns, the wide and full width characters of East Asian scripts and emoji.
  */
-const char* IllegalFormatStringException::GetMessage() const noexcept
-{
-    return this->message.c_str();
-}
+const CodePointRange WIDE_RANGES[] = {
+    {0x1100, 0x115F}, {0x2329, 0x232A}, {0x2E80, 0x303E}, {0x3041, 0x33FF}, {0x3400, 0x4DBF}, {0x4E00, 0x9FFF},
+    {0xA000, 0xA4CF}, {0xAC00, 0xD7A3}, {0xF900, 0xFAFF}, {0xFE10, 0xFE19}, {0xFE30, 0xFE6F}, {0xFF00, 0xFF60},
+    {0xFFE0, 0xFFE6}, {0x1F300, 0x1F64F}, {0x1F900, 0x1F9FF}, {0x20000, 0x2FFFD}, {0x30000, 0x3FFFD}
+};
 
 
 /**
- * Returns a complete descriptive string about the error occurred.
- *
- * @return Returns a complete descriptive string about the error occurred.
+ * Checks whether a code point is in one of a sorted table of ranges.
  */
-const char* IllegalFormatStringException::what() const noexcept
+template <std::size_t Count>
+bool IsInRanges(std::uint32_t codePoint, const CodePointRange (&ranges)[Count]) noexcept
 {
-    return this->fullDescription.c_str();
+    std::size_t low = 0;
+    std::size_t high = Count;
+    while (low < high) {
+        const std::size_t middle = (low + high) / 2;
+        if (codePoint < ranges[middle].first) {
+            high = middle;
+        }
+        else if (codePoint > ranges[middle].last) {
+            low = middle + 1;
+        }
+        else {
+            return true;
+        }
+    }
+    return false;
 }
 
 
 /**
- * Converts the format parameter string to a struct of basic format specifiers.
- *
- * The format specifiers are extracted from the @p formatParameter argument, this function expects the input string to
- * follow the convention written in Python PEP-3101: https://www.python.org/dev/peps/pep-3101/ Which is the format
- * used for primitive types.
- *
- * @param[in]     formatParameter  The format parameter string
- * @param[out]    specifiers  The specifiers struct to store the result in
- * @param[in,out] pos  The position to begin extracting from, when this function returns this will be updated to the
- *                first position after the format specifier string.
+ * Returns the number of columns a terminal uses to display a code point, 0 for combining marks, 2 for wide East
+ * Asian characters and emoji, and 1 for everything else.
  */
-void ConvertToBasicFormatSpecifiers(const char* formatParameter, BasicFormatSpecifiers& specifiers, int& pos)
+std::size_t GetDisplayWidth(std::uint32_t codePoint) noexcept
 {
-    if (formatParameter && formatParameter[pos]) {
-        ReadAlignSpecifier(formatParameter, specifiers, pos);
-        ReadSignSpecifier(formatParameter, specifiers, pos);
-        ReadAlternateSpecifier(formatParameter, specifiers, pos);
-        ReadSignAwareZeroSpecifier(formatParameter, specifiers, pos);
-        ReadWidthSpecifier(formatParameter, specifiers, pos);
-        ReadThousandSepSpecifier(formatParameter, specifiers, pos);
-        ReadPrecisionSpecifier(formatParameter, specifiers, pos);
-        ReadTypeSpecifier(formatParameter, specifiers, pos);
+    if (codePoint < 0x0300) {
+        return 1;
     }
+    if (IsInRanges(codePoint, ZERO_WIDTH_RANGES)) {
+        return 0;
+    }
+    return IsInRanges(codePoint, WIDE_RANGES) ? 2 : 1;
 }
+#endif  // FORMAT_ENABLE_DISPLAY_WIDTH
 
 
 /**
- * Formatting function for the primitive type short, this will be called by the format function and can be called as
- * is to format an integer from a specific format specifier.
+ * The part of a string that is written when formatting it, given by its length in bytes and its width in characters.
+ */
+struct StringExtent
+{
+    std::size_t length;
+    std::size_t width;
+};
+
+
+/**
+ * Finds the part of a UTF-8 encoded string to write, that is the whole string or, with a precision, the characters
+ * that fit within the precision, and measures its width.
  *
- * To the formatter all numbers of the type: int, long, and int64 are treated equally, thus this function converts
- * @p value to an int64 and calls the corresponding FormatType function.
+ * Characters are code points, like the characters of a Python string, so a code point is never split.  If
+ * FORMAT_ENABLE_DISPLAY_WIDTH is defined, characters are measured in the columns used to display them instead, see
+ * GetDisplayWidth, so combining marks stay with the character before them and a wide character that does not fit
+ * within the precision is left out.  Pure ASCII strings, where every byte is a character of width 1, are detected
+ * with IsAscii and measured without decoding them.
  *
- * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
- * https://www.python.org/dev/peps/pep-3101/
+ * @param[in] value  The string to measure.
+ * @param[in] length  The length of @p value in bytes.
+ * @param[in] precision  The maximum width to use, 0 to use the whole string.
  *
- * @param value[in]  The value to format.
- * @param formatSpecifier[in]  The format specifier to use.
- * @param output[out]  A reference to an output stream to write the formatted result to.
+ * @return Returns the length and width of the part of @p value to write.
  */
-void FormatType(short value, const char* formatSpecifier, std::ostream& output)
+StringExtent MeasureString(const char* value, std::size_t length, int precision) noexcept
 {
-    FormatType(static_cast<long long>(value), formatSpecifier, output);
+    const std::size_t limit = precision > 0 ? static_cast<std::size_t>(precision) : length;
+    const std::size_t asciiLength = limit < length ? limit : length;
+    if (IsAscii(value, asciiLength)) {
+        StringExtent extent = {asciiLength, asciiLength};
+        return extent;
+    }
+
+    std::size_t index = 0;
+    std::size_t width = 0;
+    while (index < length) {
+        std::uint32_t codePoint;
+        const std::size_t size = DecodeCodePoint(value + index, length - index, codePoint);
+#ifdef FORMAT_ENABLE_DISPLAY_WIDTH
+        const std::size_t columns = GetDisplayWidth(codePoint);
+#else
+        const std::size_t columns = 1;
+#endif  // FORMAT_ENABLE_DISPLAY_WIDTH
+        if (width + columns > limit) {
+            break;
+        }
+        width += columns;
+        index += size;
+    }
+    StringExtent extent = {index, width};
+    return extent;
 }
 
 
 /**
- * Formatting function for the primitive type int, this will be called by the format function and can be called as is
- * to format an integer from a specific format specifier.
- *
- * To the formatter all numbers of the type: int, long, and int64 are treated equally, thus this function converts
- * @p value to an int64 and calls the corresponding FormatType function.
+ * Returns the number of bytes of a null terminated string to format, that is the length of the string or, with a
+ * precision, a length long enough to hold all characters within the precision.  With a precision the string is only
+ * scanned up to this length, so taking a short prefix of a long string does not depend on the length of the whole
+ * string.
  *
- * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
- * https://www.python.org/dev/peps/pep-3101/
+ * @param[in] value  The null terminated string to measure.
+ * @param[in] precision  The maximum number of characters to use, 0 to use the whole string.
  *
- * @param value[in]  The value to format.
- * @param formatSpecifier[in]  The format specifier to use.
- * @param output[out]  A reference to an output stream to write the formatted result to.
+ * @return Returns the number of bytes to pass on to MeasureString.
  */
-void FormatType(int value, const char* formatSpecifier, std::ostream& output)
+std::size_t GetVisibleLength(const char* value, int precision) noexcept
 {
-    FormatType(static_cast<long long>(value), formatSpecifier, output);
+#ifdef FORMAT_ENABLE_DISPLAY_WIDTH
+    // Any number of combining marks may follow the last character within the precision.
+    precision = 0;
+#endif  // FORMAT_ENABLE_DISPLAY_WIDTH
+    // A code point takes up at most four bytes in UTF-8.
+    if (precision <= 0 || static_cast<std::size_t>(precision) > std::numeric_limits<std::size_t>::max() / 4) {
+        return std::strlen(value);
+    }
+    const std::size_t maximumLength = static_cast<std::size_t>(precision) * 4;
+    const void* terminator = std::memchr(value, '\0', maximumLength);
+    return terminator ? static_cast<std::size_t>(static_cast<const char*>(terminator) - value) : maximumLength;
 }
 
 
 /**
- * Formatting function for the primitive type long, this will be called by the format function and can be called as is
- * to format an integer from a specific format specifier.
- *
- * To the formatter all numbers of the type: int, long, and int64 are treated equally, thus the corresponding format
- * functions converts their respective @p value to an int64 and calls this function.
+ * The characters that are escaped by one of the escaping presentation types 'j', 'q' and 'h'.
+ */
+struct EscapedCharacters
+{
+    char characters[5];
+    int count;
+    bool controls;
+};
+
+
+/**
+ * Returns the characters escaped by a presentation type, the control characters below 0x20 are only escaped in JSON.
+ * In CSV the characters are those that require the field to be quoted, only the quote itself is escaped.
  *
- * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
- * https://www.python.org/dev/peps/pep-3101/
+ * @param[in] type  One of the escaping presentation types.
  *
- * @param value[in]  The value to format.
- * @param formatSpecifier[in]  The format specifier to use.
- * @param output[out]  A reference to an output stream to write the formatted result to.
+ * @return Returns the characters to escape.
  */
-void FormatType(long long value, const char* formatSpecifier, std::ostream& output)
+EscapedCharacters GetEscapedCharacters(char type) noexcept
 {
-    int pos = 0;
-    BasicFormatSpecifiers specifiers;
-    InitializeFormatSpecifier(specifiers);
-    ConvertToBasicFormatSpecifiers(formatSpecifier, specifiers, pos);
+    EscapedCharacters json = {{'"', '\\'}, 2, true};
+    EscapedCharacters csv = {{'"', ',', '\r', '\n'}, 4, false};
+    EscapedCharacters html = {{'&', '<', '>', '"', '\''}, 5, false};
+    switch (type) {
+        case FORMAT_JSON_TOGGLE:
+            return json;
 
-    bool useValue = true;
-    std::stringstream buffer;
-    PreprocessStreamForInteger(specifiers, buffer, value, useValue);
-    if (useValue) {
-        buffer << value;
+        case FORMAT_CSV_TOGGLE:
+            return csv;
+
+        default:
+            return html;
     }
-    PostprocessStreamForInteger(buffer.str(), specifiers, output, value);
 }
 
 
 /**
- * Formatting function for the primitive type bool, this will be called by the format function and can be called as
- * is to format a boolean from a specific format specifier.
+ * Finds the first character of a string that has to be escaped.  The string is searched sixteen bytes at a time
+ * using SSE2 when available, so the clean runs between the escaped characters are found without looking at each
+ * byte.
  *
- * To the formatter all numbers of the type: int, long, int64, and bool are treated equally, thus the corresponding
- * format functions converts their respective @p value to an int64 and calls the corresponding FormatType function.
- *
- * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
- * https://www.python.org/dev/peps/pep-3101/
+ * @param[in] value  The string to search.
+ * @param[in] length  The length of @p value.
+ * @param[in] escaped  The characters to find.
  *
- * @param value[in]  The value to format.
- * @param formatSpecifier[in]  The format specifier to use.
- * @param output[out]  A reference to an output stream to write the formatted result to.
+ * @return Returns the index of the first character to escape, or @p length if there is none.
  */
-void FormatType(bool value, const char* formatSpecifier, std::ostream& output)
+std::size_t FindEscapedCharacter(const char* value, std::size_t length, const EscapedCharacters& escaped) noexcept
 {
-    FormatType(static_cast<long long>(value), formatSpecifier, output);
+    std::size_t index = 0;
+#ifdef FORMAT_USE_SSE2
+    const __m128i controlLimit = _mm_set1_epi8(0x1F);
+    for (; index + 16 <= length; index += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(value + index));
+        __m128i matches = escaped.controls ? _mm_cmpeq_epi8(_mm_min_epu8(chunk, controlLimit), chunk)
+                                           : _mm_setzero_si128();
+        for (int character = 0; character < escaped.count; ++character) {
+            matches = _mm_or_si128(matches, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(escaped.characters[character])));
+        }
+        const int mask = _mm_movemask_epi8(matches);
+        if (mask != 0) {
+            int offset = 0;
+            while ((mask & (1 << offset)) == 0) {
+                ++offset;
+            }
+            return index + static_cast<std::size_t>(offset);
+        }
+    }
+#endif  // FORMAT_USE_SSE2
+    for (; index < length; ++index) {
+        const char c = value[index];
+        if (escaped.controls && static_cast<unsigned char>(c) < 0x20) {
+            return index;
+        }
+        for (int character = 0; character < escaped.count; ++character) {
+            if (c == escaped.characters[character]) {
+                return index;
+            }
+        }
+    }
+    return length;
 }
 
 
 /**
- * Formatting function for the primitive type float, this will be called by the format function and can be called as
- * is to format an integer from a specific format specifier.
+ * Writes the escape sequence of a character found by FindEscapedCharacter to a buffer.
  *
- * To the formatter all numbers of the type: float, double and long double are treated equally, thus this function
- * converts @p value to a long double and calls the corresponding FormatType function.
+ * @param[in] type  One of the escaping presentation types.
+ * @param[in] c  The character to escape.
+ * @param[out] sequence  The buffer to write the escape sequence to, it must hold at least 6 characters.
+ *
+ * @return Returns the length of the escape sequence.
+ */
+std::size_t GetEscapeSequence(char type, char c, char* sequence) noexcept
+{
+    const char* replacement;
+    switch (type) {
+        case FORMAT_JSON_TOGGLE:
+            sequence[0] = '\\';
+            switch (c) {
+                case '"': sequence[1] = '"'; return 2;
+                case '\\': sequence[1] = '\\'; return 2;
+                case '\b': sequence[1] = 'b'; return 2;
+                case '\f': sequence[1] = 'f'; return 2;
+                case '\n': sequence[1] = 'n'; return 2;
+                case '\r': sequence[1] = 'r'; return 2;
+                case '\t': sequence[1] = 't'; return 2;
+                default:
+                    std::memcpy(sequence + 1, "u00", 3);
+                    sequence[4] = LOWERCASE_DIGITS[(c >> 4) & 0xF];
+                    sequence[5] = LOWERCASE_DIGITS[c & 0xF];
+                    return 6;
+            }
+
+        case FORMAT_CSV_TOGGLE:
+            sequence[0] = c;
+            if (c != '"') {
+                return 1;
+            }
+            sequence[1] = '"';
+            return 2;
+
+        default: {
+            switch (c) {
+                case '&': replacement = "&amp;"; break;
+                case '<': replacement = "&lt;"; break;
+                case '>': replacement = "&gt;"; break;
+                case '"': replacement = "&quot;"; break;
+                default: replacement = "&#39;"; break;
+            }
+            const std::size_t length = std::strlen(replacement);
+            std::memcpy(sequence, replacement, length);
+            return length;
+        }
+    }
+}
+
+
+/**
+ * Checks whether a presentation type escapes the string, and whether the escaped string is enclosed in quotes.  JSON
+ * strings are always quoted, CSV fields only if they contain a character to escape.
+ */
+bool IsEscapingType(char type) noexcept
+{
+    return type == FORMAT_JSON_TOGGLE || type == FORMAT_CSV_TOGGLE || type == FORMAT_HTML_TOGGLE;
+}
+
+
+/**
+ * Returns the length of a string once escaped by one of the escaping presentation types, including any quotes.
+ *
+ * @param[in] value  The string to escape.
+ * @param[in] length  The length of @p value.
+ * @param[in] type  One of the escaping presentation types.
+ *
+ * @return Returns the number of characters written by WriteEscapedString.
+ */
+std::size_t GetEscapedLength(const char* value, std::size_t length, char type) noexcept
+{
+    const EscapedCharacters escaped = GetEscapedCharacters(type);
+    std::size_t index = FindEscapedCharacter(value, length, escaped);
+    const bool quoted = type == FORMAT_JSON_TOGGLE || (type == FORMAT_CSV_TOGGLE && index < length);
+    std::size_t escapedLength = length + (quoted ? 2 : 0);
+    while (index < length) {
+        char sequence[8];
+        escapedLength += GetEscapeSequence(type, value[index], sequence) - 1;
+        ++index;
+        index += FindEscapedCharacter(value + index, length - index, escaped);
+    }
+    return escapedLength;
+}
+
+
+/**
+ * Adapts a string to the write and put members of an output stream, so the string writers below can append to a
+ * string as well as write to an output stream.
+ */
+struct StringSink
+{
+    explicit StringSink(std::string& text) : text(text) {}
+
+    void write(const char* data, std::streamsize length)
+    {
+        text.append(data, static_cast<std::size_t>(length));
+    }
+
+    void put(char c)
+    {
+        text.push_back(c);
+    }
+
+    std::string& text;
+};
+
+
+/**
+ * Writes a string escaped by one of the escaping presentation types to an output stream, the runs of characters that
+ * need no escaping are written straight from @p value.
+ *
+ * @param[in] value  The string to escape.
+ * @param[in] length  The length of @p value.
+ * @param[in] type  One of the escaping presentation types.
+ * @param[out] output  The output stream or StringSink to write the escaped string to.
+ */
+template <typename Output>
+void WriteEscapedString(const char* value, std::size_t length, char type, Output& output)
+{
+    const EscapedCharacters escaped = GetEscapedCharacters(type);
+    std::size_t index = FindEscapedCharacter(value, length, escaped);
+    const bool quoted = type == FORMAT_JSON_TOGGLE || (type == FORMAT_CSV_TOGGLE && index < length);
+    if (quoted) {
+        output.put('"');
+    }
+
+    std::size_t runStart = 0;
+    while (index < length) {
+        output.write(value + runStart, static_cast<std::streamsize>(index - runStart));
+        char sequence[8];
+        output.write(sequence, static_cast<std::streamsize>(GetEscapeSequence(type, value[index], sequence)));
+        runStart = ++index;
+        index += FindEscapedCharacter(value + index, length - index, escaped);
+    }
+    output.write(value + runStart, static_cast<std::streamsize>(length - runStart));
+
+    if (quoted) {
+        output.put('"');
+    }
+}
+
+
+/**
+ * Writes @p count fill characters to an output stream, in chunks of a small fill buffer.
+ *
+ * @param[in] fill  The fill character to write.
+ * @param[in] count  The number of fill characters to write.
+ * @param[out] output  The output stream or StringSink to write the fill to.
+ */
+template <typename Output>
+void WriteFill(char fill, std::size_t count, Output& output)
+{
+    char buffer[64];
+    std::memset(buffer, fill, sizeof(buffer) < count ? sizeof(buffer) : count);
+    while (count > 0) {
+        const std::size_t chunk = sizeof(buffer) < count ? sizeof(buffer) : count;
+        output.write(buffer, static_cast<std::streamsize>(chunk));
+        count -= chunk;
+    }
+}
+
+
+/**
+ * Writes a string, formatted according to already parsed format specifiers, to an output stream.
+ *
+ * The precision is the maximum number of characters to use from @p value, a precision of 0 uses the whole string.
+ * The string is truncated before it is padded, so the width applies to the visible part.  Both the precision and the
+ * width count UTF-8 encoded characters rather than bytes, see MeasureString.  Only the visible part of @p value and
+ * the padding are written, the string is written straight from @p value without being copied, so the cost depends on
+ * the length of the output rather than on the length of @p value.
+ *
+ * @param[in] value  The string to format.
+ * @param[in] length  The length of @p value.
+ * @param[in] specifiers  The parsed format specifiers to use.
+ * @param[out] output  The output stream or StringSink to write the formatted value to.
+ */
+template <typename Output>
+void WriteString(const char* value, std::size_t length, const BasicFormatSpecifiers& specifiers, Output& output)
+{
+    const StringExtent extent = MeasureString(value, length, specifiers.precision);
+    length = extent.length;
+
+    // The escape sequences and quotes only add ASCII characters, so they add their length to the width.
+    const bool isEscaped = IsEscapingType(specifiers.type);
+    std::size_t width = specifiers.width > 0 ? static_cast<std::size_t>(specifiers.width) : 0;
+    std::size_t contentWidth = extent.width;
+    if (isEscaped && width > contentWidth) {
+        contentWidth += GetEscapedLength(value, length, specifiers.type) - length;
+    }
+    std::size_t padding = width > contentWidth ? width - contentWidth : 0;
+
+    // Strings have no sign or prefix, so the padding of the '=' alignment goes in front like '>', see AppendLayout.
+    std::size_t paddingLeft = 0;
+    switch (specifiers.align ? specifiers.align : FORMAT_ALIGN_LEFT) {
+        case FORMAT_ALIGN_LEFT:
+            break;
+
+        case FORMAT_ALIGN_CENTER:
+            paddingLeft = padding / 2;
+            break;
+
+        default:
+            paddingLeft = padding;
+            break;
+    }
+
+    const char fillCharToUse = specifiers.fill ? specifiers.fill : ' ';
+    if (isEscaped) {
+        WriteFill(fillCharToUse, paddingLeft, output);
+        WriteEscapedString(value, length, specifiers.type, output);
+        WriteFill(fillCharToUse, padding - paddingLeft, output);
+    }
+    else if (padding == 0) {
+        output.write(value, static_cast<std::streamsize>(length));
+    }
+    else if (length + padding <= 256) {
+        // Short padded fields, such as columns, are laid out in a buffer on the stack and written in one operation.
+        char buffer[256];
+        std::memset(buffer, fillCharToUse, length + padding);
+        std::memcpy(buffer + paddingLeft, value, length);
+        output.write(buffer, static_cast<std::streamsize>(length + padding));
+    }
+    else {
+        WriteFill(fillCharToUse, paddingLeft, output);
+        output.write(value, static_cast<std::streamsize>(length));
+        WriteFill(fillCharToUse, padding - paddingLeft, output);
+    }
+}
+
+
+/**
+ * Compile time description of the IEEE-754 binary formats of float and double, used by the floating point engines.
+ *
+ * @c bits_type is the unsigned integer type with the same size as the floating point type, @c mantissa_bits and
+ * @c exponent_bits are the sizes of the stored mantissa and exponent fields, and @c exponent_bias is the bias of the
+ * stored exponent.
+ */
+template <typename F>
+struct FloatTraits;
+
+template <>
+struct FloatTraits<float>
+{
+    typedef std::uint32_t bits_type;
+    static const int mantissa_bits = 23;
+    static const int exponent_bits = 8;
+    static const int exponent_bias = 127;
+};
+
+template <>
+struct FloatTraits<double>
+{
+    typedef std::uint64_t bits_type;
+    static const int mantissa_bits = 52;
+    static const int exponent_bits = 11;
+    static const int exponent_bias = 1023;
+};
+
+
+/**
+ * A float or double split into its IEEE-754 fields, this allows the floating point engines to handle both types
+ * without being templates themselves.
+ */
+struct DecodedFloat
+{
+    std::uint64_t ieeeMantissa;
+    unsigned ieeeExponent;
+    unsigned maxExponent;
+    int mantissaBits;
+    int exponentBias;
+    bool negative;
+
+    /**
+     * Gets the value as an integer mantissa and a binary exponent, the value is @p mantissa * 2^@p exponent.
+     *
+     * @param[out] mantissa  The integer mantissa, including the implicit bit for normal numbers.
+     * @param[out] exponent  The binary exponent.
+     */
+    void GetBinary(std::uint64_t& mantissa, int& exponent) const noexcept
+    {
+        if (ieeeExponent == 0) {
+            mantissa = ieeeMantissa;
+            exponent = 1 - exponentBias - mantissaBits;
+        }
+        else {
+            mantissa = (std::uint64_t(1) << mantissaBits) | ieeeMantissa;
+            exponent = static_cast<int>(ieeeExponent) - exponentBias - mantissaBits;
+        }
+    }
+
+    bool IsNaN() const noexcept
+    {
+        return ieeeExponent == maxExponent && ieeeMantissa != 0;
+    }
+
+    bool IsInfinity() const noexcept
+    {
+        return ieeeExponent == maxExponent && ieeeMantissa == 0;
+    }
+
+    bool IsZero() const noexcept
+    {
+        return ieeeExponent == 0 && ieeeMantissa == 0;
+    }
+};
+
+
+/**
+ * Splits a float or a double into its IEEE-754 fields.
+ *
+ * @param[in] value  The value to decode.
+ *
+ * @return Returns the decoded value.
+ */
+template <typename F>
+DecodedFloat DecodeFloat(F value) noexcept
+{
+    typedef FloatTraits<F> Traits;
+    typename Traits::bits_type bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    DecodedFloat decoded;
+    decoded.ieeeMantissa = bits & ((typename Traits::bits_type(1) << Traits::mantissa_bits) - 1);
+    decoded.ieeeExponent = static_cast<unsigned>(bits >> Traits::mantissa_bits) & ((1u << Traits::exponent_bits) - 1);
+    decoded.maxExponent = (1u << Traits::exponent_bits) - 1;
+    decoded.mantissaBits = Traits::mantissa_bits;
+    decoded.exponentBias = Traits::exponent_bias;
+    decoded.negative = (bits >> (Traits::mantissa_bits + Traits::exponent_bits)) != 0;
+    return decoded;
+}
+
+
+/**
+ * An arbitrary precision unsigned integer, supporting only the few operations needed to calculate exact decimal
+ * expansions of floating point values and the power of five tables.
+ */
+class BigInteger
+{
+public:
+    explicit BigInteger(std::uint64_t value)
+    {
+        while (value != 0) {
+            limbs.push_back(static_cast<std::uint32_t>(value));
+            value >>= 32;
+        }
+    }
+
+    /**
+     * Multiplies the integer by a 32-bit factor.
+     */
+    void Multiply(std::uint32_t factor)
+    {
+        std::uint64_t carry = 0;
+        for (std::size_t i = 0; i < limbs.size(); ++i) {
+            carry += static_cast<std::uint64_t>(limbs[i]) * factor;
+            limbs[i] = static_cast<std::uint32_t>(carry);
+            carry >>= 32;
+        }
+        if (carry != 0) {
+            limbs.push_back(static_cast<std::uint32_t>(carry));
+        }
+    }
+
+    /**
+     * Multiplies the integer by 5^@p exponent.
+     */
+    void MultiplyByPowerOfFive(int exponent)
+    {
+        // 5^13 is the largest power of five that fits in 32 bits.
+        for (; exponent >= 13; exponent -= 13) {
+            Multiply(1220703125u);
+        }
+        std::uint32_t factor = 1;
+        for (; exponent > 0; --exponent) {
+            factor *= 5;
+        }
+        Multiply(factor);
+    }
+
+    /**
+     * Divides the integer by 5^@p exponent, discarding the remainder.
+     *
+     * @return Returns true if the discarded remainder is not zero.
+     */
+    bool DivideByPowerOfFive(int exponent)
+    {
+        bool remainder = false;
+        for (; exponent >= 13; exponent -= 13) {
+            remainder = Divide(1220703125u) != 0 || remainder;
+        }
+        std::uint32_t divisor = 1;
+        for (; exponent > 0; --exponent) {
+            divisor *= 5;
+        }
+        return Divide(divisor) != 0 || remainder;
+    }
+
+    /**
+     * Multiplies the integer by 2^@p bits.
+     */
+    void ShiftLeft(int bits)
+    {
+        if (limbs.empty() || bits <= 0) {
+            return;
+        }
+        const int shift = bits % 32;
+        if (shift != 0) {
+            std::uint32_t carry = 0;
+            for (std::size_t i = 0; i < limbs.size(); ++i) {
+                std::uint32_t limb = limbs[i];
+                limbs[i] = (limb << shift) | carry;
+                carry = limb >> (32 - shift);
+            }
+            if (carry != 0) {
+                limbs.push_back(carry);
+            }
+        }
+        limbs.insert(limbs.begin(), static_cast<std::size_t>(bits / 32), 0u);
+    }
+
+    /**
+     * Divides the integer by 2^@p bits, discarding the remainder.
+     */
+    void ShiftRight(int bits)
+    {
+        const std::size_t words = static_cast<std::size_t>(bits / 32);
+        if (words >= limbs.size()) {
+            limbs.clear();
+            return;
+        }
+        limbs.erase(limbs.begin(), limbs.begin() + static_cast<std::ptrdiff_t>(words));
+        const int shift = bits % 32;
+        if (shift != 0) {
+            for (std::size_t i = 0; i < limbs.size(); ++i) {
+                std::uint32_t next = i + 1 < limbs.size() ? limbs[i + 1] : 0;
+                limbs[i] = (limbs[i] >> shift) | (next << (32 - shift));
+            }
+        }
+        Trim();
+    }
+
+    /**
+     * Checks whether any of the lowest @p bits bits is set, that is whether ShiftRight discards a nonzero remainder.
+     */
+    bool HasLowBits(int bits) const noexcept
+    {
+        const std::size_t words = static_cast<std::size_t>(bits / 32);
+        for (std::size_t i = 0; i < words && i < limbs.size(); ++i) {
+            if (limbs[i] != 0) {
+                return true;
+            }
+        }
+        const int shift = bits % 32;
+        return shift != 0 && words < limbs.size() && (limbs[words] & ((1u << shift) - 1)) != 0;
+    }
+
+    /**
+     * Divides the integer by a 32-bit divisor.
+     *
+     * @return Returns the remainder of the division.
+     */
+    std::uint32_t Divide(std::uint32_t divisor)
+    {
+        std::uint64_t remainder = 0;
+        for (std::size_t i = limbs.size(); i-- > 0;) {
+            remainder = (remainder << 32) | limbs[i];
+            limbs[i] = static_cast<std::uint32_t>(remainder / divisor);
+            remainder %= divisor;
+        }
+        Trim();
+        return static_cast<std::uint32_t>(remainder);
+    }
+
+    /**
+     * Subtracts a smaller or equal integer from this integer.
+     */
+    void Subtract(const BigInteger& other)
+    {
+        std::int64_t borrow = 0;
+        for (std::size_t i = 0; i < limbs.size(); ++i) {
+            std::int64_t difference = static_cast<std::int64_t>(limbs[i]) - borrow
+                                      - (i < other.limbs.size() ? static_cast<std::int64_t>(other.limbs[i]) : 0);
+            borrow = difference < 0 ? 1 : 0;
+            limbs[i] = static_cast<std::uint32_t>(difference + (borrow << 32));
+        }
+        Trim();
+    }
+
+    /**
+     * Compares the integer with another integer.
+     *
+     * @return Returns a negative value, 0, or a positive value if this integer is less than, equal to, or greater than
+     *         @p other.
+     */
+    int Compare(const BigInteger& other) const noexcept
+    {
+        if (limbs.size() != other.limbs.size()) {
+            return limbs.size() < other.limbs.size() ? -1 : 1;
+        }
+        for (std::size_t i = limbs.size(); i-- > 0;) {
+            if (limbs[i] != other.limbs[i]) {
+                return limbs[i] < other.limbs[i] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * Gets the number of significant bits in the integer.
+     */
+    int BitLength() const noexcept
+    {
+        if (limbs.empty()) {
+            return 0;
+        }
+        int bits = static_cast<int>(limbs.size() - 1) * 32;
+        for (std::uint32_t top = limbs.back(); top != 0; top >>= 1) {
+            ++bits;
+        }
+        return bits;
+    }
+
+    /**
+     * Gets the 64-bit word at the given index, counting from the least significant word.
+     */
+    std::uint64_t Word(std::size_t index) const noexcept
+    {
+        std::uint64_t low = 2 * index < limbs.size() ? limbs[2 * index] : 0;
+        std::uint64_t high = 2 * index + 1 < limbs.size() ? limbs[2 * index + 1] : 0;
+        return (high << 32) | low;
+    }
+
+    bool IsZero() const noexcept
+    {
+        return limbs.empty();
+    }
+
+private:
+    void Trim() noexcept
+    {
+        while (!limbs.empty() && limbs.back() == 0) {
+            limbs.pop_back();
+        }
+    }
+
+    /**
+     * The 32-bit limbs of the integer, least significant first, without leading zero limbs.
+     */
+    std::vector<std::uint32_t> limbs;
+};
+
+
+/**
+ * The number of bits in the power of five approximations used by the shortest round trip engine.
+ */
+const int FLOAT_POW5_BITCOUNT = 125;
+
+/**
+ * The number of entries in the tables of powers of five and inverse powers of five, these cover the exponent range of
+ * double, and thus also float.
+ */
+const int FLOAT_POW5_TABLE_SIZE = 326;
+const int FLOAT_POW5_INV_TABLE_SIZE = 342;
+
+
+/**
+ * The tables of powers of five used by the shortest round trip engine, as described in the Ryu paper by Ulf Adams.
+ *
+ * The entries are 125-bit (126-bit for the first inverse) approximations stored as a low and a high 64-bit word.
+ * @c pow5[i] is 5^i truncated to its 125 most significant bits, and @c inversePow5[q] is floor(2^k / 5^q) + 1 where
+ * k is chosen so the result has 125 bits.  Rather than embedding the tables in the source, they are computed exactly
+ * using BigInteger the first time they are needed.
+ */
+struct PowerOfFiveTables
+{
+    std::uint64_t pow5[FLOAT_POW5_TABLE_SIZE][2];
+    std::uint64_t inversePow5[FLOAT_POW5_INV_TABLE_SIZE][2];
+
+    PowerOfFiveTables()
+    {
+        BigInteger power(1);
+        for (int i = 0; i < FLOAT_POW5_INV_TABLE_SIZE; ++i) {
+            const int length = power.BitLength();
+
+            if (i < FLOAT_POW5_TABLE_SIZE) {
+                BigInteger truncated = power;
+                if (length > FLOAT_POW5_BITCOUNT) {
+                    truncated.ShiftRight(length - FLOAT_POW5_BITCOUNT);
+                }
+                else {
+                    truncated.ShiftLeft(FLOAT_POW5_BITCOUNT - length);
+                }
+                pow5[i][0] = truncated.Word(0);
+                pow5[i][1] = truncated.Word(1);
+            }
+
+            // Long division of 2^(length - 1 + FLOAT_POW5_BITCOUNT) by 5^i, one quotient bit at a time, starting from
+            // the remainder 2^(length - 1) which is the first partial dividend not less than half of 5^i.
+            BigInteger remainder(1);
+            remainder.ShiftLeft(length - 1);
+            std::uint64_t quotientLow = 0;
+            std::uint64_t quotientHigh = 0;
+            for (int bit = 0; bit <= FLOAT_POW5_BITCOUNT; ++bit) {
+                if (bit > 0) {
+                    remainder.ShiftLeft(1);
+                    quotientHigh = (quotientHigh << 1) | (quotientLow >> 63);
+                    quotientLow <<= 1;
+                }
+                if (remainder.Compare(power) >= 0) {
+                    remainder.Subtract(power);
+                    quotientLow |= 1;
+                }
+            }
+            inversePow5[i][0] = quotientLow + 1;
+            inversePow5[i][1] = quotientHigh + (inversePow5[i][0] == 0 ? 1 : 0);
+
+            power.MultiplyByPowerOfFive(1);
+        }
+    }
+};
+
+
+/**
+ * Gets the tables of powers of five, computing them on first use.
+ */
+const PowerOfFiveTables& GetPowerOfFiveTables()
+{
+    static const PowerOfFiveTables tables;
+    return tables;
+}
+
+
+/**
+ * Multiplies a 64-bit value by a 128-bit value stored as a low and a high word, and shifts the 192-bit product right
+ * by @p shift bits, which must be at least 64.
+ *
+ * @return Returns the lower 64 bits of the shifted product.
+ */
+inline std::uint64_t MultiplyShift64(std::uint64_t value, const std::uint64_t* multiplier, int shift) noexcept
+{
+#ifdef __SIZEOF_INT128__
+    typedef unsigned __int128 UInt128;
+    const UInt128 low = static_cast<UInt128>(value) * multiplier[0];
+    const UInt128 high = static_cast<UInt128>(value) * multiplier[1];
+    return static_cast<std::uint64_t>(((low >> 64) + high) >> (shift - 64));
+#else
+    // Portable 64 x 64 -> 128 bit multiplication using 32-bit halves.
+    struct Product
+    {
+        static void Multiply(std::uint64_t a, std::uint64_t b, std::uint64_t& productLow, std::uint64_t& productHigh)
+        {
+            const std::uint64_t aLow = a & 0xffffffffu;
+            const std::uint64_t aHigh = a >> 32;
+            const std::uint64_t bLow = b & 0xffffffffu;
+            const std::uint64_t bHigh = b >> 32;
+            const std::uint64_t lowLow = aLow * bLow;
+            const std::uint64_t lowHigh = aLow * bHigh;
+            const std::uint64_t highLow = aHigh * bLow;
+            const std::uint64_t highHigh = aHigh * bHigh;
+            const std::uint64_t middle = (lowLow >> 32) + (lowHigh & 0xffffffffu) + (highLow & 0xffffffffu);
+            productLow = (middle << 32) | (lowLow & 0xffffffffu);
+            productHigh = highHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+        }
+    };
+    std::uint64_t lowLow, lowHigh, highLow, highHigh;
+    Product::Multiply(value, multiplier[0], lowLow, lowHigh);
+    Product::Multiply(value, multiplier[1], highLow, highHigh);
+    const std::uint64_t sumLow = lowHigh + highLow;
+    const std::uint64_t sumHigh = highHigh + (sumLow < lowHigh ? 1 : 0);
+    const int bits = shift - 64;
+    return bits == 0 ? sumLow : (sumLow >> bits) | (sumHigh << (64 - bits));
+#endif  // __SIZEOF_INT128__
+}
+
+
+/**
+ * Gets the number of bits in 5^@p e, for @p e larger than 0, and 1 for @p e equal to 0.
+ */
+inline int Pow5Bits(int e) noexcept
+{
+    return static_cast<int>((static_cast<std::uint32_t>(e) * 1217359u) >> 19) + 1;
+}
+
+
+/**
+ * Gets floor(log10(2^@p e)), for @p e between 0 and 1650.
+ */
+inline int Log10Pow2(int e) noexcept
+{
+    return static_cast<int>((static_cast<std::uint32_t>(e) * 78913u) >> 18);
+}
+
+
+/**
+ * Gets floor(log10(5^@p e)), for @p e between 0 and 2620.
+ */
+inline int Log10Pow5(int e) noexcept
+{
+    return static_cast<int>((static_cast<std::uint32_t>(e) * 732923u) >> 20);
+}
+
+
+/**
+ * Checks whether @p value is divisible by 5^@p p.
+ */
+inline bool IsMultipleOfPowerOf5(std::uint64_t value, int p) noexcept
+{
+    int count = 0;
+    while (value != 0 && value % 5 == 0 && count < p) {
+        value /= 5;
+        ++count;
+    }
+    return count >= p;
+}
+
+
+/**
+ * Checks whether @p value is divisible by 2^@p p.
+ */
+inline bool IsMultipleOfPowerOf2(std::uint64_t value, int p) noexcept
+{
+    return (value & ((std::uint64_t(1) << p) - 1)) == 0;
+}
+
+
+/**
+ * The shortest decimal representation of a floating point value, the value is @c digits * 10^@c exponent.
+ */
+struct ShortestDecimal
+{
+    std::uint64_t digits;
+    int exponent;
+};
+
+
+/**
+ * Calculates the shortest decimal representation that reads back as the same value, this is the Ryu algorithm by Ulf
+ * Adams ("Ryu: fast float-to-string conversion", PLDI 2018).
+ *
+ * Among the representations with the fewest digits the one closest to the exact value is chosen, rounding ties to
+ * even, which is the same representation Python's repr uses.  The algorithm works for both float and double, since
+ * the float format is a subset of the double format.
+ *
+ * @param[in] value  The value to convert, this must be finite and not zero, the sign is ignored.
+ *
+ * @return Returns the shortest decimal representation.
+ */
+ShortestDecimal GetShortestDecimal(const DecodedFloat& value) noexcept
+{
+    const PowerOfFiveTables& tables = GetPowerOfFiveTables();
+
+    // Step 1 and 2: decode the value, and determine the interval of values rounding to it, the interval is
+    // [mm, mp] = [mv - 1 - mmShift, mv + 2] * 2^e2, scaled by 4 to keep them integer.
+    std::uint64_t m2;
+    int e2;
+    value.GetBinary(m2, e2);
+    e2 -= 2;
+    const bool acceptBounds = (m2 & 1) == 0;
+    const std::uint64_t mv = 4 * m2;
+    const std::uint32_t mmShift = (value.ieeeMantissa != 0 || value.ieeeExponent <= 1) ? 1 : 0;
+
+    // Step 3: convert the interval to a decimal power base.
+    std::uint64_t vr, vp, vm;
+    int e10;
+    bool vmIsTrailingZeros = false;
+    bool vrIsTrailingZeros = false;
+    if (e2 >= 0) {
+        const int q = Log10Pow2(e2) - (e2 > 3 ? 1 : 0);
+        e10 = q;
+        const int k = FLOAT_POW5_BITCOUNT + Pow5Bits(q) - 1;
+        const int i = -e2 + q + k;
+        vr = MultiplyShift64(4 * m2, tables.inversePow5[q], i);
+        vp = MultiplyShift64(4 * m2 + 2, tables.inversePow5[q], i);
+        vm = MultiplyShift64(4 * m2 - 1 - mmShift, tables.inversePow5[q], i);
+        if (q <= 21) {
+            // Only one of mp, mv, and mm can be a multiple of 5, if any.
+            if (mv % 5 == 0) {
+                vrIsTrailingZeros = IsMultipleOfPowerOf5(mv, q);
+            }
+            else if (acceptBounds) {
+                vmIsTrailingZeros = IsMultipleOfPowerOf5(mv - 1 - mmShift, q);
+            }
+            else {
+                vp -= IsMultipleOfPowerOf5(mv + 2, q) ? 1 : 0;
+            }
+        }
+    }
+    else {
+        const int q = Log10Pow5(-e2) - (-e2 > 1 ? 1 : 0);
+        e10 = q + e2;
+        const int i = -e2 - q;
+        const int k = Pow5Bits(i) - FLOAT_POW5_BITCOUNT;
+        const int j = q - k;
+        vr = MultiplyShift64(4 * m2, tables.pow5[i], j);
+        vp = MultiplyShift64(4 * m2 + 2, tables.pow5[i], j);
+        vm = MultiplyShift64(4 * m2 - 1 - mmShift, tables.pow5[i], j);
+        if (q <= 1) {
+            // mv has at least q trailing zero bits, and thus vr has at least q trailing zero digits.
+            vrIsTrailingZeros = true;
+            if (acceptBounds) {
+                vmIsTrailingZeros = mmShift == 1;
+            }
+            else {
+                --vp;
+            }
+        }
+        else if (q < 63) {
+            vrIsTrailingZeros = IsMultipleOfPowerOf2(mv, q);
+        }
+    }
+
+    // Step 4: find the shortest decimal representation in the interval.
+    int removed = 0;
+    std::uint64_t output;
+    if (vmIsTrailingZeros || vrIsTrailingZeros) {
+        // The general case, which happens rarely.
+        int lastRemovedDigit = 0;
+        while (vp / 10 > vm / 10) {
+            vmIsTrailingZeros &= vm % 10 == 0;
+            vrIsTrailingZeros &= lastRemovedDigit == 0;
+            lastRemovedDigit = static_cast<int>(vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            ++removed;
+        }
+        if (vmIsTrailingZeros) {
+            while (vm % 10 == 0) {
+                vrIsTrailingZeros &= lastRemovedDigit == 0;
+                lastRemovedDigit = static_cast<int>(vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                ++removed;
+            }
+        }
+        if (vrIsTrailingZeros && lastRemovedDigit == 5 && vr % 2 == 0) {
+            // Round even if the exact value is .....50..0.
+            lastRemovedDigit = 4;
+        }
+        output = vr + (((vr == vm && (!acceptBounds || !vmIsTrailingZeros)) || lastRemovedDigit >= 5) ? 1 : 0);
+    }
+    else {
+        // The common case.
+        bool roundUp = false;
+        while (vp / 10 > vm / 10) {
+            roundUp = vr % 10 >= 5;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            ++removed;
+        }
+        output = vr + ((vr == vm || roundUp) ? 1 : 0);
+    }
+
+    ShortestDecimal result;
+    result.digits = output;
+    result.exponent = e10 + removed;
+    return result;
+}
+
+
+/**
+ * Calculates the exact decimal expansion of a floating point value, every binary floating point value has a finite
+ * decimal expansion, of at most 767 significant digits for a double.
+ *
+ * This is the exact (and slow) general engine, used whenever a value must be rounded to a number of digits that the
+ * faster engines cannot handle.
+ *
+ * @param[in] value  The value to expand, this must be finite, the sign is ignored.
+ * @param[out] digits  The significant digits of the value, without leading zeroes, "0" if the value is zero.
+ *
+ * @return Returns the decimal exponent of the first digit, that is the value is d.ddd * 10^exponent.
+ */
+int GetExactDecimal(const DecodedFloat& value, std::string& digits)
+{
+    std::uint64_t m2;
+    int e2;
+    value.GetBinary(m2, e2);
+
+    // The value is m2 * 2^e2, for negative exponents this is (m2 * 5^-e2) * 10^e2.
+    BigInteger integer(m2);
+    int exponent = 0;
+    if (e2 >= 0) {
+        integer.ShiftLeft(e2);
+    }
+    else {
+        integer.MultiplyByPowerOfFive(-e2);
+        exponent = e2;
+    }
+
+    // Convert to decimal nine digits at a time, least significant first.
+    digits.clear();
+    while (!integer.IsZero()) {
+        std::uint32_t chunk = integer.Divide(1000000000u);
+        for (int i = 0; i < 9; ++i) {
+            digits += static_cast<char>('0' + chunk % 10);
+            chunk /= 10;
+        }
+    }
+    while (digits.size() > 1 && digits[digits.size() - 1] == '0') {
+        digits.erase(digits.size() - 1);
+    }
+    if (digits.empty()) {
+        digits = "0";
+    }
+    std::reverse(digits.begin(), digits.end());
+    return exponent + static_cast<int>(digits.size()) - 1;
+}
+
+
+/**
+ * Multiplies a floating point value by a power of ten and truncates the product to an integer, using arbitrary
+ * precision arithmetic.
+ *
+ * This is the exact engine used to round a value to a few digits, rather than expanding every digit of the value by
+ * GetExactDecimal, the value is scaled so that its integer part holds the digits to keep and a single guard digit,
+ * which RoundGuardDigit then uses together with @p inexact to round the value.
+ *
+ * @param[in] value  The value to scale, this must be finite, the sign is ignored.
+ * @param[in] decimalScale  The power of ten to multiply the value by.
+ * @param[out] truncated  The integer part of the scaled value.
+ * @param[out] inexact  Whether the discarded fraction of the scaled value is not zero.
+ *
+ * @return Returns true if the integer part fits in 64 bits, otherwise @p truncated and @p inexact are not set.
+ */
+bool ScaleByPowerOfTen(const DecodedFloat& value, int decimalScale, std::uint64_t& truncated, bool& inexact)
+{
+    std::uint64_t m2;
+    int e2;
+    value.GetBinary(m2, e2);
+
+    // The scaled value is m2 * 5^decimalScale * 2^(e2 + decimalScale), multiply first so only the last steps truncate.
+    const int binaryScale = e2 + decimalScale;
+    BigInteger scaled(m2);
+    if (decimalScale > 0) {
+        scaled.MultiplyByPowerOfFive(decimalScale);
+    }
+    if (binaryScale > 0) {
+        scaled.ShiftLeft(binaryScale);
+    }
+    bool remainder = false;
+    if (decimalScale < 0) {
+        remainder = scaled.DivideByPowerOfFive(-decimalScale);
+    }
+    if (binaryScale < 0) {
+        remainder = scaled.HasLowBits(-binaryScale) || remainder;
+        scaled.ShiftRight(-binaryScale);
+    }
+    if (scaled.BitLength() > 64) {
+        return false;
+    }
+
+    truncated = scaled.Word(0);
+    inexact = remainder;
+    return true;
+}
+
+
+/**
+ * Rounds a value scaled by ScaleByPowerOfTen, half to even, removing its last digit, the guard digit.
+ *
+ * @param[in] truncated  The integer part of the scaled value.
+ * @param[in] inexact  Whether the fraction of the scaled value is not zero.
+ *
+ * @return Returns the rounded value, that is @p truncated divided by 10, rounded.
+ */
+inline std::uint64_t RoundGuardDigit(std::uint64_t truncated, bool inexact) noexcept
+{
+    const unsigned guard = static_cast<unsigned>(truncated % 10);
+    std::uint64_t rounded = truncated / 10;
+    if (guard > 5 || (guard == 5 && (inexact || (rounded & 1) != 0))) {
+        ++rounded;
+    }
+    return rounded;
+}
+
+
+/**
+ * Rounds a string of significant digits to a number of digits, rounding half to even.
+ *
+ * The digits are exact, so a tie is only a tie if all the digits following the rounding position are zero.
+ *
+ * @param[in,out] digits  The digits to round, when done it holds at most @p count digits.
+ * @param[in,out] exponent  The decimal exponent of the first digit, increased by one if the rounding carries into a
+ *                new digit.
+ * @param[in] count  The number of significant digits to keep, if this is 0 the value is rounded to either 0 or a
+ *            single digit 1 with an increased exponent.
+ */
+void RoundDecimalDigits(std::string& digits, int& exponent, std::size_t count)
+{
+    if (digits.size() <= count) {
+        return;
+    }
+
+    bool roundUp = false;
+    const char next = digits[count];
+    if (next > '5') {
+        roundUp = true;
+    }
+    else if (next == '5') {
+        roundUp = digits.find_first_not_of('0', count + 1) != std::string::npos
+                  || (count > 0 && (digits[count - 1] - '0') % 2 == 1);
+    }
+    digits.resize(count);
+
+    if (roundUp) {
+        std::size_t index = count;
+        while (index > 0 && digits[index - 1] == '9') {
+            digits[--index] = '0';
+        }
+        if (index > 0) {
+            ++digits[index - 1];
+        }
+        else {
+            // All digits were nines (or there were none), the value carries into a new leading digit.
+            digits.insert(digits.begin(), '1');
+            digits.resize(count > 0 ? count : 1);
+            ++exponent;
+        }
+    }
+    else if (count == 0) {
+        digits = "0";
+    }
+}
+
+
+/**
+ * The punctuation used when writing the integer part of a number, either none, the ',' thousands separator of
+ * PEP-3101, or the punctuation of the current locale for the 'n' presentation type.
+ */
+struct NumberPunctuation
+{
+    char decimalPoint;
+    char thousandsSeparator;
+    std::string grouping;
+
+    explicit NumberPunctuation(const BasicFormatSpecifiers& specifiers)
+        : decimalPoint('.'), thousandsSeparator('\0')
+    {
+        if (specifiers.type == FORMAT_LOCALIZED_NUMBER_TOGGLE) {
+            std::locale locale("");
+            const std::numpunct<char>& punct = std::use_facet<std::numpunct<char> >(locale);
+            decimalPoint = punct.decimal_point();
+            thousandsSeparator = punct.thousands_sep();
+            grouping = punct.grouping();
+        }
+        else if (specifiers.thousandSeparator) {
+            thousandsSeparator = ',';
+            grouping = "\3";
+        }
+    }
+};
+
+
+/**
+ * Appends digits in fixed point notation to a string.
+ *
+ * @param[in] digits  The significant digits of the value, digits beyond these are zeroes.
+ * @param[in] count  The number of significant digits.
+ * @param[in] exponent  The decimal exponent of the first digit.
+ * @param[in] fractionDigits  The number of digits to write after the decimal point.
+ * @param[in] forcePoint  Whether to write the decimal point even if no digits follow it.
+ * @param[in] punctuation  The decimal point and thousands separator to use.
+ * @param[out] body  The string to append the number to.
+ */
+void AppendFixedNotation(const char* digits, int count, int exponent, int fractionDigits, bool forcePoint,
+        const NumberPunctuation& punctuation, std::string& body)
+{
+    // The integer part, this is at least a single 0.
+    std::string integerPart;
+    if (exponent < 0) {
+        integerPart = "0";
+    }
+    else {
+        const int available = std::min(count, exponent + 1);
+        integerPart.assign(digits, static_cast<std::size_t>(available));
+        integerPart.append(static_cast<std::size_t>(exponent + 1 - available), '0');
+    }
+    if (punctuation.thousandsSeparator && !punctuation.grouping.empty()) {
+        std::vector<char> grouped(2 * integerPart.size());
+        int length = GroupDigits(integerPart.data(), static_cast<int>(integerPart.size()), punctuation.grouping,
+                                 punctuation.thousandsSeparator, grouped.data());
+        body.append(grouped.data(), static_cast<std::size_t>(length));
+    }
+    else {
+        body += integerPart;
+    }
+
+    if (fractionDigits > 0 || forcePoint) {
+        body += punctuation.decimalPoint;
+    }
+    // The fraction part, leading zeroes of small numbers, then the remaining significant digits, then zeroes.
+    for (int position = -1; position >= -fractionDigits; --position) {
+        const int index = exponent - position;
+        body += (index >= 0 && index < count) ? digits[index] : '0';
+    }
+}
+
+
+/**
+ * Appends digits in scientific notation to a string, the exponent has at least two digits, as in Python.
+ *
+ * @param[in] digits  The significant digits of the value, digits beyond these are zeroes.
+ * @param[in] count  The number of significant digits.
+ * @param[in] exponent  The decimal exponent of the first digit.
+ * @param[in] fractionDigits  The number of digits to write after the decimal point.
+ * @param[in] forcePoint  Whether to write the decimal point even if no digits follow it.
+ * @param[in] upperCase  Whether to use 'E' rather than 'e'.
+ * @param[in] decimalPoint  The decimal point character to use.
+ * @param[out] body  The string to append the number to.
+ */
+void AppendScientificNotation(const char* digits, int count, int exponent, int fractionDigits, bool forcePoint,
+        bool upperCase, char decimalPoint, std::string& body)
+{
+    body += count > 0 ? digits[0] : '0';
+    if (fractionDigits > 0 || forcePoint) {
+        body += decimalPoint;
+    }
+    for (int index = 1; index <= fractionDigits; ++index) {
+        body += index < count ? digits[index] : '0';
+    }
+
+    body += upperCase ? 'E' : 'e';
+    body += exponent < 0 ? '-' : '+';
+    char buffer[INTEGER_BUFFER_SIZE];
+    char* end = buffer + INTEGER_BUFFER_SIZE;
+    char* start = WriteDecimalDigits(static_cast<unsigned>(exponent < 0 ? -exponent : exponent), end);
+    if (end - start < 2) {
+        body += '0';
+    }
+    body.append(start, end);
+}
+
+
+/**
+ * Appends the general format of a number, either fixed point or scientific notation, depending on the exponent.
+ *
+ * This implements both the general presentation types 'g', 'G' and 'n', and the shortest representation written
+ * when no presentation type is given.  Scientific notation is used when the exponent is less than -4 or not less
+ * than @p scientificCeil.
+ *
+ * @param[in] digits  The significant digits of the value, already rounded.
+ * @param[in] count  The number of significant digits.
+ * @param[in] exponent  The decimal exponent of the first digit.
+ * @param[in] precision  The number of significant digits to write, trailing zeroes are removed unless
+ *            @p keepTrailingZeroes is set.
+ * @param[in] scientificCeil  The exponent from which scientific notation is used.
+ * @param[in] keepTrailingZeroes  Whether to keep trailing zeroes and the decimal point (the alternate form).
+ * @param[in] minimumFraction  The minimum number of fraction digits written in fixed point notation, this is 1 for
+ *            the shortest representation, which always writes at least "x.0".
+ * @param[in] upperCase  Whether to use 'E' rather than 'e'.
+ * @param[in] punctuation  The decimal point and thousands separator to use.
+ * @param[out] body  The string to append the number to.
+ */
+void AppendGeneralNotation(const char* digits, int count, int exponent, int precision, int scientificCeil,
+        bool keepTrailingZeroes, int minimumFraction, bool upperCase, const NumberPunctuation& punctuation,
+        std::string& body)
+{
+    int significant = keepTrailingZeroes ? precision : std::max(count, 1);
+    // Zero is written with a single significant digit, and without trailing zeroes.
+    while (!keepTrailingZeroes && significant > 1 && digits[significant - 1] == '0') {
+        --significant;
+    }
+
+    if (exponent < -4 || exponent >= scientificCeil) {
+        AppendScientificNotation(digits, count, exponent, significant - 1, keepTrailingZeroes, upperCase,
+                                 punctuation.decimalPoint, body);
+    }
+    else {
+        const int fractionDigits = std::max(significant - 1 - exponent, minimumFraction);
+        AppendFixedNotation(digits, count, exponent, fractionDigits, keepTrailingZeroes, punctuation, body);
+    }
+}
+
+
+/**
+ * Checks whether the shortest representation of a value, padded with zeroes, is the value correctly rounded to
+ * @p precision significant digits, given that the shortest representation has no more than @p precision digits.
+ *
+ * This holds when the decimal digits are spaced further apart than the binary values, that is for normal values when
+ * @p precision is at most floor(mantissa bits * log10(2)), which is 15 digits for double and 6 digits for float.
+ *
+ * @param[in] value  The value to check.
+ * @param[in] precision  The number of significant digits the value is rounded to.
+ *
+ * @return Returns true if the shortest representation can be used.
+ */
+bool IsShortestDecimalExact(const DecodedFloat& value, int precision) noexcept
+{
+    return value.ieeeExponent != 0 && precision <= value.mantissaBits * 30103 / 100000;
+}
+
+
+/**
+ * Gets the digits of the shortest representation of a value, see GetShortestDecimal.
+ *
+ * @param[in] value  The value to convert, this must be finite, the sign is ignored.
+ * @param[out] digits  The significant digits, "0" if the value is zero.
+ *
+ * @return Returns the decimal exponent of the first digit, that is the value is d.ddd * 10^exponent.
+ */
+int GetShortestDigits(const DecodedFloat& value, std::string& digits)
+{
+    if (value.IsZero()) {
+        digits = "0";
+        return 0;
+    }
+
+    ShortestDecimal shortest = GetShortestDecimal(value);
+    char buffer[INTEGER_BUFFER_SIZE];
+    char* end = buffer + INTEGER_BUFFER_SIZE;
+    char* start = WriteDecimalDigits(shortest.digits, end);
+    digits.assign(start, end);
+    return shortest.exponent + static_cast<int>(end - start) - 1;
+}
+
+
+/**
+ * Gets the digits of a value correctly rounded to a number of significant digits, rounding half to even, using the
+ * exact engine.
+ *
+ * The value is scaled by ScaleByPowerOfTen to hold @p precision digits and a guard digit, the decimal exponent of the
+ * value this requires is taken from the shortest representation, which is either exact, or one too large when the
+ * shortest representation rounds up to a power of ten.  If the scaled digits do not fit in 64 bits the value is
+ * expanded completely by GetExactDecimal.
+ *
+ * @param[in] value  The value to convert, this must be finite and not zero, the sign is ignored.
+ * @param[in] precision  The number of significant digits to round to, this must be at least 1.
+ * @param[in] exponentEstimate  The decimal exponent of the first digit of the shortest representation of the value.
+ * @param[out] digits  The significant digits, at most @p precision of them.
+ *
+ * @return Returns the decimal exponent of the first digit, that is the value is d.ddd * 10^exponent.
+ */
+int GetExactSignificantDigits(const DecodedFloat& value, int precision, int exponentEstimate, std::string& digits)
+{
+    char buffer[INTEGER_BUFFER_SIZE];
+    char* end = buffer + INTEGER_BUFFER_SIZE;
+    for (int exponent = exponentEstimate; exponent >= exponentEstimate - 1; --exponent) {
+        std::uint64_t truncated;
+        bool inexact;
+        if (!ScaleByPowerOfTen(value, precision - exponent, truncated, inexact)) {
+            break;
+        }
+        // Without the guard digit there are fewer than precision digits if the value is below 10^exponent.
+        char* start = WriteDecimalDigits(truncated, end);
+        if (end - start <= precision && exponent == exponentEstimate) {
+            continue;
+        }
+
+        // A carry into a new digit leaves a trailing zero, which is dropped.
+        start = WriteDecimalDigits(RoundGuardDigit(truncated, inexact), end);
+        const int count = static_cast<int>(end - start);
+        digits.assign(start, static_cast<std::size_t>(std::min(count, precision)));
+        return exponent + count - precision;
+    }
+
+    int exponent = GetExactDecimal(value, digits);
+    RoundDecimalDigits(digits, exponent, static_cast<std::size_t>(precision));
+    return exponent;
+}
+
+
+/**
+ * Gets the digits of a value correctly rounded to a number of significant digits, rounding half to even.
+ *
+ * Whenever possible the shortest representation is rounded, since this is much faster than the exact engine.  If
+ * the shortest representation has no more digits than requested this requires IsShortestDecimalExact, if it has more
+ * digits the rounding is always correct, except for the case where the digit following the rounding position is the
+ * last digit and a 5.  In that case the exact value may be just below, exactly at, or just above the tie, and the
+ * exact engine is used, the same goes for the digits of the shortest representation being too few to be exact.
+ *
+ * @param[in] value  The value to convert, this must be finite, the sign is ignored.
+ * @param[in] precision  The number of significant digits to round to, this must be at least 1.
+ * @param[out] digits  The significant digits, at most @p precision of them, "0" if the value is zero.
+ *
+ * @return Returns the decimal exponent of the first digit, that is the value is d.ddd * 10^exponent.
+ */
+int GetSignificantDigits(const DecodedFloat& value, int precision, std::string& digits)
+{
+    int exponent = GetShortestDigits(value, digits);
+    const int count = static_cast<int>(digits.size());
+    const bool useShortest = count <= precision ? (value.IsZero() || IsShortestDecimalExact(value, precision))
+                                                : (count > precision + 1 || digits[precision] != '5');
+    if (!useShortest) {
+        return GetExactSignificantDigits(value, precision, exponent, digits);
+    }
+    RoundDecimalDigits(digits, exponent, static_cast<std::size_t>(precision));
+    return exponent;
+}
+
+
+/**
+ * Gets the digits of a value correctly rounded to a number of digits after the decimal point, rounding half to even.
+ *
+ * The value is scaled by ScaleByPowerOfTen to hold the digits up to the last fraction digit and a guard digit, only if
+ * these do not fit in 64 bits the value is expanded completely by GetExactDecimal.
+ *
+ * @param[in] value  The value to convert, this must be finite, the sign is ignored.
+ * @param[in] fractionDigits  The number of digits after the decimal point to round to.
+ * @param[in] decimalShift  The power of ten the value is multiplied by before rounding, 2 for percentages.
+ * @param[out] digits  The significant digits, "0" if the rounded value is zero.
+ *
+ * @return Returns the decimal exponent of the first digit, that is the value is d.ddd * 10^exponent.
+ */
+int GetFixedDigits(const DecodedFloat& value, int fractionDigits, int decimalShift, std::string& digits)
+{
+    if (value.IsZero()) {
+        digits = "0";
+        return 0;
+    }
+
+    std::uint64_t truncated;
+    bool inexact;
+    if (ScaleByPowerOfTen(value, fractionDigits + decimalShift + 1, truncated, inexact)) {
+        const std::uint64_t rounded = RoundGuardDigit(truncated, inexact);
+        if (rounded == 0) {
+            digits = "0";
+            return 0;
+        }
+        char buffer[INTEGER_BUFFER_SIZE];
+        char* end = buffer + INTEGER_BUFFER_SIZE;
+        char* start = WriteDecimalDigits(rounded, end);
+        digits.assign(start, end);
+        return static_cast<int>(end - start) - 1 - fractionDigits;
+    }
+
+    // The digits do not fit in 64 bits, expand the value completely.
+    int exponent = GetExactDecimal(value, digits) + decimalShift;
+    const int count = exponent + 1 + fractionDigits;
+    if (count < 0) {
+        // The value is below half of the last fraction digit.
+        digits = "0";
+        return 0;
+    }
+    RoundDecimalDigits(digits, exponent, static_cast<std::size_t>(count));
+    return exponent;
+}
+
+
+/**
+ * The largest precision written by AppendFixedNotationFast, percentages scale the value by at most 10^11 this way, so
+ * the scaled mantissa of a double always fits in 128 bits.
+ */
+const int FIXED_FAST_PATH_MAX_PRECISION = 9;
+
+
+/**
+ * The powers of ten up to 10^(FIXED_FAST_PATH_MAX_PRECISION + 2).
+ */
+const std::uint64_t FIXED_FAST_PATH_POWERS_OF_TEN[FIXED_FAST_PATH_MAX_PRECISION + 3] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull,
+    10000000000ull, 100000000000ull
+};
+
+
+/**
+ * Appends a value in fixed point notation to a string using integer arithmetic only, for the common case of a small
+ * precision and a value of moderate magnitude, like prices, latencies and percentages.
+ *
+ * The value mantissa * 2^exponent is scaled by 10^(@p fractionDigits + @p decimalShift) and rounded half to even to
+ * an integer, which is then split into the integer and the fraction part by a single division.  Since the scaling is
+ * exact, this writes the same digits as GetFixedDigits does, just without the arbitrary precision arithmetic.
+ *
+ * The fast path requires 128-bit integers, without them the function always returns false.
+ *
+ * @param[in] value  The value to write, this must be finite, the sign is ignored.
+ * @param[in] fractionDigits  The number of digits after the decimal point.
+ * @param[in] decimalShift  The power of ten the value is multiplied by before rounding, 2 for percentages.
+ * @param[in] forcePoint  Whether to write the decimal point even if no digits follow it.
+ * @param[in] punctuation  The decimal point and thousands separator to use.
+ * @param[out] body  The string to append the number to.
+ *
+ * @return Returns true if the value was written, false if the precision is larger than
+ *         FIXED_FAST_PATH_MAX_PRECISION or the scaled value does not fit in 64 bits, then nothing is written.
+ */
+bool AppendFixedNotationFast(const DecodedFloat& value, int fractionDigits, int decimalShift, bool forcePoint,
+        const NumberPunctuation& punctuation, std::string& body)
+{
+#ifdef __SIZEOF_INT128__
+    typedef unsigned __int128 UInt128;
+    if (fractionDigits > FIXED_FAST_PATH_MAX_PRECISION) {
+        return false;
+    }
+
+    std::uint64_t mantissa;
+    int exponent;
+    value.GetBinary(mantissa, exponent);
+    const UInt128 scale = FIXED_FAST_PATH_POWERS_OF_TEN[fractionDigits + decimalShift];
+    const UInt128 scaled = static_cast<UInt128>(mantissa) * scale;
+
+    UInt128 rounded;
+    if (exponent >= 0) {
+        if (exponent >= 64 || (scaled >> (64 - exponent)) != 0) {
+            return false;
+        }
+        rounded = scaled << exponent;
+    }
+    else if (exponent > -128) {
+        const int shift = -exponent;
+        rounded = scaled >> shift;
+        const UInt128 remainder = scaled - (rounded << shift);
+        const UInt128 half = UInt128(1) << (shift - 1);
+        if (remainder > half || (remainder == half && (rounded & 1) != 0)) {
+            ++rounded;
+        }
+    }
+    else {
+        // The scaled mantissa is below 2^90, so the value is far below half of the last fraction digit.
+        rounded = 0;
+    }
+    if ((rounded >> 64) != 0) {
+        return false;
+    }
+
+    const std::uint64_t divisor = FIXED_FAST_PATH_POWERS_OF_TEN[fractionDigits];
+    const std::uint64_t integerPart = static_cast<std::uint64_t>(rounded) / divisor;
+    const std::uint64_t fractionPart = static_cast<std::uint64_t>(rounded) % divisor;
+
+    char buffer[INTEGER_BUFFER_SIZE];
+    char* end = buffer + INTEGER_BUFFER_SIZE;
+    char* start = WriteDecimalDigits(integerPart, end);
+    if (punctuation.thousandsSeparator && !punctuation.grouping.empty()) {
+        char grouped[2 * INTEGER_BUFFER_SIZE];
+        int length = GroupDigits(start, static_cast<int>(end - start), punctuation.grouping,
+                                 punctuation.thousandsSeparator, grouped);
+        body.append(grouped, static_cast<std::size_t>(length));
+    }
+    else {
+        body.append(start, end);
+    }
+
+    if (fractionDigits > 0 || forcePoint) {
+        body += punctuation.decimalPoint;
+    }
+    if (fractionDigits > 0) {
+        start = WriteDecimalDigits(fractionPart, end);
+        body.append(static_cast<std::size_t>(fractionDigits - (end - start)), '0');
+        body.append(start, end);
+    }
+    return true;
+#else
+    (void)value;
+    (void)fractionDigits;
+    (void)decimalShift;
+    (void)forcePoint;
+    (void)punctuation;
+    (void)body;
+    return false;
+#endif  // __SIZEOF_INT128__
+}
+
+
+/**
+ * Appends a binary floating point value in hexadecimal notation to a string, that is h.hhhp+d without the 0x prefix,
+ * as written by C's %a.
+ *
+ * The value is (@p leading + @p fraction / 2^64) * 2^@p exponent.  Without a precision all digits of the fraction
+ * are written, without trailing zeroes, so the value is exact.  With a precision the fraction is rounded half to even
+ * to that many hexadecimal digits, a carry may make the leading digit a 2, like it does with printf.
+ *
+ * @param[in] leading  The integer part of the mantissa, 1 for normal numbers and 0 for subnormal numbers and zero.
+ * @param[in] fraction  The fraction of the mantissa, left aligned.
+ * @param[in] exponent  The binary exponent.
+ * @param[in] precision  The number of hexadecimal digits after the point, or PRECISION_NOT_SET.
+ * @param[in] forcePoint  Whether to write the point even if no digits follow it.
+ * @param[in] upperCase  Whether to use upper case digits and 'P' rather than 'p'.
+ * @param[out] body  The string to append the number to.
+ */
+void AppendHexadecimalNotation(unsigned leading, std::uint64_t fraction, int exponent, int precision, bool forcePoint,
+        bool upperCase, std::string& body)
+{
+    const int maxDigits = 16;
+    int digitCount = 0;
+    if (precision == PRECISION_NOT_SET) {
+        for (std::uint64_t rest = fraction; rest != 0; rest <<= 4) {
+            ++digitCount;
+        }
+    }
+    else {
+        digitCount = precision;
+        if (precision < maxDigits) {
+            const int dropped = 64 - 4 * precision;
+            const std::uint64_t remainder = dropped == 64 ? fraction : fraction & ((std::uint64_t(1) << dropped) - 1);
+            const std::uint64_t half = std::uint64_t(1) << (dropped - 1);
+            std::uint64_t kept = dropped == 64 ? 0 : fraction >> dropped;
+            const bool odd = ((precision == 0 ? leading : kept) & 1) != 0;
+            if (remainder > half || (remainder == half && odd)) {
+                ++kept;
+                if (precision == 0 || (kept >> (4 * precision)) != 0) {
+                    ++leading;
+                    kept = 0;
+                }
+            }
+            fraction = dropped == 64 ? 0 : kept << dropped;
+        }
+    }
+
+    const char* digits = upperCase ? UPPERCASE_DIGITS : LOWERCASE_DIGITS;
+    body += digits[leading];
+    if (digitCount > 0 || forcePoint) {
+        body += '.';
+    }
+    for (int i = 0; i < digitCount; ++i) {
+        body += i < maxDigits ? digits[(fraction >> (60 - 4 * i)) & 0xf] : '0';
+    }
+
+    body += upperCase ? 'P' : 'p';
+    body += exponent < 0 ? '-' : '+';
+    char buffer[INTEGER_BUFFER_SIZE];
+    char* end = buffer + INTEGER_BUFFER_SIZE;
+    char* start = WriteDecimalDigits(static_cast<unsigned>(exponent < 0 ? -exponent : exponent), end);
+    body.append(start, end);
+}
+
+
+/**
+ * Gets the mantissa and exponent of a finite float or double as they are written in hexadecimal notation, see
+ * AppendHexadecimalNotation.
+ *
+ * Doubles are written like printf does, subnormal numbers as 0x0.hhhp-1022.  Subnormal floats are normal doubles, so
+ * they are normalized, which is how printf writes a float passed to it.
+ *
+ * @param[in] value  The value to split, this must be finite, the sign is ignored.
+ * @param[out] leading  The integer part of the mantissa.
+ * @param[out] fraction  The fraction of the mantissa, left aligned.
+ * @param[out] exponent  The binary exponent.
+ */
+void GetHexadecimalMantissa(const DecodedFloat& value, unsigned& leading, std::uint64_t& fraction, int& exponent)
+        noexcept
+{
+    fraction = value.ieeeMantissa << (64 - value.mantissaBits);
+    if (value.IsZero()) {
+        leading = 0;
+        exponent = 0;
+    }
+    else if (value.ieeeExponent != 0) {
+        leading = 1;
+        exponent = static_cast<int>(value.ieeeExponent) - value.exponentBias;
+    }
+    else if (value.mantissaBits < FloatTraits<double>::mantissa_bits) {
+        leading = 1;
+        exponent = 1 - value.exponentBias;
+        for (; (fraction >> 63) == 0; fraction <<= 1) {
+            --exponent;
+        }
+        fraction <<= 1;
+        --exponent;
+    }
+    else {
+        leading = 0;
+        exponent = 1 - value.exponentBias;
+    }
+}
+
+
+/**
+ * Appends a float or a double, formatted according to already parsed format specifiers, to a string.
+ *
+ * The value is converted to decimal digits in its own precision, without being widened to a long double:
+ *  - Without a precision, no presentation type and the general presentation types ('g', 'G' and 'n') write the
+ *    shortest representation, see GetShortestDigits.  Without a presentation type the value is written like
+ *    Python's repr, in fixed point notation for exponents from -4 to 15 (always with at least one decimal), and in
+ *    scientific notation otherwise, the general presentation types round it to 6 significant digits.
+ *  - With a precision, no presentation type and the general presentation types round the value to that many
+ *    significant digits, as described by GetSignificantDigits, and remove trailing zeroes unless the alternate form
+ *    is used, switching to scientific notation for exponents less than -4 or from the precision, like printf's %g.
+ *  - The fixed point, scientific and percentage presentation types round the value to a number of digits after the
+ *    decimal point, 6 unless a precision is given, using GetSignificantDigits for the scientific presentation types,
+ *    and AppendFixedNotationFast, or GetFixedDigits when it does not apply, for the others.
+ *  - The hexadecimal presentation types write the bits of the value, see AppendHexadecimalNotation.
+ *
+ * Any other presentation type is handled as if no presentation type was given.  The sign of NaN is never written.
+ *
+ * @param[in] value  The decoded value to format.
+ * @param[in] specifiers  The parsed format specifiers to use.
+ * @param[out] sink  The string to append the formatted value to.
+ */
+void AppendDecodedFloat(const DecodedFloat& value, const BasicFormatSpecifiers& specifiers, std::string& sink)
+{
+    const char type = specifiers.type;
+    const bool upperCase = type == FORMAT_GENERAL_DECIM_UC_TOGGLE || type == FORMAT_SCIENTIFIC_UC_TOGGLE ||
+                           type == FORMAT_FIXED_UC_TOGGLE || type == FORMAT_HEX_FLOAT_UC_TOGGLE;
+    const bool precisionSet = specifiers.precision != PRECISION_NOT_SET;
+    const int precision = precisionSet ? specifiers.precision : 6;
+    std::string body;
+
+    LayoutParts parts(nullptr, 0);
+    if (value.negative && !value.IsNaN()) {
+        parts.sign = '-';
+    }
+    else if (specifiers.sign == FORMAT_SIGN_ALWAYS_TOGGLE || specifiers.sign == FORMAT_SIGN_POSITIVE_SPACE_TOGGLE) {
+        parts.sign = specifiers.sign;
+    }
+    if (type == FORMAT_PERCENTAGE_MODE) {
+        parts.suffix = &FORMAT_PERCENTAGE_MODE;
+        parts.suffixLength = 1;
+    }
+
+    if (value.IsNaN() || value.IsInfinity()) {
+        body = value.IsNaN() ? (upperCase ? "NAN" : "nan") : (upperCase ? "INF" : "inf");
+    }
+    else {
+        const NumberPunctuation punctuation(specifiers);
+        std::string digits;
+        int exponent;
+
+        switch (type) {
+            case FORMAT_HEX_FLOAT_TOGGLE:
+            case FORMAT_HEX_FLOAT_UC_TOGGLE:
+                {
+                    unsigned leading;
+                    std::uint64_t fraction;
+                    GetHexadecimalMantissa(value, leading, fraction, exponent);
+                    AppendHexadecimalNotation(leading, fraction, exponent, specifiers.precision,
+                                              specifiers.alternateForm, upperCase, body);
+                    parts.prefix = upperCase ? "0X" : "0x";
+                    parts.prefixLength = 2;
+                }
+                break;
+
+            case FORMAT_SCIENTIFIC_TOGGLE:
+            case FORMAT_SCIENTIFIC_UC_TOGGLE:
+                exponent = GetSignificantDigits(value, precision + 1, digits);
+                AppendScientificNotation(digits.data(), static_cast<int>(digits.size()), exponent, precision,
+                                         specifiers.alternateForm, upperCase, punctuation.decimalPoint, body);
+                break;
+
+            case FORMAT_FIXED_TOGGLE:
+            case FORMAT_FIXED_UC_TOGGLE:
+            case FORMAT_PERCENTAGE_MODE:
+                {
+                    const int decimalShift = type == FORMAT_PERCENTAGE_MODE ? 2 : 0;
+                    if (AppendFixedNotationFast(value, precision, decimalShift, specifiers.alternateForm, punctuation,
+                                                body)) {
+                        break;
+                    }
+                    exponent = GetFixedDigits(value, precision, decimalShift, digits);
+                    AppendFixedNotation(digits.data(), static_cast<int>(digits.size()), exponent, precision,
+                                        specifiers.alternateForm, punctuation, body);
+                }
+                break;
+
+            case FORMAT_GENERAL_DECIM_TOGGLE:
+            case FORMAT_GENERAL_DECIM_UC_TOGGLE:
+            case FORMAT_LOCALIZED_NUMBER_TOGGLE:
+                {
+                    // A precision of 0 is treated as 1, like printf's %g does.
+                    const int significant = std::max(precision, 1);
+                    exponent = GetSignificantDigits(value, significant, digits);
+                    AppendGeneralNotation(digits.data(), static_cast<int>(digits.size()), exponent, significant,
+                                          significant, specifiers.alternateForm, 0, upperCase, punctuation, body);
+                }
+                break;
+
+            default:
+                if (precisionSet) {
+                    const int significant = std::max(precision, 1);
+                    exponent = GetSignificantDigits(value, significant, digits);
+                    AppendGeneralNotation(digits.data(), static_cast<int>(digits.size()), exponent, significant,
+                                          significant, specifiers.alternateForm, 0, false, punctuation, body);
+                }
+                else {
+                    exponent = GetShortestDigits(value, digits);
+                    AppendGeneralNotation(digits.data(), static_cast<int>(digits.size()), exponent,
+                                          static_cast<int>(digits.size()), 16, false, 1, false, punctuation, body);
+                }
+                break;
+        }
+    }
+
+    parts.body = body.data();
+    parts.bodyLength = body.size();
+    AppendLayout(parts, specifiers, FORMAT_ALIGN_RIGHT, sink);
+}
+
+
+/**
+ * Appends a long double in hexadecimal notation, formatted according to already parsed format specifiers, to a
+ * string.
+ *
+ * Long doubles with a mantissa of up to 64 bits, like the x87 extended precision format, are split by frexp and written
+ * by AppendHexadecimalNotation with a leading 1, rather than with a leading digit up to f as printf writes them.  Long
+ * doubles no wider than a double, as well as NaN and infinity, are written as a double.  Wider formats are written by
+ * a stream, which does not support a precision.
+ *
+ * @param[in] value  The value to format.
+ * @param[in] specifiers  The parsed format specifiers to use.
+ * @param[out] sink  The string to append the formatted value to.
+ */
+void AppendHexadecimalLongDouble(long double value, const BasicFormatSpecifiers& specifiers, std::string& sink)
+{
+    if (!std::isfinite(value) || std::numeric_limits<long double>::digits <= std::numeric_limits<double>::digits) {
+        AppendDecodedFloat(DecodeFloat(static_cast<double>(value)), specifiers, sink);
+        return;
+    }
+
+    const bool upperCase = specifiers.type == FORMAT_HEX_FLOAT_UC_TOGGLE;
+    std::string body;
+    if (std::numeric_limits<long double>::digits <= 64) {
+        int exponent = 0;
+        const long double mantissa = value == 0 ? 0 : std::frexp(std::fabs(value), &exponent);
+        const std::uint64_t bits = static_cast<std::uint64_t>(std::ldexp(mantissa, 64));
+        AppendHexadecimalNotation(static_cast<unsigned>(bits >> 63), bits << 1, value == 0 ? 0 : exponent - 1,
+                                  specifiers.precision, specifiers.alternateForm, upperCase, body);
+    }
+    else {
+        std::stringstream buffer;
+        buffer << std::hexfloat << (upperCase ? std::uppercase : std::nouppercase) << std::fabs(value);
+        body = buffer.str().substr(2);
+    }
+
+    LayoutParts parts(body.data(), body.size());
+    if (std::signbit(value)) {
+        parts.sign = '-';
+    }
+    else if (specifiers.sign == FORMAT_SIGN_ALWAYS_TOGGLE || specifiers.sign == FORMAT_SIGN_POSITIVE_SPACE_TOGGLE) {
+        parts.sign = specifiers.sign;
+    }
+    parts.prefix = upperCase ? "0X" : "0x";
+    parts.prefixLength = 2;
+    AppendLayout(parts, specifiers, FORMAT_ALIGN_RIGHT, sink);
+}
+
+
+/**
+ * Appends a decimal number, formatted according to already parsed format specifiers, to a string.
+ *
+ * The number itself is written by a stream, after which the sign is split from the written digits so they can be
+ * laid out by AppendLayout.  The hexadecimal presentation types are written by AppendHexadecimalLongDouble.
+ *
+ * @param[in] value  The value to format.
+ * @param[in] specifiers  The parsed format specifiers to use.
+ * @param[out] sink  The string to append the formatted value to.
+ */
+void AppendDecimal(long double value, const BasicFormatSpecifiers& specifiers, std::string& sink)
+{
+    if (specifiers.type == FORMAT_HEX_FLOAT_TOGGLE || specifiers.type == FORMAT_HEX_FLOAT_UC_TOGGLE) {
+        AppendHexadecimalLongDouble(value, specifiers, sink);
+        return;
+    }
+
+    bool useValue = true;
+    bool useDynamic = true;
+    std::streamsize minPrecision = DOUBLE_MIN_DEFAULT_PRECISION;
+    std::streamsize maxPrecision = DOUBLE_MAX_DEFAULT_PRECISION;
+    std::streamsize scientificCeil = 0;
+    std::stringstream buffer;
+    PreprocessStreamForDecimal(specifiers, buffer, value, useValue, useDynamic, minPrecision, maxPrecision, scientificCeil);
+    if (useValue) {
+        if (useDynamic && specifiers.precision == PRECISION_NOT_SET) {
+            FormatDynamicDecimal fdd(value, minPrecision, maxPrecision, scientificCeil);
+            buffer << fdd;
+        }
+        else {
+            buffer << value;
+        }
+    }
+
+    const std::string written = buffer.str();
+    LayoutParts parts(written.data(), written.size());
+    if (parts.bodyLength > 0 && (parts.body[0] == '-' || parts.body[0] == '+')) {
+        parts.sign = parts.body[0];
+        ++parts.body;
+        --parts.bodyLength;
+    }
+    else if (specifiers.sign == FORMAT_SIGN_POSITIVE_SPACE_TOGGLE) {
+        parts.sign = ' ';
+    }
+    if (specifiers.alternateForm) {
+        parts.prefix = GetAlternateFormPrefix(specifiers.type);
+        parts.prefixLength = parts.prefix ? 2 : 0;
+    }
+    if (specifiers.type == FORMAT_PERCENTAGE_MODE) {
+        parts.suffix = &FORMAT_PERCENTAGE_MODE;
+        parts.suffixLength = 1;
+    }
+    AppendLayout(parts, specifiers, FORMAT_ALIGN_RIGHT, sink);
+}
+
+
+/**
+ * Appends a float or a double, formatted according to already parsed format specifiers, to a string, see
+ * AppendDecodedFloat.
+ *
+ * @param[in] value  The value to format.
+ * @param[in] specifiers  The parsed format specifiers to use.
+ * @param[out] sink  The string to append the formatted value to.
+ */
+template <typename F>
+void AppendFloatingPoint(F value, const BasicFormatSpecifiers& specifiers, std::string& sink)
+{
+    AppendDecodedFloat(DecodeFloat(value), specifiers, sink);
+}
+
+
+/**
+ * Appends a value of one of the numeric types supported by FormatColumn to a string, these simply forward to either
+ * AppendInteger, AppendFloatingPoint or AppendDecimal.  Characters and bool are written as the int holding the same
+ * value, like FormatType does.
+ *
+ * @param[in] value  The value to format.
+ * @param[in] specifiers  The parsed format specifiers to use.
+ * @param[out] sink  The string to append the formatted value to.
+ */
+template <typename T>
+void AppendNumber(T value, const BasicFormatSpecifiers& specifiers, std::string& sink)
+{
+    AppendInteger(value, specifiers, sink);
+}
+
+void AppendNumber(char value, const BasicFormatSpecifiers& specifiers, std::string& sink)
+{
+    AppendInteger(static_cast<int>(value), specifiers, sink);
+}
+
+void AppendNumber(signed char value, const BasicFormatSpecifiers& specifiers, std::string& sink)
+{
+    AppendInteger(static_cast<int>(value), specifiers, sink);
+}
+
+void AppendNumber(unsigned char value, const BasicFormatSpecifiers& specifiers, std::string& sink)
+{
+    AppendInteger(static_cast<int>(value), specifiers, sink);
+}
+
+void AppendNumber(bool value, const BasicFormatSpecifiers& specifiers, std::string& sink)
+{
+    AppendInteger(static_cast<int>(value), specifiers, sink);
+}
+
+void AppendNumber(float value, const BasicFormatSpecifiers& specifiers, std::string& sink)
+{
+    AppendFloatingPoint(value, specifiers, sink);
+}
+
+void AppendNumber(double value, const BasicFormatSpecifiers& specifiers, std::string& sink)
+{
+    AppendFloatingPoint(value, specifiers, sink);
+}
+
+void AppendNumber(long double value, const BasicFormatSpecifiers& specifiers, std::string& sink)
+{
+    AppendDecimal(value, specifiers, sink);
+}
+
+
+/**
+ * Formats an integer of any width, this is the implementation behind all the integer FormatType functions.
+ *
+ * @param[in] value  The value to format.
+ * @param[in] formatSpecifier  The format specifier to use.
+ * @param[out] output  The output stream to write the formatted result to.
+ */
+template <typename T>
+void FormatInteger(T value, const char* formatSpecifier, std::ostream& output)
+{
+    int pos = 0;
+    BasicFormatSpecifiers specifiers;
+    InitializeFormatSpecifier(specifiers);
+    ConvertToBasicFormatSpecifiers(formatSpecifier, specifiers, pos);
+
+    std::string text;
+    AppendInteger(value, specifiers, text);
+    output.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+
+/**
+ * Applies the special functions (abs, sign, inc, dec, and sqrt) and explicit type conversions to an integer of any
+ * width, this is the implementation behind all the integer ConvertAndFormatType functions.
+ *
+ * The special functions operate in the arithmetic type described by IntegerTraits, so incrementing the largest value
+ * of a narrow type does not overflow.
+ *
+ * @param[in] value  The value we wish to output.
+ * @param[in,out] fragment  The format fragment, holding the selectors, explicit conversion and format specifier.
+ * @param[out] output  The output stream, to write the formatted output to.
+ *
+ * @return Returns true, since the value is always formatted.
+ */
+template <typename T>
+bool ConvertAndFormatInteger(T value, FormatFragment& fragment, std::ostream& output)
+{
+    typedef typename IntegerTraits<T>::arithmetic_type Arithmetic;
+
+    if (!fragment.selectors.empty()) {
+        const std::string selector = fragment.selectors.front().name;
+        fragment.selectors.pop();
+        Arithmetic arithmeticValue = static_cast<Arithmetic>(value);
+        bool isNegative = arithmeticValue < static_cast<Arithmetic>(0);
+
+        if (selector == "abs") {
+            return ConvertAndFormatType(isNegative ? Arithmetic(0) - arithmeticValue : arithmeticValue,
+                                        fragment, output);
+        }
+
+        if (selector == "sign") {
+            return ConvertAndFormatType(isNegative ? Arithmetic(0) - Arithmetic(1) : Arithmetic(1), fragment, output);
+        }
+
+        if (selector == "inc") {
+            return ConvertAndFormatType(static_cast<Arithmetic>(arithmeticValue + 1), fragment, output);
+        }
+
+        if (selector == "dec") {
+            return ConvertAndFormatType(static_cast<Arithmetic>(arithmeticValue - 1), fragment, output);
+        }
+
+        if (selector == "sqrt") {
+            if (sizeof(T) > sizeof(long long)) {
+                return ConvertAndFormatType(std::sqrt(static_cast<long double>(value)), fragment, output);
+            }
+            return ConvertAndFormatType(std::sqrt(static_cast<double>(value)), fragment, output);
+        }
+    }
+
+    switch (fragment.explicitConversion) {
+        case 's':
+        case 'r':
+            FormatType(IntegerToString(value), fragment.formatSpecifier, output);
+            break;
+
+        case 'd':
+            FormatType(static_cast<long double>(value), fragment.formatSpecifier, output);
+            break;
+
+        default:
+            FormatType(value, fragment.formatSpecifier, output);
+            break;
+    }
+
+    return true;
+}
+
+
+/**
+ * Formats a float or a double, this is the implementation behind the FormatType functions of these types.
+ *
+ * @param[in] value  The value to format.
+ * @param[in] formatSpecifier  The format specifier to use.
+ * @param[out] output  The output stream to write the formatted result to.
+ */
+template <typename F>
+void FormatFloatingPoint(F value, const char* formatSpecifier, std::ostream& output)
+{
+    int pos = 0;
+    BasicFormatSpecifiers specifiers;
+    InitializeFormatSpecifier(specifiers);
+    ConvertToBasicFormatSpecifiers(formatSpecifier, specifiers, pos);
+
+    std::string text;
+    AppendFloatingPoint(value, specifiers, text);
+    output.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+
+/**
+ * Applies the explicit type conversions to a float, double or long double, this is the implementation behind the
+ * ConvertAndFormatType functions of these types.
+ *
+ * @param[in] value  The value we wish to output.
+ * @param[in] fragment  The format fragment, holding the explicit conversion and format specifier.
+ * @param[out] output  The output stream, to write the formatted output to.
+ *
+ * @return Returns true, since the value is always formatted.
+ */
+template <typename F>
+bool ConvertAndFormatFloatingPoint(F value, FormatFragment& fragment, std::ostream& output)
+{
+    switch (fragment.explicitConversion) {
+        case 's':
+        case 'r':
+            FormatType(std::to_string(value), fragment.formatSpecifier, output);
+            break;
+
+        case 'i':
+            FormatType(static_cast<long long>(value), fragment.formatSpecifier, output);
+            break;
+
+        default:
+            FormatType(value, fragment.formatSpecifier, output);
+            break;
+    }
+
+    return true;
+}
+
+}
+
+namespace utils {
+namespace str {
+
+
+/**
+ * The constructor, constructing an IllegalFormatStringException for a specific format string, for an error
+ * occurring at position @p pos with the error message: @p message
+ *
+ * @param[in] formatStr  The format string causing the exception to be thrown.
+ * @param[in] pos  The position in the format string where the problem was detected.
+ * @param[in] message  The message describing the problem found.
+ */
+IllegalFormatStringException::IllegalFormatStringException(const std::string& formatStr, int pos, const std::string& message)
+    : std::runtime_error(message)
+{
+    this->formatString = formatStr;
+    this->errorPosition = pos;
+    this->message = message;
+
+    std::stringstream errorDescription;
+
+    errorDescription << "Invalid string format, error at position: " << errorPosition << std::endl;
+    errorDescription << formatString << std::endl;
+    errorDescription << std::setfill(' ') << std::setw(errorPosition) << "" << std::setfill('\0') << std::setw(0) << "^" << std::endl;
+    errorDescription << message << std::endl;
+
+    this->fullDescription = errorDescription.str();
+}
+
+
+IllegalFormatStringException::~IllegalFormatStringException() noexcept
+{
+    // Nothing to do here...
+}
+
+
+/**
+ * Returns the position in the format string where the error was detected.
+ *
+ * The position returned i 0 based, so a value of 0 indicates the first character in the format string.
+ *
+ * @return Returns the position in the format string where the error was detected.
+ */
+int IllegalFormatStringException::GetErrorPosition() const noexcept
+{
+    return this->errorPosition;
+}
+
+
+/**
+ * Returns the format string that is illegal.
+ *
+ * @return Returns the format string that is illegal.
+ */
+const char* IllegalFormatStringException::GetFormatString() const noexcept
+{
+    return this->formatString.c_str();
+}
+
+
+/**
+ * Returns the error message describing the error occurring from parsing the format string.
+ *
+ * @return Returns the error message describing the error occurring from parsing the format string.
+ */
+const char* IllegalFormatStringException::GetMessage() const noexcept
+{
+    return this->message.c_str();
+}
+
+
+/**
+ * Returns a complete descriptive string about the error occurred.
+ *
+ * @return Returns a complete descriptive string about the error occurred.
+ */
+const char* IllegalFormatStringException::what() const noexcept
+{
+    return this->fullDescription.c_str();
+}
+
+
+/**
+ * Converts the format parameter string to a struct of basic format specifiers.
+ *
+ * The format specifiers are extracted from the @p formatParameter argument, this function expects the input string to
+ * follow the convention written in Python PEP-3101: https://www.python.org/dev/peps/pep-3101/ Which is the format
+ * used for primitive types.
+ *
+ * @param[in]     formatParameter  The format parameter string
+ * @param[out]    specifiers  The specifiers struct to store the result in
+ * @param[in,out] pos  The position to begin extracting from, when this function returns this will be updated to the
+ *                first position after the format specifier string.
+ */
+void ConvertToBasicFormatSpecifiers(const char* formatParameter, BasicFormatSpecifiers& specifiers, int& pos)
+{
+    if (formatParameter && formatParameter[pos]) {
+        ReadAlignSpecifier(formatParameter, specifiers, pos);
+        ReadSignSpecifier(formatParameter, specifiers, pos);
+        ReadAlternateSpecifier(formatParameter, specifiers, pos);
+        ReadSignAwareZeroSpecifier(formatParameter, specifiers, pos);
+        ReadWidthSpecifier(formatParameter, specifiers, pos);
+        ReadThousandSepSpecifier(formatParameter, specifiers, pos);
+        ReadPrecisionSpecifier(formatParameter, specifiers, pos);
+        ReadTypeSpecifier(formatParameter, specifiers, pos);
+    }
+}
+
+
+/**
+ * Formatting functions for the character types, characters are formatted as the integer value of the character,
+ * exactly like an int holding the same value.
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(char value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatType(static_cast<int>(value), formatSpecifier, output);
+}
+
+void FormatType(signed char value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatType(static_cast<int>(value), formatSpecifier, output);
+}
+
+void FormatType(unsigned char value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatType(static_cast<int>(value), formatSpecifier, output);
+}
+
+
+/**
+ * Formatting function for the primitive type short, this will be called by the format function and can be called as is
+ * to format an integer from a specific format specifier.
+ *
+ * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
+ * https://www.python.org/dev/peps/pep-3101/
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(short value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatInteger(value, formatSpecifier, output);
+}
+
+
+/**
+ * Formatting function for the primitive type unsigned short, this will be called by the format function and can be
+ * called as is to format an integer from a specific format specifier.
+ *
+ * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
+ * https://www.python.org/dev/peps/pep-3101/
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(unsigned short value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatInteger(value, formatSpecifier, output);
+}
+
+
+/**
+ * Formatting function for the primitive type int, this will be called by the format function and can be called as is to
+ * format an integer from a specific format specifier.
+ *
+ * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
+ * https://www.python.org/dev/peps/pep-3101/
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(int value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatInteger(value, formatSpecifier, output);
+}
+
+
+/**
+ * Formatting function for the primitive type unsigned int, this will be called by the format function and can be called
+ * as is to format an integer from a specific format specifier.
+ *
+ * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
+ * https://www.python.org/dev/peps/pep-3101/
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(unsigned int value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatInteger(value, formatSpecifier, output);
+}
+
+
+/**
+ * Formatting function for the primitive type long, this will be called by the format function and can be called as is
+ * to format an integer from a specific format specifier.
+ *
+ * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
+ * https://www.python.org/dev/peps/pep-3101/
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(long value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatInteger(value, formatSpecifier, output);
+}
+
+
+/**
+ * Formatting function for the primitive type unsigned long, this will be called by the format function and can be
+ * called as is to format an integer from a specific format specifier.
+ *
+ * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
+ * https://www.python.org/dev/peps/pep-3101/
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(unsigned long value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatInteger(value, formatSpecifier, output);
+}
+
+
+/**
+ * Formatting function for the primitive type long long, this will be called by the format function and can be called as
+ * is to format an integer from a specific format specifier.
+ *
+ * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
+ * https://www.python.org/dev/peps/pep-3101/
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(long long value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatInteger(value, formatSpecifier, output);
+}
+
+
+/**
+ * Formatting function for the primitive type unsigned long long, this will be called by the format function and can be
+ * called as is to format an integer from a specific format specifier.
+ *
+ * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
+ * https://www.python.org/dev/peps/pep-3101/
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(unsigned long long value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatInteger(value, formatSpecifier, output);
+}
+
+
+#ifdef FORMAT_HAS_INT128
+/**
+ * Formatting function for the 128-bit integer type __int128, this will be called by the format function and can be
+ * called as is to format an integer from a specific format specifier.
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(__int128 value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatInteger(value, formatSpecifier, output);
+}
+
+
+/**
+ * Formatting function for the 128-bit integer type unsigned __int128, this will be called by the format function and
+ * can be called as is to format an integer from a specific format specifier.
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(unsigned __int128 value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatInteger(value, formatSpecifier, output);
+}
+#endif  // FORMAT_HAS_INT128
+
+
+/**
+ * Formatting function for the primitive type bool, this will be called by the format function and can be called as
+ * is to format a boolean from a specific format specifier.
+ *
+ * To the formatter all numbers of the type: int, long, int64, and bool are treated equally, thus the corresponding
+ * format functions converts their respective @p value to an int64 and calls the corresponding FormatType function.
+ *
+ * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
+ * https://www.python.org/dev/peps/pep-3101/
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(bool value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatType(static_cast<long long>(value), formatSpecifier, output);
+}
+
+
+/**
+ * Formatting function for the primitive type float, this will be called by the format function and can be called as
+ * is to format an integer from a specific format specifier.
+ *
+ * The value is converted in its own precision, it is never widened to a long double.  Without a precision, no
+ * presentation type and the types 'g', 'G' and 'n' write the value in its shortest form, using the fewest digits that
+ * read back as the same float, like Python does.  All other cases round the exact value of @p value half to even.
+ *
+ * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
+ * https://www.python.org/dev/peps/pep-3101/
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(float value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatFloatingPoint(value, formatSpecifier, output);
+}
+
+
+/**
+ * Formatting function for the primitive type double, this will be called by the format function and can be called as
+ * is to format an integer from a specific format specifier.
+ *
+ * The value is converted in its own precision, it is never widened to a long double.  Without a precision, no
+ * presentation type and the types 'g', 'G' and 'n' write the value in its shortest form, using the fewest digits that
+ * read back as the same double, like Python does.  All other cases round the exact value of @p value half to even.
+ *
+ * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
+ * https://www.python.org/dev/peps/pep-3101/
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(double value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatFloatingPoint(value, formatSpecifier, output);
+}
+
+
+/**
+ * Formatting function for the primitive type double, this will be called by the format function and can be called as
+ * is to format an integer from a specific format specifier.
+ *
+ * Unlike the float and double formatting functions, a long double is written by a stream.
+ *
+ * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
+ * https://www.python.org/dev/peps/pep-3101/
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(long double value, const char* formatSpecifier, std::ostream& output)
+{
+    int pos = 0;
+    BasicFormatSpecifiers specifiers;
+    InitializeFormatSpecifier(specifiers);
+    ConvertToBasicFormatSpecifiers(formatSpecifier, specifiers, pos);
+
+    std::string text;
+    AppendDecimal(value, specifiers, text);
+    output.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+
+/**
+ * Formatting function for the std class string, this will be called by the format function and can be called as
+ * is to format a string from a specific format specifier.
+ *
+ * To the formatter all strings of the type: char* and string are treated equally, the string is written from its
+ * data and size by the pointer and length version of FormatType, without being copied.
+ *
+ * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
+ * https://www.python.org/dev/peps/pep-3101/
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(const std::string& value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatType(value.data(), value.size(), formatSpecifier, output);
+}
+
+
+/**
+ * Formatting function for the primitive type char*, this will be called by the format function and can be called as
+ * is to format a string from a specific format specifier.
+ *
+ * To the formatter all strings of the type: char* and string are treated equally.  With a precision, @p value is
+ * only read up to the precision, so it does not have to be scanned for its null terminator.
  *
  * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
  * https://www.python.org/dev/peps/pep-3101/
  *
- * @param value[in]  The value to format.
- * @param formatSpecifier[in]  The format specifier to use.
- * @param output[out]  A reference to an output stream to write the formatted result to.
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(const char* value, const char* formatSpecifier, std::ostream& output)
+{
+    int pos = 0;
+    BasicFormatSpecifiers specifiers;
+    InitializeFormatSpecifier(specifiers);
+    ConvertToBasicFormatSpecifiers(formatSpecifier, specifiers, pos);
+
+    WriteString(value, GetVisibleLength(value, specifiers.precision), specifiers, output);
+}
+
+
+/**
+ * Formatting function for a string given by a pointer and a length, this will be called by the format function for
+ * std::string, string slices and string views, and can be called as is to format a string from a specific format
+ * specifier.
+ *
+ * The characters are read directly from @p value, so the string does not need to be null terminated.
+ *
+ * @param value[in]  The value to format.
+ * @param length[in]  The number of characters in @p value.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(const char* value, std::size_t length, const char* formatSpecifier, std::ostream& output)
+{
+    int pos = 0;
+    BasicFormatSpecifiers specifiers;
+    InitializeFormatSpecifier(specifiers);
+    ConvertToBasicFormatSpecifiers(formatSpecifier, specifiers, pos);
+
+    WriteString(value, length, specifiers, output);
+}
+
+
+/**
+ * Formatting function for a string slice, see the pointer and length version of FormatType.
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(StringSlice value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatType(value.data, value.size, formatSpecifier, output);
+}
+
+
+/**
+ * Formats a column of numbers using the same format specifier for every value, the specifier is parsed once and all
+ * values are formatted into one buffer, which is written to @p output in a single operation.
+ *
+ * @param values[in]  Pointer to the first value to format.
+ * @param count[in]  The number of values to format.
+ * @param formatSpecifier[in]  The format specifier to use for every value.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ * @param separator[in]  The text to write between two values.
+ */
+template <typename T>
+void FormatColumn(const T* values, std::size_t count, const char* formatSpecifier, std::ostream& output,
+                  const char* separator)
+{
+    int pos = 0;
+    BasicFormatSpecifiers specifiers;
+    InitializeFormatSpecifier(specifiers);
+    ConvertToBasicFormatSpecifiers(formatSpecifier, specifiers, pos);
+
+    const std::size_t separatorLength = std::strlen(separator);
+    const std::size_t expectedWidth = static_cast<std::size_t>(std::max(specifiers.width, 8));
+    std::string column;
+    column.reserve(count * (expectedWidth + separatorLength));
+    for (std::size_t i = 0; i < count; ++i) {
+        if (i > 0) {
+            column.append(separator, separatorLength);
+        }
+        AppendNumber(values[i], specifiers, column);
+    }
+    output.write(column.data(), static_cast<std::streamsize>(column.size()));
+}
+
+
+// Explicit instantiations of FormatColumn for the supported types
+template void FormatColumn(const char*, std::size_t, const char*, std::ostream&, const char*);
+template void FormatColumn(const signed char*, std::size_t, const char*, std::ostream&, const char*);
+template void FormatColumn(const unsigned char*, std::size_t, const char*, std::ostream&, const char*);
+template void FormatColumn(const bool*, std::size_t, const char*, std::ostream&, const char*);
+template void FormatColumn(const short*, std::size_t, const char*, std::ostream&, const char*);
+template void FormatColumn(const unsigned short*, std::size_t, const char*, std::ostream&, const char*);
+template void FormatColumn(const int*, std::size_t, const char*, std::ostream&, const char*);
+template void FormatColumn(const unsigned int*, std::size_t, const char*, std::ostream&, const char*);
+template void FormatColumn(const long*, std::size_t, const char*, std::ostream&, const char*);
+template void FormatColumn(const unsigned long*, std::size_t, const char*, std::ostream&, const char*);
+template void FormatColumn(const long long*, std::size_t, const char*, std::ostream&, const char*);
+template void FormatColumn(const unsigned long long*, std::size_t, const char*, std::ostream&, const char*);
+#ifdef FORMAT_HAS_INT128
+template void FormatColumn(const __int128*, std::size_t, const char*, std::ostream&, const char*);
+template void FormatColumn(const unsigned __int128*, std::size_t, const char*, std::ostream&, const char*);
+#endif  // FORMAT_HAS_INT128
+template void FormatColumn(const float*, std::size_t, const char*, std::ostream&, const char*);
+template void FormatColumn(const double*, std::size_t, const char*, std::ostream&, const char*);
+template void FormatColumn(const long double*, std::size_t, const char*, std::ostream&, const char*);
+
+
+/**
+ * Parses a format specifier, for use by the AppendType functions.
+ *
+ * @param formatSpecifier[in]  The format specifier to parse, it is referenced by @p parsed, not copied.
+ * @param parsed[out]  The parsed format specifier.
+ */
+void ParseFormatSpecifier(const char* formatSpecifier, ParsedFormatSpecifier& parsed)
+{
+    ParseFormatSpecifier(formatSpecifier, GetDefaultElementLimit(), GetDefaultDelimiters(), parsed);
+}
+
+
+/**
+ * Parses a format specifier with a given element limit and delimiters.  If the format specifier is split by a colon,
+ * the container level before it is parsed here, and the element level after it is parsed recursively, using the limit
+ * and delimiters of the container level.  A leading colon followed by an alignment is a fill character, not a split,
+ * so {::>8} pads every element with colons, the same as {:::>8}.
+ *
+ * @exception IllegalFormatStringException An exception is thrown if the container level is not valid.
+ *
+ * @param formatSpecifier[in]  The format specifier to parse, it is referenced by @p parsed, not copied.
+ * @param elementLimit[in]  The element limit to use, unless the container level has a limit.
+ * @param delimiters[in]  The delimiters to use, unless the container level chooses others.
+ * @param parsed[out]  The parsed format specifier.
+ */
+void ParseFormatSpecifier(const char* formatSpecifier, std::size_t elementLimit, const ContainerDelimiters& delimiters,
+                          ParsedFormatSpecifier& parsed)
+{
+    int pos = 0;
+    parsed.text = formatSpecifier;
+    parsed.elementLimit = elementLimit;
+    parsed.delimiters = &delimiters;
+    parsed.element.reset();
+    InitializeFormatSpecifier(parsed.specifiers);
+    InitializeFormatSpecifier(parsed.containerSpecifiers);
+    ConvertToBasicFormatSpecifiers(formatSpecifier, parsed.specifiers, pos);
+
+    if (formatSpecifier == nullptr) {
+        return;
+    }
+
+    // A colon used as the fill character, as in {::>8}, keeps its meaning and does not split the format specifier.
+    const char* search = formatSpecifier;
+    if (search[0] == FORMAT_CONTAINER_SPLIT && search[1] != '\0' && std::strchr("<>^=", search[1]) != nullptr) {
+        ++search;
+    }
+    const char* split = std::strchr(search, FORMAT_CONTAINER_SPLIT);
+    if (split == nullptr) {
+        return;
+    }
+
+    // The container level is copied, so it is not read past the colon.
+    const std::string containerSpecifier(formatSpecifier, static_cast<std::size_t>(split - formatSpecifier));
+    BasicFormatSpecifiers& container = parsed.containerSpecifiers;
+    pos = 0;
+    ReadAlignSpecifier(containerSpecifier.c_str(), container, pos);
+    ReadWidthSpecifier(containerSpecifier.c_str(), container, pos);
+    ReadPrecisionSpecifier(containerSpecifier.c_str(), container, pos);
+    if (containerSpecifier[pos] != '\0' && std::strchr("cjsn", containerSpecifier[pos]) != nullptr) {
+        container.type = containerSpecifier[pos];
+        ++pos;
+    }
+    if (containerSpecifier[pos] != '\0' || container.align == FORMAT_ALIGN_INTERNAL) {
+        throw IllegalFormatStringException(formatSpecifier, pos, "Invalid container format specifier, expected "
+                                           "[[fill]align][width][.limit][type] with one of the types: c, j, s, and n");
+    }
+
+    if (container.precision != PRECISION_NOT_SET) {
+        parsed.elementLimit = static_cast<std::size_t>(container.precision);
+    }
+    if (container.type == 'c') {
+        parsed.delimiters = &GetCsvDelimiters();
+    }
+    else if (container.type == 'j') {
+        parsed.delimiters = &GetJsonDelimiters();
+    }
+    else if (container.type == 's') {
+        parsed.delimiters = &GetSpaceDelimiters();
+    }
+
+    std::shared_ptr<ParsedFormatSpecifier> element = std::make_shared<ParsedFormatSpecifier>();
+    ParseFormatSpecifier(split + 1, parsed.elementLimit, *parsed.delimiters, *element);
+    parsed.element = element;
+}
+
+
+void AlignContainer(const ParsedFormatSpecifier& formatSpecifier, std::size_t start, std::string& sink)
+{
+    const BasicFormatSpecifiers& container = formatSpecifier.containerSpecifiers;
+    const std::size_t width = MeasureString(sink.data() + start, sink.size() - start, 0).width;
+    const std::size_t fieldWidth = static_cast<std::size_t>(container.width);
+    if (width >= fieldWidth) {
+        return;
+    }
+
+    const std::size_t padding = fieldWidth - width;
+    const char fill = container.fill != '\0' ? container.fill : ' ';
+    std::size_t before = 0;
+    if (container.align == FORMAT_ALIGN_RIGHT) {
+        before = padding;
+    }
+    else if (container.align == FORMAT_ALIGN_CENTER) {
+        before = padding / 2;
+    }
+    sink.insert(start, before, fill);
+    sink.append(padding - before, fill);
+}
+
+
+std::size_t GetDefaultElementLimit()
+{
+#ifdef FORMAT_ELEMENT_LIMIT
+    return FORMAT_ELEMENT_LIMIT;
+#else
+    return std::numeric_limits<std::size_t>::max();
+#endif  // FORMAT_ELEMENT_LIMIT
+}
+
+
+const ContainerDelimiters& GetDefaultDelimiters()
+{
+    static const ContainerDelimiters delimiters;
+    return delimiters;
+}
+
+
+const ContainerDelimiters& GetCsvDelimiters()
+{
+    static const ContainerDelimiters delimiters = {{"", ",", ""}, {"", ",", ""}, {"", ",", ""}, {"", ",", ""}};
+    return delimiters;
+}
+
+
+const ContainerDelimiters& GetJsonDelimiters()
+{
+    static const ContainerDelimiters delimiters = {{"[", ",", "]"}, {"{", ",", "}"}, {"", ":", ""}, {"[", ",", "]"}};
+    return delimiters;
+}
+
+
+const ContainerDelimiters& GetSpaceDelimiters()
+{
+    static const ContainerDelimiters delimiters = {{"", " ", ""}, {"", " ", ""}, {"", "=", ""}, {"", " ", ""}};
+    return delimiters;
+}
+
+
+void AppendElision(std::size_t remaining, const char* separator, std::string& sink)
+{
+    sink += separator;
+    sink += "... (";
+    sink += std::to_string(remaining);
+    sink += " more)";
+}
+
+
+// Appending of values formatted by a parsed format specifier, used for the elements of containers
+void AppendType(char value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendNumber(static_cast<int>(value), formatSpecifier.specifiers, sink);
+}
+
+void AppendType(signed char value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendNumber(static_cast<int>(value), formatSpecifier.specifiers, sink);
+}
+
+void AppendType(unsigned char value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendNumber(static_cast<int>(value), formatSpecifier.specifiers, sink);
+}
+
+void AppendType(short value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendNumber(value, formatSpecifier.specifiers, sink);
+}
+
+void AppendType(unsigned short value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendNumber(value, formatSpecifier.specifiers, sink);
+}
+
+void AppendType(int value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendNumber(value, formatSpecifier.specifiers, sink);
+}
+
+void AppendType(unsigned int value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendNumber(value, formatSpecifier.specifiers, sink);
+}
+
+void AppendType(long value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendNumber(value, formatSpecifier.specifiers, sink);
+}
+
+void AppendType(unsigned long value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendNumber(value, formatSpecifier.specifiers, sink);
+}
+
+void AppendType(long long value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendNumber(value, formatSpecifier.specifiers, sink);
+}
+
+void AppendType(unsigned long long value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendNumber(value, formatSpecifier.specifiers, sink);
+}
+
+#ifdef FORMAT_HAS_INT128
+void AppendType(__int128 value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendNumber(value, formatSpecifier.specifiers, sink);
+}
+
+void AppendType(unsigned __int128 value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendNumber(value, formatSpecifier.specifiers, sink);
+}
+#endif  // FORMAT_HAS_INT128
+
+void AppendType(float value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendNumber(value, formatSpecifier.specifiers, sink);
+}
+
+void AppendType(double value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendNumber(value, formatSpecifier.specifiers, sink);
+}
+
+void AppendType(long double value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendNumber(value, formatSpecifier.specifiers, sink);
+}
+
+void AppendType(bool value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendNumber(static_cast<long long>(value), formatSpecifier.specifiers, sink);
+}
+
+void AppendType(const char* value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    StringSink output(sink);
+    WriteString(value, GetVisibleLength(value, formatSpecifier.specifiers.precision), formatSpecifier.specifiers,
+                output);
+}
+
+void AppendType(const std::string& value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    StringSink output(sink);
+    WriteString(value.data(), value.size(), formatSpecifier.specifiers, output);
+}
+
+void AppendType(StringSlice value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    StringSink output(sink);
+    WriteString(value.data, value.size, formatSpecifier.specifiers, output);
+}
+
+/**
+ * Converts a character value to a different type specified by the format string, characters are converted exactly
+ * like an int holding the same value.
+ *
+ * @param[in]  value  The value we wish to output.
+ * @param[in,out]  fragment  The format fragment, holding the conversion and format specifier.
+ * @param[out]  output  The output stream, to write the formatted output to.
+ *
+ * @return Returns true if the type was converted and formatted, otherwise false is returned, meaning formatting is
+ *         required elsewhere.
+ */
+bool ConvertAndFormatType(char value, FormatFragment& fragment, std::ostream& output)
+{
+    return ConvertAndFormatInteger(static_cast<int>(value), fragment, output);
+}
+
+bool ConvertAndFormatType(signed char value, FormatFragment& fragment, std::ostream& output)
+{
+    return ConvertAndFormatInteger(static_cast<int>(value), fragment, output);
+}
+
+bool ConvertAndFormatType(unsigned char value, FormatFragment& fragment, std::ostream& output)
+{
+    return ConvertAndFormatInteger(static_cast<int>(value), fragment, output);
+}
+
+
+/**
+ * Converts the short value to a different type specified by the format string, if the conversion was done and formatted
+ * within this scope the function returns true, otherwise the function returns false, and nothing will have been output.
+ *
+ * @param[in]  value  The value we wish to output.
+ * @param[in]  convertToType  The type we wish to convert to before outputting, this can be any of type s, r and d.
+ * @param[in]  formatSpecifier  The format specifier to send to the converted result.
+ * @param[out]  output  The output stream, to write the formatted output to.
+ *
+ * @return Returns true if the type was converted and formatted, otherwise false is returned, meaning formatting is
+ *         required elsewhere.
+ */
+bool ConvertAndFormatType(short value, FormatFragment& fragment, std::ostream& output)
+{
+    return ConvertAndFormatInteger(value, fragment, output);
+}
+
+
+/**
+ * Converts the unsigned short value to a different type specified by the format string, if the conversion was done and
+ * formatted within this scope the function returns true, otherwise the function returns false, and nothing will have
+ * been output.
+ *
+ * @param[in]  value  The value we wish to output.
+ * @param[in]  convertToType  The type we wish to convert to before outputting, this can be any of type s, r and d.
+ * @param[in]  formatSpecifier  The format specifier to send to the converted result.
+ * @param[out]  output  The output stream, to write the formatted output to.
+ *
+ * @return Returns true if the type was converted and formatted, otherwise false is returned, meaning formatting is
+ *         required elsewhere.
+ */
+bool ConvertAndFormatType(unsigned short value, FormatFragment& fragment, std::ostream& output)
+{
+    return ConvertAndFormatInteger(value, fragment, output);
+}
+
+
+/**
+ * Converts the int value to a different type specified by the format string, if the conversion was done and formatted
+ * within this scope the function returns true, otherwise the function returns false, and nothing will have been output.
+ *
+ * @param[in]  value  The value we wish to output.
+ * @param[in]  convertToType  The type we wish to convert to before outputting, this can be any of type s, r and d.
+ * @param[in]  formatSpecifier  The format specifier to send to the converted result.
+ * @param[out]  output  The output stream, to write the formatted output to.
+ *
+ * @return Returns true if the type was converted and formatted, otherwise false is returned, meaning formatting is
+ *         required elsewhere.
  */
-void FormatType(float value, const char* formatSpecifier, std::ostream& output)
+bool ConvertAndFormatType(int value, FormatFragment& fragment, std::ostream& output)
 {
-    FormatType(static_cast<long double>(value), formatSpecifier, output);
+    return ConvertAndFormatInteger(value, fragment, output);
 }
 
 
 /**
- * Formatting function for the primitive type double, this will be called by the format function and can be called as
- * is to format an integer from a specific format specifier.
- *
- * To the formatter all numbers of the type: float, double and long double are treated equally, thus this function
- * converts @p value to a long double and calls the corresponding FormatType function.
+ * Converts the unsigned int value to a different type specified by the format string, if the conversion was done and
+ * formatted within this scope the function returns true, otherwise the function returns false, and nothing will have
+ * been output.
  *
- * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
- * https://www.python.org/dev/peps/pep-3101/
+ * @param[in]  value  The value we wish to output.
+ * @param[in]  convertToType  The type we wish to convert to before outputting, this can be any of type s, r and d.
+ * @param[in]  formatSpecifier  The format specifier to send to the converted result.
+ * @param[out]  output  The output stream, to write the formatted output to.
  *
- * @param value[in]  The value to format.
- * @param formatSpecifier[in]  The format specifier to use.
- * @param output[out]  A reference to an output stream to write the formatted result to.
+ * @return Returns true if the type was converted and formatted, otherwise false is returned, meaning formatting is
+ *         required elsewhere.
  */
-void FormatType(double value, const char* formatSpecifier, std::ostream& output)
+bool ConvertAndFormatType(unsigned int value, FormatFragment& fragment, std::ostream& output)
 {
-    FormatType(static_cast<long double>(value), formatSpecifier, output);
+    return ConvertAndFormatInteger(value, fragment, output);
 }
 
 
 /**
- * Formatting function for the primitive type double, this will be called by the format function and can be called as
- * is to format an integer from a specific format specifier.
- *
- * To the formatter all numbers of the type: float, double and long double are treated equally, thus the corresponding
- * format functions converts their respective @p value to a long double and calls this function.
+ * Converts the long value to a different type specified by the format string, if the conversion was done and formatted
+ * within this scope the function returns true, otherwise the function returns false, and nothing will have been output.
  *
- * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
- * https://www.python.org/dev/peps/pep-3101/
+ * @param[in]  value  The value we wish to output.
+ * @param[in]  convertToType  The type we wish to convert to before outputting, this can be any of type s, r and d.
+ * @param[in]  formatSpecifier  The format specifier to send to the converted result.
+ * @param[out]  output  The output stream, to write the formatted output to.
  *
- * @param value[in]  The value to format.
- * @param formatSpecifier[in]  The format specifier to use.
- * @param output[out]  A reference to an output stream to write the formatted result to.
+ * @return Returns true if the type was converted and formatted, otherwise false is returned, meaning formatting is
+ *         required elsewhere.
  */
-void FormatType(long double value, const char* formatSpecifier, std::ostream& output)
+bool ConvertAndFormatType(long value, FormatFragment& fragment, std::ostream& output)
 {
-    int pos = 0;
-    BasicFormatSpecifiers specifiers;
-    InitializeFormatSpecifier(specifiers);
-    ConvertToBasicFormatSpecifiers(formatSpecifier, specifiers, pos);
-
-    bool useValue = true;
-    bool useDynamic = true;
-    std::streamsize minPrecision = DOUBLE_MIN_DEFAULT_PRECISION;
-    std::streamsize maxPrecision = DOUBLE_MAX_DEFAULT_PRECISION;
-    std::streamsize scientificCeil = 0;
-    std::stringstream buffer;
-    PreprocessStreamForDecimal(specifiers, buffer, value, useValue, useDynamic, minPrecision, maxPrecision, scientificCeil);
-    if (useValue) {
-        if (useDynamic && specifiers.precision == PRECISION_NOT_SET) {
-            FormatDynamicDecimal fdd(value, minPrecision, maxPrecision, scientificCeil);
-            buffer << fdd;
-        }
-        else {
-            buffer << value;
-        }
-    }
-    PostprocessStreamForDecimal(buffer.str(), specifiers, output, value);
+    return ConvertAndFormatInteger(value, fragment, output);
 }
 
 
 /**
- * Formatting function for the std class string, this will be called by the format function and can be called as
- * is to format a string from a specific format specifier.
- *
- * To the formatter all strings of the type: char* and string are treated equally, thus the corresponding format
- * functions converts their respective @p value to a const char* and calls the function FormatType for type const char*
- * function.
+ * Converts the unsigned long value to a different type specified by the format string, if the conversion was done and
+ * formatted within this scope the function returns true, otherwise the function returns false, and nothing will have
+ * been output.
  *
- * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
- * https://www.python.org/dev/peps/pep-3101/
+ * @param[in]  value  The value we wish to output.
+ * @param[in]  convertToType  The type we wish to convert to before outputting, this can be any of type s, r and d.
+ * @param[in]  formatSpecifier  The format specifier to send to the converted result.
+ * @param[out]  output  The output stream, to write the formatted output to.
  *
- * @param value[in]  The value to format.
- * @param formatSpecifier[in]  The format specifier to use.
- * @param output[out]  A reference to an output stream to write the formatted result to.
+ * @return Returns true if the type was converted and formatted, otherwise false is returned, meaning formatting is
+ *         required elsewhere.
  */
-void FormatType(const std::string& value, const char* formatSpecifier, std::ostream& output)
+bool ConvertAndFormatType(unsigned long value, FormatFragment& fragment, std::ostream& output)
 {
-    FormatType(value.c_str(), formatSpecifier, output);
+    return ConvertAndFormatInteger(value, fragment, output);
 }
 
 
 /**
- * Formatting function for the primitive type char*, this will be called by the format function and can be called as
- * is to format a string from a specific format specifier.
+ * Converts the int64 value to a different type specified by the format string, if the conversion was done and formatted
+ * within this scope the function returns true, otherwise the function returns false, and nothing will have been output.
  *
- * To the formatter all strings of the type: char* and string are treated equally, thus the corresponding format
- * functions converts their respective @p value to a const char* and calls this function.
- *
- * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
- * https://www.python.org/dev/peps/pep-3101/
+ * @param[in]  value  The value we wish to output.
+ * @param[in]  convertToType  The type we wish to convert to before outputting, this can be any of type s, r and d.
+ * @param[in]  formatSpecifier  The format specifier to send to the converted result.
+ * @param[out]  output  The output stream, to write the formatted output to.
  *
- * @param value[in]  The value to format.
- * @param formatSpecifier[in]  The format specifier to use.
- * @param output[out]  A reference to an output stream to write the formatted result to.
+ * @return Returns true if the type was converted and formatted, otherwise false is returned, meaning formatting is
+ *         required elsewhere.
  */
-void FormatType(const char* value, const char* formatSpecifier, std::ostream& output)
+bool ConvertAndFormatType(long long value, FormatFragment& fragment, std::ostream& output)
 {
-    int pos = 0;
-    BasicFormatSpecifiers specifiers;
-    InitializeFormatSpecifier(specifiers);
-    ConvertToBasicFormatSpecifiers(formatSpecifier, specifiers, pos);
-
-    bool useValue = true;
-    std::stringstream buffer;
-    PreprocessStreamForString(specifiers, buffer, value, useValue);
-    if (useValue) {
-        buffer << value;
-    }
-    PostprocessStreamForString(buffer.str(), specifiers, output, value);
+    return ConvertAndFormatInteger(value, fragment, output);
 }
 
 
 /**
- * Converts the short value to a different type specified by the format string, if the conversion was done and
+ * Converts the unsigned int64 value to a different type specified by the format string, if the conversion was done and
  * formatted within this scope the function returns true, otherwise the function returns false, and nothing will have
  * been output.
  *
@@ -2134,14 +5252,15 @@ void FormatType(const char* value, const char* formatSpecifier, std::ostream& ou
  * @return Returns true if the type was converted and formatted, otherwise false is returned, meaning formatting is
  *         required elsewhere.
  */
-bool ConvertAndFormatType(short value, FormatFragment& fragment, std::ostream& output)
+bool ConvertAndFormatType(unsigned long long value, FormatFragment& fragment, std::ostream& output)
 {
-    return ConvertAndFormatType(static_cast<long long>(value), fragment, output);
+    return ConvertAndFormatInteger(value, fragment, output);
 }
 
 
+#ifdef FORMAT_HAS_INT128
 /**
- * Converts the int value to a different type specified by the format string, if the conversion was done and
+ * Converts the 128-bit integer value to a different type specified by the format string, if the conversion was done and
  * formatted within this scope the function returns true, otherwise the function returns false, and nothing will have
  * been output.
  *
@@ -2153,16 +5272,16 @@ bool ConvertAndFormatType(short value, FormatFragment& fragment, std::ostream& o
  * @return Returns true if the type was converted and formatted, otherwise false is returned, meaning formatting is
  *         required elsewhere.
  */
-bool ConvertAndFormatType(int value, FormatFragment& fragment, std::ostream& output)
+bool ConvertAndFormatType(__int128 value, FormatFragment& fragment, std::ostream& output)
 {
-    return ConvertAndFormatType(static_cast<long long>(value), fragment, output);
+    return ConvertAndFormatInteger(value, fragment, output);
 }
 
 
 /**
- * Converts the int64 value to a different type specified by the format string, if the conversion was done and
- * formatted within this scope the function returns true, otherwise the function returns false, and nothing will have
- * been output.
+ * Converts the unsigned 128-bit integer value to a different type specified by the format string, if the conversion was
+ * done and formatted within this scope the function returns true, otherwise the function returns false, and nothing
+ * will have been output.
  *
  * @param[in]  value  The value we wish to output.
  * @param[in]  convertToType  The type we wish to convert to before outputting, this can be any of type s, r and d.
@@ -2172,50 +5291,11 @@ bool ConvertAndFormatType(int value, FormatFragment& fragment, std::ostream& out
  * @return Returns true if the type was converted and formatted, otherwise false is returned, meaning formatting is
  *         required elsewhere.
  */
-bool ConvertAndFormatType(long long value, FormatFragment& fragment, std::ostream& output)
+bool ConvertAndFormatType(unsigned __int128 value, FormatFragment& fragment, std::ostream& output)
 {
-    if (!fragment.selectors.empty()) {
-        std::string selector = fragment.selectors.front();
-        fragment.selectors.pop();
-
-        if (selector == "abs") {
-            return ConvertAndFormatType(std::abs(value), fragment, output);
-        }
-
-        if (selector == "sign") {
-            return ConvertAndFormatType((value < 0ll ? -1ll : 1ll), fragment, output);
-        }
-
-        if (selector == "inc") {
-            return ConvertAndFormatType(value + 1, fragment, output);
-        }
-
-        if (selector == "dec") {
-            return ConvertAndFormatType(value - 1, fragment, output);
-        }
-
-        if (selector == "sqrt") {
-            return ConvertAndFormatType(std::sqrt(value), fragment, output);
-        }
-    }
-
-    switch (fragment.explicitConversion) {
-        case 's':
-        case 'r':
-            FormatType(std::to_string(value), fragment.formatSpecifier, output);
-            break;
-
-        case 'd':
-            FormatType(static_cast<long double>(value), fragment.formatSpecifier, output);
-            break;
-
-        default:
-            FormatType(value, fragment.formatSpecifier, output);
-            break;
-    }
-
-    return true;
+    return ConvertAndFormatInteger(value, fragment, output);
 }
+#endif  // FORMAT_HAS_INT128
 
 
 /**
@@ -2233,7 +5313,7 @@ bool ConvertAndFormatType(long long value, FormatFragment& fragment, std::ostrea
  */
 bool ConvertAndFormatType(float value, FormatFragment& fragment, std::ostream& output)
 {
-    return ConvertAndFormatType(static_cast<long double>(value), fragment, output);
+    return ConvertAndFormatFloatingPoint(value, fragment, output);
 }
 
 
@@ -2252,7 +5332,7 @@ bool ConvertAndFormatType(float value, FormatFragment& fragment, std::ostream& o
  */
 bool ConvertAndFormatType(double value, FormatFragment& fragment, std::ostream& output)
 {
-    return ConvertAndFormatType(static_cast<long double>(value), fragment, output);
+    return ConvertAndFormatFloatingPoint(value, fragment, output);
 }
 
 
@@ -2271,22 +5351,7 @@ bool ConvertAndFormatType(double value, FormatFragment& fragment, std::ostream&
  */
 bool ConvertAndFormatType(long double value, FormatFragment& fragment, std::ostream& output)
 {
-    switch (fragment.explicitConversion) {
-        case 's':
-        case 'r':
-            FormatType(std::to_string(value), fragment.formatSpecifier, output);
-            break;
-
-        case 'i':
-            FormatType(static_cast<long long>(value), fragment.formatSpecifier, output);
-            break;
-
-        default:
-            FormatType(value, fragment.formatSpecifier, output);
-            break;
-    }
-
-    return true;
+    return ConvertAndFormatFloatingPoint(value, fragment, output);
 }
 
 
@@ -2352,7 +5417,7 @@ bool ConvertAndFormatType(bool value, FormatFragment& fragment, std::ostream& ou
  */
 bool ConvertAndFormatType(const std::string& value, FormatFragment& fragment, std::ostream& output)
 {
-    return ConvertAndFormatType(value.c_str(), fragment, output);
+    return ConvertAndFormatType(StringSlice(value), fragment, output);
 }
 
 
@@ -2391,6 +5456,136 @@ bool ConvertAndFormatType(const char* value, FormatFragment& fragment, std::ostr
 }
 
 
+/**
+ * Converts the string slice to a different type specified by the format string, see the const char* version of
+ * ConvertAndFormatType.
+ *
+ * Without a conversion the characters are formatted directly from @p value.  The conversions i and d read the value
+ * with strtoll and strtold, which require a null terminated string, so only these take a copy of the slice.
+ *
+ * @param[in]  value  The value we wish to output.
+ * @param[in,out]  fragment  The format fragment holding the conversion and the format specifier to use.
+ * @param[out]  output  The output stream, to write the formatted output to.
+ *
+ * @return Returns true if the type was converted and formatted, otherwise false is returned, meaning formatting is
+ *         required elsewhere.
+ */
+bool ConvertAndFormatType(StringSlice value, FormatFragment& fragment, std::ostream& output)
+{
+    char* dummy;
+
+    switch (fragment.explicitConversion) {
+        case 'i':
+            FormatType(std::strtoll(std::string(value.data, value.size).c_str(), &dummy, 10),
+                       fragment.formatSpecifier, output);
+            break;
+
+        case 'd':
+            FormatType(std::strtold(std::string(value.data, value.size).c_str(), &dummy),
+                       fragment.formatSpecifier, output);
+            break;
+
+        default:
+            FormatType(value.data, value.size, fragment.formatSpecifier.c_str(), output);
+            break;
+    }
+
+    return true;
+}
+
+
+/**
+ * Lets a format fragment refer to a string argument, if the fragment writes the string as is, that is if it has no
+ * format specifier, no selectors and no conversion other than r and s.
+ *
+ * @param[in]  value  The string argument to refer to.
+ * @param[in,out]  fragment  The format fragment to set the reference of.
+ *
+ * @return Returns true if the fragment refers to @p value, otherwise false is returned.
+ */
+bool ReferenceStringArgument(StringSlice value, FormatFragment& fragment)
+{
+    if (!fragment.formatSpecifier.empty() || !fragment.selectors.empty()
+            || (fragment.explicitConversion != '\0' && fragment.explicitConversion != 's'
+                && fragment.explicitConversion != 'r')) {
+        return false;
+    }
+
+    fragment.reference = value.data;
+    fragment.referenceLength = value.size;
+    return true;
+}
+
+
+/**
+ * Lets a format fragment refer to a string argument, see the string slice version of ReferenceStringArgument.
+ */
+bool ReferenceStringArgument(const char* value, FormatFragment& fragment)
+{
+    return ReferenceStringArgument(StringSlice(value, std::strlen(value)), fragment);
+}
+
+
+/**
+ * Lets a format fragment refer to a string argument, see the string slice version of ReferenceStringArgument.
+ */
+bool ReferenceStringArgument(const std::string& value, FormatFragment& fragment)
+{
+    return ReferenceStringArgument(StringSlice(value), fragment);
+}
+
+
+void RunParallelTasks(std::size_t taskCount, unsigned threadCount, const std::function<void(std::size_t)>& task)
+{
+    if (threadCount == 0) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    if (static_cast<std::size_t>(threadCount) > taskCount) {
+        threadCount = static_cast<unsigned>(taskCount);
+    }
+
+    std::atomic<std::size_t> nextTask(0);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto worker = [&]() {
+        for (std::size_t index = nextTask++; index < taskCount; index = nextTask++) {
+            try {
+                task(index);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                // Skip the remaining tasks, the result is discarded anyway.
+                nextTask = taskCount;
+            }
+        }
+    };
+
+    // The calling thread is one of the threads of the pool.
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount > 0 ? threadCount - 1 : 0);
+    for (unsigned thread = 1; thread < threadCount; ++thread) {
+        try {
+            threads.emplace_back(worker);
+        }
+        catch (const std::system_error&) {
+            // Run the tasks on the threads already started, if no more threads can be created.
+            break;
+        }
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+
 /**
  * Parses the format string provided, splitting into segments of either format fragments or text fragments, the actual
  * result string is not fully constructed in this function.
@@ -2438,8 +5633,53 @@ void OutputFragments(const std::vector<FormatFragment>& fragments, std::ostream&
             throw std::out_of_range(exceptionMsg.str());
         }
 #endif  // FORMAT_DISABLE_THROW_OUT_OF_RANGE
-        ostr << fragment.text;
+        if (fragment.reference != nullptr) {
+            ostr.write(fragment.reference, static_cast<std::streamsize>(fragment.referenceLength));
+        }
+        else {
+            ostr << fragment.text;
+        }
+    }
+}
+
+
+/**
+ * Joins the formatted fragments into the resulting string, the size of the result is summed up first, so the string
+ * is allocated once and every fragment, including the referenced string arguments, is copied straight into it.  If
+ * the macro FORMAT_DISABLE_THROW_OUT_OF_RANGE is not set, an exception will be thrown if a format parameter was not
+ * handled.
+ *
+ * @param[in]  head  The text written before the first fragment.
+ * @param[in]  fragments  A vector of format fragments to join.
+ *
+ * @return Returns the formatted string.
+ */
+std::string JoinFragments(const std::string& head, const std::vector<FormatFragment>& fragments)
+{
+    std::size_t length = head.size();
+    for (const FormatFragment& fragment : fragments) {
+#ifndef FORMAT_DISABLE_THROW_OUT_OF_RANGE
+        if (!fragment.handled) {
+            std::stringstream exceptionMsg;
+            exceptionMsg << "Format parameter: " << fragment.index << " does not refer to a valid parameter.";
+            throw std::out_of_range(exceptionMsg.str());
+        }
+#endif  // FORMAT_DISABLE_THROW_OUT_OF_RANGE
+        length += fragment.reference != nullptr ? fragment.referenceLength : fragment.text.size();
+    }
+
+    std::string result;
+    result.reserve(length);
+    result += head;
+    for (const FormatFragment& fragment : fragments) {
+        if (fragment.reference != nullptr) {
+            result.append(fragment.reference, fragment.referenceLength);
+        }
+        else {
+            result += fragment.text;
+        }
     }
+    return result;
 }
 
 
@@ -2458,8 +5698,7 @@ std::string Format(const char* formatStr)
     std::stringstream ostr;
     std::vector<FormatFragment> fragments;
     ParseFormatStr(formatStr, ostr, fragments);
-    OutputFragments(fragments, ostr);
-    return ostr.str();
+    return JoinFragments(ostr.str(), fragments);
 }
 
 
@@ -29,9 +29,17 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 */
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 #include <list>
@@ -42,6 +50,41 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // its existence, while not enabling it.
 // #define FORMAT_DISABLE_THROW_OUT_OF_RANGE 1
 
+// The macro FORMAT_HAS_INT128 is defined when the compiler provides the 128-bit integer types __int128 and
+// unsigned __int128, in which case these can be formatted like any other integer.  Define FORMAT_DISABLE_INT128 to
+// leave out the 128-bit overloads, even if the compiler supports them.
+#if defined(__SIZEOF_INT128__) && !defined(FORMAT_DISABLE_INT128)
+#  define FORMAT_HAS_INT128 1
+#endif
+
+// The macro FORMAT_HAS_STRING_VIEW is defined when the code including this header is compiled as C++17 or later and
+// the standard library provides std::string_view, in which case string views can be formatted like any other string.
+// The string view overloads are defined inline, forwarding to the StringSlice overloads, so they are available even
+// when the library itself is compiled as an earlier standard.
+#if __cplusplus >= 201703L && defined(__has_include)
+#  if __has_include(<string_view>)
+#    include <string_view>
+#    define FORMAT_HAS_STRING_VIEW 1
+#  endif
+#endif
+
+// The macro FORMAT_ENABLE_DISPLAY_WIDTH will if defined make the width and precision of strings count the columns used
+// to display the characters in a terminal, rather than the number of characters, so wide East Asian characters and
+// emoji count as two columns and combining marks as none.  This line is intentionally commented out, to document its
+// existence, while not enabling it.
+// #define FORMAT_ENABLE_DISPLAY_WIDTH 1
+
+// The macro FORMAT_ELEMENT_LIMIT will if defined limit the number of elements formatted of every container to its
+// value, the remaining elements are summarized as "... (N more)", so a large container formatted by mistake cannot
+// stall the caller.  The macro must be defined when compiling the library.  This line is intentionally commented out,
+// to document its existence, while not enabling it.
+// #define FORMAT_ELEMENT_LIMIT 1000
+
+// The macro FORMAT_DISABLE_SIMD will if defined disable the use of SIMD instructions (SSE2) when converting numbers to
+// text, leaving only the portable implementation.  This line is intentionally commented out, to document its
+// existence, while not enabling it.
+// #define FORMAT_DISABLE_SIMD 1
+
 /**
  * The data to write before the first element of an array.
  */
@@ -105,6 +148,47 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #  define FORMAT_PAIR_SEP ": "
 #endif
 
+/**
+ * The data to write before the first element of a tuple.
+ */
+#ifndef FORMAT_TUPLE_OPEN
+#  define FORMAT_TUPLE_OPEN "("
+#endif
+
+/**
+ * The data to write after the last element of a tuple.
+ */
+#ifndef FORMAT_TUPLE_CLOSE
+#  define FORMAT_TUPLE_CLOSE ")"
+#endif
+
+/**
+ * The data to write between each element in a tuple.
+ */
+#ifndef FORMAT_TUPLE_SEP
+#  define FORMAT_TUPLE_SEP ", "
+#endif
+
+/**
+ * The largest number of elements of std::array and C arrays that are formatted by code unrolled at compile time,
+ * larger arrays are formatted by a loop, like other containers.
+ */
+#ifndef FORMAT_UNROLL_LIMIT
+#  define FORMAT_UNROLL_LIMIT 16
+#endif
+
+/**
+ * The size passed to AppendRange when the number of elements of a range is unknown.
+ */
+#define FORMAT_UNKNOWN_SIZE (static_cast<std::size_t>(-1))
+
+/**
+ * The number of elements formatted by every task when a container is formatted in parallel, see FormatTypeParallel.
+ */
+#ifndef FORMAT_PARALLEL_CHUNK_SIZE
+#  define FORMAT_PARALLEL_CHUNK_SIZE 16384
+#endif
+
 namespace utils {
 namespace str {
 
@@ -173,6 +257,50 @@ private:
 // Data container structs
 //
 
+/**
+ * A selector of a format parameter, see FormatFragment::selectors.  Selectors written as a decimal integer, such as
+ * the 3 in {0[3]}, are parsed while parsing the format string, so they can be used as indexes into random access
+ * containers without parsing them again for every argument.
+ */
+struct FormatSelector
+{
+    /**
+     * The selector as written in the format string, this is used as key for maps and as name of special functions.
+     */
+    std::string name;
+
+    /**
+     * Indicates whether the selector is written as a decimal integer, in which case @c index holds its value.
+     */
+    bool isIndex;
+
+    /**
+     * The value of the selector if @c isIndex is set, indexes too large for std::size_t are stored as the largest
+     * std::size_t value, which is out of range for any container.
+     */
+    std::size_t index;
+
+    /**
+     * Indicates whether the selector is a slice, such as [10:20] or [-5:], in which case @c sliceBegin and
+     * @c sliceEnd hold its bounds.
+     */
+    bool isSlice;
+
+    /**
+     * The first position of a slice, negative positions count from the end of the container, like in Python.  A
+     * missing first position is stored as 0.
+     */
+    std::ptrdiff_t sliceBegin;
+
+    /**
+     * The position after the last position of a slice, negative positions count from the end of the container.  A
+     * missing last position is stored as the largest std::ptrdiff_t value, which is past the end of any container.
+     */
+    std::ptrdiff_t sliceEnd;
+};
+
+struct ContainerDelimiters;
+
 /**
  * A format fragment describes an entry in the format string beginning with { and ending with }, or it describes a
  * string fragment.
@@ -199,7 +327,7 @@ struct FormatFragment
      * and if several selectors exist, they are executed in FIFO order, meaning that the first selector is used, and
      * afterwards the second selector is used on the result of the first, and so on.
      */
-    std::queue<std::string> selectors;
+    std::queue<FormatSelector> selectors;
 
     /**
      * The index this format fragment points to, if this is 0 or more it is the parameter index to use for this
@@ -216,6 +344,23 @@ struct FormatFragment
      */
     char explicitConversion;
 
+    /**
+     * A format parameter that writes a string argument as is, that is without a format specifier, selectors or a
+     * conversion other than r and s, is not copied to the text property.  Instead @c reference points to the
+     * characters of the argument, which are written straight to the final output, and @c referenceLength holds their
+     * number.  The reference is null for all other fragments.
+     */
+    const char* reference;
+    std::size_t referenceLength;
+
+    /**
+     * The element limit and delimiters of a container wrapped by Limit or Delimit, kept while selectors choose part of
+     * the container, so the chosen part is written the same way the whole container would be.  The delimiters are
+     * null for all other arguments, which are formatted with the default element limit and delimiters.
+     */
+    std::size_t elementLimit;
+    const ContainerDelimiters* delimiters;
+
 #ifndef FORMAT_DISABLE_THROW_OUT_OF_RANGE
     /**
      * Once a fragment is handled this boolean value will be set to true, if by the end of the processing there are
@@ -241,6 +386,8 @@ struct BasicFormatSpecifiers
      * The @c precision is a decimal number indicating how many digits should be displayed after the decimal point in
      * a floating point conversion. For non-numeric types the field indicates the maximum field size - in other words,
      * how many characters will be used from the field content. The precision is ignored for integer conversions.
+     * Strings are taken to be UTF-8 encoded, so both the precision and the width count code points rather than
+     * bytes, see also FORMAT_ENABLE_DISPLAY_WIDTH.
      */
     int precision;
 
@@ -301,9 +448,24 @@ struct BasicFormatSpecifiers
      * @arg @c 'G' General format. Same as 'g' except switches to 'E' if the number gets to large.
      * @arg @c 'n' Number. This is the same as 'g', except that it uses the current locale setting to insert the
      *             appropriate number separator characters.
+     * @arg @c 'a' Hexadecimal. Writes the exact binary value as a hexadecimal mantissa and a power of two, like C's
+     *             %a, for instance 0x1.8p+1 for 3.0. A precision rounds the mantissa to that many hexadecimal digits.
+     * @arg @c 'A' Hexadecimal. Same as 'a' except it converts the number to upper-case.
      * @arg @c '\%' Percentage. Multiplies the number by 100 and displays in fixed ('f') format, followed by a percent
      *             sign.
      * @arg @c ''  (None) - similar to 'g', except that it prints at least one digit after the decimal point.
+     *
+     * The available string presentation types are:
+     *
+     * @arg @c 'j' JSON. Writes the string as a JSON string, enclosed in double quotes, with quotes, backslashes and
+     *             control characters escaped.
+     * @arg @c 'q' CSV. Writes the string as a CSV field, it is enclosed in double quotes with any quotes doubled if
+     *             it contains a quote, a comma or a line break.
+     * @arg @c 'h' HTML. Writes the string as HTML text, with &, <, >, " and ' replaced by character references.
+     * @arg @c ''  (None) - writes the string as is.
+     *
+     * The precision of the escaping types applies to the string before it is escaped, and the width to the escaped
+     * result.
      */
     char type;
 
@@ -372,6 +534,26 @@ struct HasIterator
     static constexpr bool value = decltype(TestType<T>(nullptr))::value;
 };
 
+/**
+ * A compile time check, made to find out whether a specific type has a size function or not, containers without one,
+ * such as std::forward_list, must be walked to count their elements.
+ *
+ * @tparam T The type to test.
+ *
+ * @see HasIterator
+ */
+template <typename T>
+struct HasSize
+{
+    template <typename C>
+    static constexpr Answer<true> TestType(decltype(std::declval<const C&>().size())* x);
+
+    template <typename C>
+    static constexpr Answer<false> TestType(...);
+
+    static constexpr bool value = decltype(TestType<T>(nullptr))::value;
+};
+
 /**
  * A compile time check, made to find out whether a specific type has a child type called mapped_type or not.
  *
@@ -416,6 +598,121 @@ struct MapHasKeyType
 };
 
 
+/**
+ * A compile time check, made to find out whether a specific type is a map with string keys, that is keys that can be
+ * looked up by the key selectors of a format string.  This is the case for maps, ordered or unordered, with
+ * std::string keys and, when it is available, std::string_view keys.  Sets of strings are not maps, since they have no
+ * mapped_type.
+ *
+ * @tparam T The type to test.
+ *
+ * @see MapHasKeyType
+ */
+template <typename T>
+struct HasStringKey
+{
+#ifdef FORMAT_HAS_STRING_VIEW
+    static constexpr bool value = IsMapType<T>::value
+            && (MapHasKeyType<T, std::string>::value || MapHasKeyType<T, std::string_view>::value);
+#else
+    static constexpr bool value = IsMapType<T>::value && MapHasKeyType<T, std::string>::value;
+#endif  // FORMAT_HAS_STRING_VIEW
+};
+
+
+/**
+ * A compile time check, made to find out whether a specific type is a map with integer or enum keys, which can be
+ * looked up by the index selectors of a format string, such as {0[404]}.
+ *
+ * @tparam T The type to test.
+ *
+ * @see IsMapType
+ */
+template <typename T>
+struct HasIntegerKey
+{
+    template <typename C>
+    static constexpr Answer<std::is_integral<typename C::key_type>::value || std::is_enum<typename C::key_type>::value>
+    TestType(typename C::mapped_type* x);
+
+    template <typename C>
+    static constexpr Answer<false> TestType(C* x);
+
+    static constexpr bool value = decltype(TestType<T>(nullptr))::value;
+};
+
+
+/**
+ * The integer type holding the values of an integer or enum key type, for enums this is the underlying type.
+ *
+ * @tparam K The key type.
+ */
+template <typename K, bool IsEnum = std::is_enum<K>::value>
+struct KeyInteger
+{
+    typedef K type;
+};
+
+template <typename K>
+struct KeyInteger<K, true>
+{
+    typedef typename std::underlying_type<K>::type type;
+};
+
+
+/**
+ * A compile time check, made to find out whether a specific type is a random access container that can be indexed by
+ * the index selectors of a format string, such as std::vector, std::array and std::deque.  The type must have a
+ * random access const_iterator, strings are excluded, which is detected by their child type traits_type.
+ *
+ * @tparam T The type to test.
+ *
+ * @see HasIterator
+ */
+template <typename T>
+struct IsRandomAccessType
+{
+    template <typename C>
+    static constexpr Answer<std::is_same<typename std::iterator_traits<typename C::const_iterator>::iterator_category,
+                                         std::random_access_iterator_tag>::value> TestIterator(
+            typename C::const_iterator* x);
+
+    template <typename C>
+    static constexpr Answer<false> TestIterator(C* x);
+
+    template <typename C>
+    static constexpr Answer<true> TestTraits(typename C::traits_type* x);
+
+    template <typename C>
+    static constexpr Answer<false> TestTraits(C* x);
+
+    static constexpr bool value = decltype(TestIterator<T>(nullptr))::value && !decltype(TestTraits<T>(nullptr))::value;
+};
+
+
+/**
+ * A compile time check, made to find out whether a specific type is a container without random access, that is not a
+ * map, such as std::list, std::forward_list and std::set.  Slice selectors reach the elements of these containers by
+ * advancing their iterators.  Strings are excluded, which is detected by their child type traits_type.
+ *
+ * @tparam T The type to test.
+ *
+ * @see IsRandomAccessType
+ */
+template <typename T>
+struct IsListType
+{
+    template <typename C>
+    static constexpr Answer<true> TestTraits(typename C::traits_type* x);
+
+    template <typename C>
+    static constexpr Answer<false> TestTraits(C* x);
+
+    static constexpr bool value = HasIterator<T>::value && !IsMapType<T>::value && !IsRandomAccessType<T>::value
+                                  && !decltype(TestTraits<T>(nullptr))::value;
+};
+
+
 /**
  * A compile time check, made to find out whether a specific type has both child types: first_type and second_type or
  * not.
@@ -453,6 +750,60 @@ struct IsPairType
     static constexpr bool value = decltype(TestFirstType<T>(nullptr))::value && decltype(TestSecondType<T>(nullptr))::value;
 };
 
+
+/**
+ * A compile time check, made to find out whether a specific type is a character type, arrays of which are strings
+ * rather than arrays to format element by element.
+ *
+ * @tparam T The type to test.
+ */
+template <typename T>
+struct IsCharType
+{
+    typedef typename std::remove_cv<T>::type Type;
+    static constexpr bool value = std::is_same<Type, char>::value || std::is_same<Type, signed char>::value
+                                  || std::is_same<Type, unsigned char>::value || std::is_same<Type, wchar_t>::value
+                                  || std::is_same<Type, char16_t>::value || std::is_same<Type, char32_t>::value;
+};
+
+
+/**
+ * A compile time check, made to find out whether a specific type is a std::tuple or not, tuples are formatted element
+ * by element by code unrolled at compile time.
+ *
+ * @tparam T The type to test.
+ */
+template <typename T>
+struct IsTupleType
+{
+    static constexpr bool value = false;
+};
+
+template <typename... Types>
+struct IsTupleType<std::tuple<Types...>>
+{
+    static constexpr bool value = true;
+};
+
+
+/**
+ * A compile time check, made to find out whether a specific type is a std::array or not, arrays of a size known at
+ * compile time are formatted by code unrolled at compile time, see FORMAT_UNROLL_LIMIT.
+ *
+ * @tparam T The type to test.
+ */
+template <typename T>
+struct IsStdArray
+{
+    static constexpr bool value = false;
+};
+
+template <typename T, std::size_t N>
+struct IsStdArray<std::array<T, N>>
+{
+    static constexpr bool value = true;
+};
+
 }
 
 //
@@ -479,12 +830,25 @@ void ConvertToBasicFormatSpecifiers(const char* formatParameter, BasicFormatSpec
 // Built-in decimal type conversion
 //
 
+/**
+ * Formatting functions for the character types char, signed char and unsigned char, these will be called by the
+ * format function and can be called as is.  Characters are formatted as the integer value of the character, exactly
+ * like an int holding the same value.
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(char value, const char* formatSpecifier, std::ostream& output);
+void FormatType(signed char value, const char* formatSpecifier, std::ostream& output);
+void FormatType(unsigned char value, const char* formatSpecifier, std::ostream& output);
+
 /**
  * Formatting function for the primitive type short, this will be called by the format function and can be called as
  * is to format an integer from a specific format specifier.
  *
- * To the formatter all numbers of the type: int, long, and int64 are treated equally, thus this function converts
- * @p value to an int64 and calls the corresponding FormatType function.
+ * All integer types are formatted natively, that is the digits are generated directly from @p value in its own width,
+ * without first converting it to a wider type.
  *
  * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
  * https://www.python.org/dev/peps/pep-3101/
@@ -495,13 +859,20 @@ void ConvertToBasicFormatSpecifiers(const char* formatParameter, BasicFormatSpec
  */
 void FormatType(short value, const char* formatSpecifier, std::ostream& output);
 
+/**
+ * Formatting function for the primitive type unsigned short, this will be called by the format function and can be
+ * called as is to format an integer from a specific format specifier.
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(unsigned short value, const char* formatSpecifier, std::ostream& output);
+
 /**
  * Formatting function for the primitive type int, this will be called by the format function and can be called as is
  * to format an integer from a specific format specifier.
  *
- * To the formatter all numbers of the type: int, long, and int64 are treated equally, thus this function converts
- * @p value to an int64 and calls the corresponding FormatType function.
- *
  * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
  * https://www.python.org/dev/peps/pep-3101/
  *
@@ -511,12 +882,43 @@ void FormatType(short value, const char* formatSpecifier, std::ostream& output);
  */
 void FormatType(int value, const char* formatSpecifier, std::ostream& output);
 
+/**
+ * Formatting function for the primitive type unsigned int, this will be called by the format function and can be
+ * called as is to format an integer from a specific format specifier.
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(unsigned int value, const char* formatSpecifier, std::ostream& output);
+
 /**
  * Formatting function for the primitive type long, this will be called by the format function and can be called as is
  * to format an integer from a specific format specifier.
  *
- * To the formatter all numbers of the type: int, long, and int64 are treated equally, thus the corresponding format
- * functions converts their respective @p value to an int64 and calls this function.
+ * Having an overload for long, and not only for long long, avoids ambiguous calls for types like int64_t and ssize_t,
+ * which are typedefs of long on most 64-bit platforms.
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(long value, const char* formatSpecifier, std::ostream& output);
+
+/**
+ * Formatting function for the primitive type unsigned long, this will be called by the format function and can be
+ * called as is to format an integer from a specific format specifier.  This is the overload used for size_t and
+ * uint64_t on most 64-bit platforms.
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(unsigned long value, const char* formatSpecifier, std::ostream& output);
+
+/**
+ * Formatting function for the primitive type long long, this will be called by the format function and can be called
+ * as is to format an integer from a specific format specifier.
  *
  * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
  * https://www.python.org/dev/peps/pep-3101/
@@ -527,12 +929,46 @@ void FormatType(int value, const char* formatSpecifier, std::ostream& output);
  */
 void FormatType(long long value, const char* formatSpecifier, std::ostream& output);
 
+/**
+ * Formatting function for the primitive type unsigned long long, this will be called by the format function and can
+ * be called as is to format an integer from a specific format specifier.  Values above the maximum value of a long
+ * long are formatted correctly, since the value is never converted to a signed type.
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(unsigned long long value, const char* formatSpecifier, std::ostream& output);
+
+#ifdef FORMAT_HAS_INT128
+/**
+ * Formatting function for the 128-bit integer type __int128, this is only available if the compiler supports 128-bit
+ * integers (see FORMAT_HAS_INT128).
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(__int128 value, const char* formatSpecifier, std::ostream& output);
+
+/**
+ * Formatting function for the 128-bit integer type unsigned __int128, this is only available if the compiler supports
+ * 128-bit integers (see FORMAT_HAS_INT128).
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(unsigned __int128 value, const char* formatSpecifier, std::ostream& output);
+#endif  // FORMAT_HAS_INT128
+
 /**
  * Formatting function for the primitive type float, this will be called by the format function and can be called as
  * is to format an integer from a specific format specifier.
  *
- * To the formatter all numbers of the type: float, double and long double are treated equally, thus this function
- * converts @p value to a long double and calls the corresponding FormatType function.
+ * The value is converted in its own precision, it is never widened to a long double.  Without a precision, no
+ * presentation type and the types 'g', 'G' and 'n' write the value in its shortest form, using the fewest digits that
+ * read back as the same float, like Python does.  All other cases round the exact value of @p value half to even.
  *
  * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
  * https://www.python.org/dev/peps/pep-3101/
@@ -547,8 +983,9 @@ void FormatType(float value, const char* formatSpecifier, std::ostream& output);
  * Formatting function for the primitive type double, this will be called by the format function and can be called as
  * is to format an integer from a specific format specifier.
  *
- * To the formatter all numbers of the type: float, double and long double are treated equally, thus this function
- * converts @p value to a long double and calls the corresponding FormatType function.
+ * The value is converted in its own precision, it is never widened to a long double.  Without a precision, no
+ * presentation type and the types 'g', 'G' and 'n' write the value in its shortest form, using the fewest digits that
+ * read back as the same double, like Python does.  All other cases round the exact value of @p value half to even.
  *
  * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
  * https://www.python.org/dev/peps/pep-3101/
@@ -564,8 +1001,8 @@ void FormatType(double value, const char* formatSpecifier, std::ostream& output)
  * Formatting function for the primitive type double, this will be called by the format function and can be called as
  * is to format an integer from a specific format specifier.
  *
- * To the formatter all numbers of the type: float, double and long double are treated equally, thus the corresponding
- * format functions converts their respective @p value to a long double and calls this function.
+ * Unlike the float and double formatting functions, a long double is written by a stream, except for the hexadecimal
+ * presentation types 'a' and 'A'.
  *
  * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
  * https://www.python.org/dev/peps/pep-3101/
@@ -583,63 +1020,776 @@ void FormatType(bool value, const char* formatSpecifier, std::ostream& output);
 void FormatType(const char* value, const char* formatSpecifier, std::ostream& output);
 void FormatType(const std::string& value, const char* formatSpecifier, std::ostream& output);
 
-//
-// Prototypes
-//
+/**
+ * A non-owning reference to a sequence of characters, given by a pointer and a length, the characters does not need
+ * to be null terminated.
+ *
+ * This allows a part of a larger buffer to be passed to the format function as a string, without copying it into a
+ * std::string first.  The referenced characters must outlive the call to the format function.
+ */
+struct StringSlice
+{
+    StringSlice(const char* data, std::size_t size) : data(data), size(size) {}
+    StringSlice(const std::string& value) : data(value.data()), size(value.size()) {}
+#ifdef FORMAT_HAS_STRING_VIEW
+    StringSlice(std::string_view value) : data(value.data()), size(value.size()) {}
+#endif  // FORMAT_HAS_STRING_VIEW
+
+    const char* data;
+    std::size_t size;
+};
 
-template <typename T>
-typename std::enable_if<helper::HasIterator<T>::value && !helper::IsMapType<T>::value, void>::type
-FormatType(const T& container, const char* formatSpecifier, std::ostream& output);
+/**
+ * Formatting function for a string given by a pointer and a length, the string is written from the referenced
+ * characters directly, it is neither copied nor scanned for a null terminator.
+ *
+ * The format of the format specifier string can be found in Python PEP-3101, where the format specifier is described
+ * https://www.python.org/dev/peps/pep-3101/
+ *
+ * @param value[in]  The value to format.
+ * @param length[in]  The number of characters in @p value.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(const char* value, std::size_t length, const char* formatSpecifier, std::ostream& output);
+
+/**
+ * Formatting function for a string slice, see the pointer and length version of FormatType above.
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+void FormatType(StringSlice value, const char* formatSpecifier, std::ostream& output);
+
+#ifdef FORMAT_HAS_STRING_VIEW
+/**
+ * Formatting function for std::string_view, see the pointer and length version of FormatType above.  This is only
+ * available when compiling as C++17 or later (see FORMAT_HAS_STRING_VIEW).
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+inline void FormatType(std::string_view value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatType(StringSlice(value), formatSpecifier, output);
+}
+#endif  // FORMAT_HAS_STRING_VIEW
+
+/**
+ * Formats a column of numbers using the same format specifier for every value, the values are written to @p output
+ * separated by @p separator.
+ *
+ * The format specifier is only parsed once for the whole column and all values are formatted into a single buffer,
+ * which is written to the output stream in one operation, making this considerably faster than calling FormatType
+ * for each value when formatting large amounts of numbers.  The result is identical to calling FormatType for each
+ * value, writing the separator in between.
+ *
+ * The function is available for all integer types as well as float, double and long double.  Characters and bool are
+ * written as numbers, like the int holding the same value.
+ *
+ * @param values[in]  Pointer to the first value to format.
+ * @param count[in]  The number of values to format.
+ * @param formatSpecifier[in]  The format specifier to use for every value.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ * @param separator[in]  The text to write between two values, by default a new line.
+ */
+template <typename T>
+void FormatColumn(const T* values, std::size_t count, const char* formatSpecifier, std::ostream& output,
+                  const char* separator = "\n");
+
+/**
+ * Formats a column of numbers stored in a contiguous container, such as std::vector or std::array, see the function
+ * FormatColumn above.
+ *
+ * @param values[in]  The container holding the values to format.
+ * @param formatSpecifier[in]  The format specifier to use for every value.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ * @param separator[in]  The text to write between two values, by default a new line.
+ */
+template <typename Container>
+void FormatColumn(const Container& values, const char* formatSpecifier, std::ostream& output,
+                  const char* separator = "\n")
+{
+    FormatColumn(values.data(), values.size(), formatSpecifier, output, separator);
+}
+
+/**
+ * The delimiters of one kind of container, written before the first element, between the elements and after the last
+ * element.
+ */
+struct FormatDelimiters
+{
+    std::string open;
+    std::string separator;
+    std::string close;
+};
+
+/**
+ * The delimiters used to format containers, maps, pairs and tuples.  The default delimiters are those of the macros
+ * FORMAT_ARRAY_OPEN, FORMAT_MAP_SEP and so on, see GetDefaultDelimiters.  Other delimiters are chosen for a single
+ * argument by Delimit, such as the delimiters of CSV, JSON or space separated output.
+ */
+struct ContainerDelimiters
+{
+    ContainerDelimiters()
+        : array{FORMAT_ARRAY_OPEN, FORMAT_ARRAY_SEP, FORMAT_ARRAY_CLOSE},
+          map{FORMAT_MAP_OPEN, FORMAT_MAP_SEP, FORMAT_MAP_CLOSE},
+          pair{FORMAT_PAIR_OPEN, FORMAT_PAIR_SEP, FORMAT_PAIR_CLOSE},
+          tuple{FORMAT_TUPLE_OPEN, FORMAT_TUPLE_SEP, FORMAT_TUPLE_CLOSE} {}
+    ContainerDelimiters(const FormatDelimiters& array, const FormatDelimiters& map, const FormatDelimiters& pair,
+                        const FormatDelimiters& tuple)
+        : array(array), map(map), pair(pair), tuple(tuple) {}
+
+    FormatDelimiters array;
+    FormatDelimiters map;
+    FormatDelimiters pair;
+    FormatDelimiters tuple;
+};
+
+/**
+ * Returns the default element limit, FORMAT_ELEMENT_LIMIT if the library is compiled with it, or unlimited otherwise.
+ */
+std::size_t GetDefaultElementLimit();
+
+/**
+ * Returns the default delimiters, those of the macros FORMAT_ARRAY_OPEN, FORMAT_MAP_SEP and so on.
+ */
+const ContainerDelimiters& GetDefaultDelimiters();
+
+/**
+ * Returns the delimiters of comma separated values, the elements of arrays, tuples and maps are separated by commas
+ * without any enclosing brackets, and the key and value of a pair are separated by a comma as well.
+ */
+const ContainerDelimiters& GetCsvDelimiters();
+
+/**
+ * Returns the delimiters of JSON, arrays and tuples are written as JSON arrays and maps as JSON objects.  Combine with
+ * the presentation type 'j' to write strings as JSON strings.
+ */
+const ContainerDelimiters& GetJsonDelimiters();
+
+/**
+ * Returns the delimiters of space separated values, elements are separated by a single space without any enclosing
+ * brackets, and the key and value of a pair are separated by =.
+ */
+const ContainerDelimiters& GetSpaceDelimiters();
+
+/**
+ * A format specifier parsed once and used for many values, such as the elements of a container.  The parsed form is
+ * used by the types supported by the library, while @c text holds the format specifier as written, which is passed on
+ * to the FormatType functions of other types.  The text is not copied, it must outlive the parsed format specifier.
+ *
+ * The format specifier of a container may be split by a colon into a container level and an element level, such as
+ * >40:.2f, where the container is aligned to the right in 40 characters and every element is formatted by .2f.  The
+ * element level may be split again for the elements of nested containers, such as >60:j:.2f for a vector of maps.
+ * The container level is written as [[fill]align][width][.limit][type], where the limit is the largest number of
+ * elements to format, and the type chooses the delimiters:
+ *
+ * @arg @c 'c' Comma separated values, see GetCsvDelimiters.
+ * @arg @c 'j' JSON, see GetJsonDelimiters.
+ * @arg @c 's' Space separated values, see GetSpaceDelimiters.
+ * @arg @c 'n' The delimiters in use, without the opening and closing delimiter of the container itself.
+ *
+ * The limit and delimiters of a level apply to the levels below it as well, unless they choose their own.  Format
+ * specifiers without a colon are not split, they apply to the container and all of its elements, like they always
+ * have.  A leading colon followed by an alignment is a fill character rather than a split, so :>8 still pads every
+ * element with colons, which may also be written with an empty container level as ::>8.
+ */
+struct ParsedFormatSpecifier
+{
+    const char* text;
+    BasicFormatSpecifiers specifiers;
+
+    /**
+     * The container level of the format specifier, only width, alignment, fill and type are used.  The width is 0 if
+     * the format specifier is not split, or if the container level has no width.
+     */
+    BasicFormatSpecifiers containerSpecifiers;
+
+    /**
+     * The element level of a split format specifier, used for the elements of the container, or null if the format
+     * specifier is not split, in which case the elements are formatted by this format specifier as well.
+     */
+    std::shared_ptr<const ParsedFormatSpecifier> element;
+
+    /**
+     * The largest number of elements to format of every container, the remaining elements are summarized as
+     * "... (N more)".  This is FORMAT_ELEMENT_LIMIT if the library is compiled with it, or unlimited otherwise, see
+     * Limit to set it for a single argument.
+     */
+    std::size_t elementLimit;
+
+    /**
+     * The delimiters to write containers with, the default delimiters unless Delimit chooses others.  The delimiters
+     * are referenced, not copied.
+     */
+    const ContainerDelimiters* delimiters;
+};
+
+/**
+ * Parses a format specifier, for use by the AppendType functions.  All levels of a split format specifier are parsed
+ * at once, see ParsedFormatSpecifier.
+ *
+ * @param formatSpecifier[in]  The format specifier to parse.
+ * @param parsed[out]  The parsed format specifier.
+ */
+void ParseFormatSpecifier(const char* formatSpecifier, ParsedFormatSpecifier& parsed);
+
+/**
+ * Parses a format specifier with a given element limit and delimiters, which apply to all levels of the format
+ * specifier that do not choose their own, see Limit and Delimit.
+ *
+ * @param formatSpecifier[in]  The format specifier to parse.
+ * @param elementLimit[in]  The element limit to use.
+ * @param delimiters[in]  The delimiters to use.
+ * @param parsed[out]  The parsed format specifier.
+ */
+void ParseFormatSpecifier(const char* formatSpecifier, std::size_t elementLimit, const ContainerDelimiters& delimiters,
+                          ParsedFormatSpecifier& parsed);
+
+/**
+ * Aligns a container appended to @p sink from position @p start within the width of its container level, see
+ * ParsedFormatSpecifier.  The width is counted in characters, like the width of strings.
+ *
+ * @param formatSpecifier[in]  The format specifier of the container.
+ * @param start[in]  The position in @p sink where the container starts.
+ * @param sink[in,out]  The string holding the container.
+ */
+void AlignContainer(const ParsedFormatSpecifier& formatSpecifier, std::size_t start, std::string& sink);
+
+/**
+ * Returns the format specifier to format the elements of a container by, the element level of a split format
+ * specifier, or the format specifier itself.
+ */
+inline const ParsedFormatSpecifier& GetElementSpecifier(const ParsedFormatSpecifier& formatSpecifier)
+{
+    return formatSpecifier.element ? *formatSpecifier.element : formatSpecifier;
+}
+
+/**
+ * Appends the opening delimiter of a container, unless its container level leaves it out.
+ */
+inline void AppendOpen(const FormatDelimiters& delimiters, const ParsedFormatSpecifier& formatSpecifier,
+                       std::string& sink)
+{
+    if (formatSpecifier.containerSpecifiers.type != 'n') {
+        sink += delimiters.open;
+    }
+}
+
+/**
+ * Appends the closing delimiter of a container, unless its container level leaves it out, and aligns the container
+ * appended from position @p start.
+ */
+inline void AppendClose(const FormatDelimiters& delimiters, const ParsedFormatSpecifier& formatSpecifier,
+                        std::size_t start, std::string& sink)
+{
+    if (formatSpecifier.containerSpecifiers.type != 'n') {
+        sink += delimiters.close;
+    }
+    if (formatSpecifier.containerSpecifiers.width > 0) {
+        AlignContainer(formatSpecifier, start, sink);
+    }
+}
+
+/**
+ * Appends a value formatted by an already parsed format specifier to a string, these are the functions used to
+ * format the elements of containers.  The result is the same as the result of the FormatType function of the type,
+ * but the format specifier is not parsed again and no stream is involved.
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The parsed format specifier to use.
+ * @param sink[out]  The string to append the formatted value to.
+ */
+void AppendType(char value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+void AppendType(signed char value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+void AppendType(unsigned char value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+void AppendType(short value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+void AppendType(unsigned short value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+void AppendType(int value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+void AppendType(unsigned int value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+void AppendType(long value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+void AppendType(unsigned long value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+void AppendType(long long value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+void AppendType(unsigned long long value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+#ifdef FORMAT_HAS_INT128
+void AppendType(__int128 value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+void AppendType(unsigned __int128 value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+#endif  // FORMAT_HAS_INT128
+void AppendType(float value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+void AppendType(double value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+void AppendType(long double value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+void AppendType(bool value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+void AppendType(const char* value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+void AppendType(const std::string& value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+void AppendType(StringSlice value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+#ifdef FORMAT_HAS_STRING_VIEW
+inline void AppendType(std::string_view value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendType(StringSlice(value), formatSpecifier, sink);
+}
+#endif  // FORMAT_HAS_STRING_VIEW
+
+//
+// Prototypes
+//
+
+template <typename T>
+typename std::enable_if<!helper::HasIterator<T>::value && !helper::IsPairType<T>::value
+                        && !helper::IsTupleType<T>::value && !std::is_array<T>::value, void>::type
+AppendType(const T& value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+
+/**
+ * Appends the summary of the elements of a container left out by the element limit, such as ", ... (42 more)".
+ *
+ * @param remaining[in]  The number of elements left out.
+ * @param separator[in]  The separator to write before the summary, an empty string if no elements are written.
+ * @param sink[out]  The string to append the summary to.
+ */
+void AppendElision(std::size_t remaining, const char* separator, std::string& sink);
+
+template <typename Iterator>
+void AppendRange(Iterator first, Iterator last, std::size_t size, const FormatDelimiters& delimiters,
+                 const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+
+template <typename T>
+typename std::enable_if<helper::HasIterator<T>::value && !helper::IsMapType<T>::value
+                        && !helper::IsStdArray<T>::value, void>::type
+AppendType(const T& container, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
 
 template <typename T>
 typename std::enable_if<helper::HasIterator<T>::value && helper::IsMapType<T>::value, void>::type
-FormatType(const T& container, const char* formatSpecifier, std::ostream& output);
+AppendType(const T& container, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
 
 template <typename T>
 typename std::enable_if<helper::IsPairType<T>::value, void>::type
-FormatType(const T& p, const char* formatSpecifier, std::ostream& output);
+AppendType(const T& p, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+
+template <typename... Types>
+void AppendType(const std::tuple<Types...>& tuple, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+
+template <typename T, std::size_t N>
+void AppendType(const std::array<T, N>& array, const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
+
+template <typename T, std::size_t N>
+typename std::enable_if<!helper::IsCharType<T>::value, void>::type
+AppendType(const T (&array)[N], const ParsedFormatSpecifier& formatSpecifier, std::string& sink);
 
 template <typename T>
-typename std::enable_if<helper::HasIterator<T>::value && !helper::IsMapType<T>::value, void>::type
-FormatType(const T& container, const char* formatSpecifier, std::ostream& output)
+typename std::enable_if<helper::HasIterator<T>::value || helper::IsPairType<T>::value
+                        || helper::IsTupleType<T>::value, void>::type
+FormatType(const T& container, const char* formatSpecifier, std::ostream& output);
+
+template <typename T, std::size_t N>
+typename std::enable_if<!helper::IsCharType<T>::value, void>::type
+FormatType(const T (&array)[N], const char* formatSpecifier, std::ostream& output);
+
+/**
+ * Formatting function for enums, including scoped enums, the value is formatted as its underlying integer.  To format
+ * an enum differently, declare a FormatType function for the enum type, which is preferred over this template.
+ *
+ * @param value[in]  The value to format.
+ * @param formatSpecifier[in]  The format specifier to use.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+template <typename T>
+typename std::enable_if<std::is_enum<T>::value, void>::type
+FormatType(const T& value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatType(static_cast<typename std::underlying_type<T>::type>(value), formatSpecifier, output);
+}
+
+/**
+ * Appends a value of a type that is not supported by the library itself, the value is formatted by the FormatType
+ * function of its type, using the format specifier as written.
+ */
+template <typename T>
+typename std::enable_if<!helper::HasIterator<T>::value && !helper::IsPairType<T>::value
+                        && !helper::IsTupleType<T>::value && !std::is_array<T>::value, void>::type
+AppendType(const T& value, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    std::stringstream buffer;
+    FormatType(value, formatSpecifier.text, buffer);
+    sink += buffer.str();
+}
+
+/**
+ * Appends the elements from @p first up to, but not including, @p last, enclosed and separated by @p delimiters.
+ * Containers are appended as their full range, and slices as part of it.
+ *
+ * At most the element limit of the format specifier is appended, iteration stops at the limit and the elements left
+ * out are summarized.  Their number is taken from @p size, which is the number of elements in the range, or
+ * FORMAT_UNKNOWN_SIZE if the range must be walked to count them.
+ */
+template <typename Iterator>
+void AppendRange(Iterator first, Iterator last, std::size_t size, const FormatDelimiters& delimiters,
+                 const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
 {
-    bool first = true;
-    output << FORMAT_ARRAY_OPEN;
-    for (const auto& elem : container) {
-        if (!first) {
-            output << FORMAT_ARRAY_SEP;
+    const std::size_t start = sink.size();
+    const ParsedFormatSpecifier& elementSpecifier = GetElementSpecifier(formatSpecifier);
+    AppendOpen(delimiters, formatSpecifier, sink);
+    std::size_t count = 0;
+    Iterator it = first;
+    for (; it != last && count < formatSpecifier.elementLimit; ++it, ++count) {
+        if (count != 0) {
+            sink += delimiters.separator;
         }
-        FormatType(elem, formatSpecifier, output);
-        first = false;
+        AppendType(*it, elementSpecifier, sink);
     }
-    output << FORMAT_ARRAY_CLOSE;
+    if (it != last) {
+        const std::size_t remaining = size != FORMAT_UNKNOWN_SIZE ? size - count
+                                                                  : static_cast<std::size_t>(std::distance(it, last));
+        AppendElision(remaining, count != 0 ? delimiters.separator.c_str() : "", sink);
+    }
+    AppendClose(delimiters, formatSpecifier, start, sink);
+}
+
+/**
+ * Returns the number of elements of a container that has a size function, or FORMAT_UNKNOWN_SIZE if it has none,
+ * such as std::forward_list.
+ */
+template <typename T>
+typename std::enable_if<helper::HasSize<T>::value, std::size_t>::type
+GetContainerSize(const T& container)
+{
+    return static_cast<std::size_t>(container.size());
+}
+
+template <typename T>
+typename std::enable_if<!helper::HasSize<T>::value, std::size_t>::type
+GetContainerSize(const T&)
+{
+    return FORMAT_UNKNOWN_SIZE;
+}
+
+template <typename T>
+typename std::enable_if<helper::HasIterator<T>::value && !helper::IsMapType<T>::value
+                        && !helper::IsStdArray<T>::value, void>::type
+AppendType(const T& container, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendRange(container.begin(), container.end(), GetContainerSize(container), formatSpecifier.delimiters->array,
+                formatSpecifier, sink);
 }
 
 template <typename T>
 typename std::enable_if<helper::HasIterator<T>::value && helper::IsMapType<T>::value, void>::type
+AppendType(const T& container, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendRange(container.begin(), container.end(), GetContainerSize(container), formatSpecifier.delimiters->map,
+                formatSpecifier, sink);
+}
+
+template <typename T>
+typename std::enable_if<helper::IsPairType<T>::value, void>::type
+AppendType(const T& p, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    const FormatDelimiters& delimiters = formatSpecifier.delimiters->pair;
+    sink += delimiters.open;
+    AppendType(p.first, formatSpecifier, sink);
+    sink += delimiters.separator;
+    AppendType(p.second, formatSpecifier, sink);
+    sink += delimiters.close;
+}
+
+/**
+ * Returns the element at @p Index of a tuple, a std::array or a C array, the index is resolved at compile time.
+ */
+template <std::size_t Index, typename Tuple>
+auto GetElement(const Tuple& tuple) -> decltype(std::get<Index>(tuple))
+{
+    return std::get<Index>(tuple);
+}
+
+template <std::size_t Index, typename T, std::size_t N>
+const T& GetElement(const T (&array)[N])
+{
+    return array[Index];
+}
+
+/**
+ * Appends the elements of a tuple, a std::array or a C array from @p Index and on, separated by @p separator.  Every
+ * element is appended by a call of its own, resolved at compile time, so there is neither a loop nor any dispatch on
+ * the type of the elements at runtime.
+ */
+template <std::size_t Index, std::size_t Size>
+struct UnrolledAppender
+{
+    template <typename Tuple>
+    static void Append(const Tuple& tuple, const std::string& separator,
+                       const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+    {
+        if (Index != 0) {
+            sink += separator;
+        }
+        AppendType(GetElement<Index>(tuple), formatSpecifier, sink);
+        UnrolledAppender<Index + 1, Size>::Append(tuple, separator, formatSpecifier, sink);
+    }
+};
+
+template <std::size_t Size>
+struct UnrolledAppender<Size, Size>
+{
+    template <typename Tuple>
+    static void Append(const Tuple&, const std::string&, const ParsedFormatSpecifier&, std::string&)
+    {
+    }
+};
+
+template <typename... Types>
+void AppendType(const std::tuple<Types...>& tuple, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    const FormatDelimiters& delimiters = formatSpecifier.delimiters->tuple;
+    const std::size_t start = sink.size();
+    AppendOpen(delimiters, formatSpecifier, sink);
+    UnrolledAppender<0, sizeof...(Types)>::Append(tuple, delimiters.separator, GetElementSpecifier(formatSpecifier),
+                                                  sink);
+    AppendClose(delimiters, formatSpecifier, start, sink);
+}
+
+/**
+ * Appends an array of a size known at compile time, arrays of up to FORMAT_UNROLL_LIMIT elements are appended by
+ * unrolled code, larger arrays and arrays cut short by the element limit are appended by a loop.
+ */
+template <std::size_t N, typename Array>
+void AppendArray(const Array& array, std::false_type, const ParsedFormatSpecifier& formatSpecifier,
+                 std::string& sink)
+{
+    AppendRange(std::begin(array), std::end(array), N, formatSpecifier.delimiters->array, formatSpecifier, sink);
+}
+
+template <std::size_t N, typename Array>
+void AppendArray(const Array& array, std::true_type, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    if (N > formatSpecifier.elementLimit) {
+        AppendArray<N>(array, std::false_type(), formatSpecifier, sink);
+        return;
+    }
+    const FormatDelimiters& delimiters = formatSpecifier.delimiters->array;
+    const std::size_t start = sink.size();
+    AppendOpen(delimiters, formatSpecifier, sink);
+    UnrolledAppender<0, N>::Append(array, delimiters.separator, GetElementSpecifier(formatSpecifier), sink);
+    AppendClose(delimiters, formatSpecifier, start, sink);
+}
+
+template <typename T, std::size_t N>
+void AppendType(const std::array<T, N>& array, const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendArray<N>(array, std::integral_constant<bool, N <= FORMAT_UNROLL_LIMIT>(), formatSpecifier, sink);
+}
+
+template <typename T, std::size_t N>
+typename std::enable_if<!helper::IsCharType<T>::value, void>::type
+AppendType(const T (&array)[N], const ParsedFormatSpecifier& formatSpecifier, std::string& sink)
+{
+    AppendArray<N>(array, std::integral_constant<bool, N <= FORMAT_UNROLL_LIMIT>(), formatSpecifier, sink);
+}
+
+/**
+ * Formatting function for containers, maps, pairs and tuples.  The format specifier is parsed once and applied to
+ * every element, and the whole container is formatted into a single buffer, which is written to @p output in one
+ * operation.
+ *
+ * @param container[in]  The container to format.
+ * @param formatSpecifier[in]  The format specifier to use for every element.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+template <typename T>
+typename std::enable_if<helper::HasIterator<T>::value || helper::IsPairType<T>::value
+                        || helper::IsTupleType<T>::value, void>::type
 FormatType(const T& container, const char* formatSpecifier, std::ostream& output)
 {
-    bool first = true;
-    output << FORMAT_MAP_OPEN;
-    for (const auto& elem : container) {
-        if (!first) {
-            output << FORMAT_MAP_SEP;
+    ParsedFormatSpecifier parsed;
+    ParseFormatSpecifier(formatSpecifier, parsed);
+    std::string buffer;
+    AppendType(container, parsed, buffer);
+    output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
+
+/**
+ * Formatting function for C arrays, other than arrays of characters, which are strings.  The array is formatted like
+ * a std::array of the same size.
+ *
+ * @param array[in]  The array to format.
+ * @param formatSpecifier[in]  The format specifier to use for every element.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ */
+template <typename T, std::size_t N>
+typename std::enable_if<!helper::IsCharType<T>::value, void>::type
+FormatType(const T (&array)[N], const char* formatSpecifier, std::ostream& output)
+{
+    ParsedFormatSpecifier parsed;
+    ParseFormatSpecifier(formatSpecifier, parsed);
+    std::string buffer;
+    AppendType(array, parsed, buffer);
+    output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
+
+/**
+ * Runs @p taskCount tasks on a pool of @p threadCount threads, every thread takes the next task not yet run until all
+ * tasks are done.  If any task throws an exception, the first exception thrown is rethrown when all threads are done.
+ *
+ * @param[in]  taskCount  The number of tasks to run, each task is called with its index from 0 to taskCount - 1.
+ * @param[in]  threadCount  The number of threads to use, 0 uses one thread for every processor core.
+ * @param[in]  task  The task to run.
+ */
+void RunParallelTasks(std::size_t taskCount, unsigned threadCount, const std::function<void(std::size_t)>& task);
+
+/**
+ * Formats a random access container in parallel, with the same output as FormatType.  The container is split into
+ * chunks of FORMAT_PARALLEL_CHUNK_SIZE elements, which are formatted into a buffer each by a pool of threads, and the
+ * buffers are written to @p output in order.  Containers of a single chunk, and containers cut short by the element
+ * limit or aligned by their container level, are formatted by the calling thread alone.
+ *
+ * This is opt-in, since it only pays off for very large containers, and the elements must be safe to format from
+ * several threads at once.
+ *
+ * @param container[in]  The container to format.
+ * @param formatSpecifier[in]  The format specifier to use for every element.
+ * @param output[out]  A reference to an output stream to write the formatted result to.
+ * @param threadCount[in]  The number of threads to use, 0 uses one thread for every processor core.
+ */
+template <typename T>
+typename std::enable_if<helper::IsRandomAccessType<T>::value, void>::type
+FormatTypeParallel(const T& container, const char* formatSpecifier, std::ostream& output, unsigned threadCount = 0)
+{
+    const std::size_t size = static_cast<std::size_t>(container.size());
+    const std::size_t chunkSize = FORMAT_PARALLEL_CHUNK_SIZE;
+    const std::size_t chunkCount = (size + chunkSize - 1) / chunkSize;
+    ParsedFormatSpecifier parsed;
+    ParseFormatSpecifier(formatSpecifier, parsed);
+    if (chunkCount <= 1 || threadCount == 1 || parsed.elementLimit < size || parsed.containerSpecifiers.width > 0) {
+        std::string buffer;
+        AppendType(container, parsed, buffer);
+        output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        return;
+    }
+
+    const ParsedFormatSpecifier& elementSpecifier = GetElementSpecifier(parsed);
+    std::vector<std::string> chunks(chunkCount);
+    RunParallelTasks(chunkCount, threadCount, [&](std::size_t chunk) {
+        const std::size_t first = chunk * chunkSize;
+        const std::size_t last = std::min(first + chunkSize, size);
+        std::string& sink = chunks[chunk];
+        for (std::size_t index = first; index < last; ++index) {
+            if (index != 0) {
+                sink += parsed.delimiters->array.separator;
+            }
+            AppendType(container[index], elementSpecifier, sink);
         }
-        FormatType(elem, formatSpecifier, output);
-        first = false;
+    });
+
+    std::string open;
+    AppendOpen(parsed.delimiters->array, parsed, open);
+    output << open;
+    for (const std::string& chunk : chunks) {
+        output.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
     }
-    output << FORMAT_MAP_CLOSE;
+    std::string close;
+    AppendClose(parsed.delimiters->array, parsed, 0, close);
+    output << close;
 }
 
+/**
+ * A reference to a random access container, which is formatted in parallel when passed to Format, see Parallel.
+ */
 template <typename T>
-typename std::enable_if<helper::IsPairType<T>::value, void>::type
-FormatType(const T& p, const char* formatSpecifier, std::ostream& output)
+struct ParallelContainer
+{
+    const T& container;
+    unsigned threadCount;
+};
+
+/**
+ * Marks a random access container to be formatted in parallel when passed to Format, such as:
+ * Format("{:.3f}", Parallel(latencies)).  The container is referenced, not copied.
+ *
+ * @param container[in]  The container to format.
+ * @param threadCount[in]  The number of threads to use, 0 uses one thread for every processor core.
+ *
+ * @see FormatTypeParallel
+ */
+template <typename T>
+ParallelContainer<T> Parallel(const T& container, unsigned threadCount = 0)
+{
+    return ParallelContainer<T>{container, threadCount};
+}
+
+template <typename T>
+void FormatType(const ParallelContainer<T>& value, const char* formatSpecifier, std::ostream& output)
+{
+    FormatTypeParallel(value.container, formatSpecifier, output, value.threadCount);
+}
+
+/**
+ * A reference to a container, which is formatted with an element limit when passed to Format, see Limit.
+ */
+template <typename T>
+struct LimitedContainer
+{
+    const T& container;
+    std::size_t elementLimit;
+};
+
+/**
+ * Limits the number of elements formatted of a container passed to Format, such as: Format("{}", Limit(queue, 10)),
+ * which formats the first 10 elements followed by a summary such as ", ... (999990 more)".  Only the elements
+ * formatted are visited, the number of elements left out is taken from the size of the container.  The limit applies
+ * to nested containers as well.  The container is referenced, not copied.
+ *
+ * @param container[in]  The container to format.
+ * @param elementLimit[in]  The largest number of elements to format.
+ */
+template <typename T>
+LimitedContainer<T> Limit(const T& container, std::size_t elementLimit)
+{
+    return LimitedContainer<T>{container, elementLimit};
+}
+
+template <typename T>
+void FormatType(const LimitedContainer<T>& value, const char* formatSpecifier, std::ostream& output)
 {
-    output << FORMAT_PAIR_OPEN;
-    FormatType(p.first, formatSpecifier, output);
-    output << FORMAT_PAIR_SEP;
-    FormatType(p.second, formatSpecifier, output);
-    output << FORMAT_PAIR_CLOSE;
+    ParsedFormatSpecifier parsed;
+    ParseFormatSpecifier(formatSpecifier, value.elementLimit, GetDefaultDelimiters(), parsed);
+    std::string buffer;
+    AppendType(value.container, parsed, buffer);
+    output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
+
+/**
+ * A reference to a container, which is formatted with other delimiters when passed to Format, see Delimit.
+ */
+template <typename T>
+struct DelimitedContainer
+{
+    const T& container;
+    const ContainerDelimiters& delimiters;
+};
+
+/**
+ * Chooses the delimiters of a container passed to Format, such as: Format("{}", Delimit(row, GetCsvDelimiters())),
+ * which writes the elements of row as comma separated values.  The delimiters apply to nested containers as well.
+ * Both the container and the delimiters are referenced, not copied, and the delimiters are written as is, without
+ * being looked up or built for every element.
+ *
+ * @param container[in]  The container to format.
+ * @param delimiters[in]  The delimiters to use.
+ */
+template <typename T>
+DelimitedContainer<T> Delimit(const T& container, const ContainerDelimiters& delimiters)
+{
+    return DelimitedContainer<T>{container, delimiters};
+}
+
+template <typename T>
+void FormatType(const DelimitedContainer<T>& value, const char* formatSpecifier, std::ostream& output)
+{
+    ParsedFormatSpecifier parsed;
+    ParseFormatSpecifier(formatSpecifier, GetDefaultElementLimit(), value.delimiters, parsed);
+    std::string buffer;
+    AppendType(value.container, parsed, buffer);
+    output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
 }
 
 template <typename T>
@@ -656,41 +1806,356 @@ std::string FormatType(T&& value, const char* formatSpecifier)
     return buffer.str();
 }
 
+bool ConvertAndFormatType(char value, FormatFragment& fragment, std::ostream& output);
+bool ConvertAndFormatType(signed char value, FormatFragment& fragment, std::ostream& output);
+bool ConvertAndFormatType(unsigned char value, FormatFragment& fragment, std::ostream& output);
 bool ConvertAndFormatType(short value, FormatFragment& fragment, std::ostream& output);
+bool ConvertAndFormatType(unsigned short value, FormatFragment& fragment, std::ostream& output);
 bool ConvertAndFormatType(int value, FormatFragment& fragment, std::ostream& output);
+bool ConvertAndFormatType(unsigned int value, FormatFragment& fragment, std::ostream& output);
+bool ConvertAndFormatType(long value, FormatFragment& fragment, std::ostream& output);
+bool ConvertAndFormatType(unsigned long value, FormatFragment& fragment, std::ostream& output);
 bool ConvertAndFormatType(long long value, FormatFragment& fragment, std::ostream& output);
+bool ConvertAndFormatType(unsigned long long value, FormatFragment& fragment, std::ostream& output);
+#ifdef FORMAT_HAS_INT128
+bool ConvertAndFormatType(__int128 value, FormatFragment& fragment, std::ostream& output);
+bool ConvertAndFormatType(unsigned __int128 value, FormatFragment& fragment, std::ostream& output);
+#endif  // FORMAT_HAS_INT128
 bool ConvertAndFormatType(float value, FormatFragment& fragment, std::ostream& output);
 bool ConvertAndFormatType(double value, FormatFragment& fragment, std::ostream& output);
 bool ConvertAndFormatType(long double value, FormatFragment& fragment, std::ostream& output);
 bool ConvertAndFormatType(bool value, FormatFragment& fragment, std::ostream& output);
 bool ConvertAndFormatType(const char* value, FormatFragment& fragment, std::ostream& output);
 bool ConvertAndFormatType(const std::string& value, FormatFragment& fragment, std::ostream& output);
+bool ConvertAndFormatType(StringSlice value, FormatFragment& fragment, std::ostream& output);
+#ifdef FORMAT_HAS_STRING_VIEW
+inline bool ConvertAndFormatType(std::string_view value, FormatFragment& fragment, std::ostream& output)
+{
+    return ConvertAndFormatType(StringSlice(value), fragment, output);
+}
+#endif  // FORMAT_HAS_STRING_VIEW
+
+/**
+ * Lets a format fragment refer to a string argument instead of holding a formatted copy of it, if the fragment writes
+ * the string as is, see FormatFragment::reference.  Arguments that are not strings are never referenced.
+ *
+ * @param[in]  value  The argument to refer to.
+ * @param[in,out]  fragment  The format fragment to set the reference of.
+ *
+ * @return Returns true if the fragment refers to @p value, otherwise false is returned, meaning the argument must be
+ *         formatted.
+ */
+template <typename T>
+bool ReferenceStringArgument(const T&, FormatFragment&)
+{
+    return false;
+}
+
+bool ReferenceStringArgument(const char* value, FormatFragment& fragment);
+bool ReferenceStringArgument(const std::string& value, FormatFragment& fragment);
+bool ReferenceStringArgument(StringSlice value, FormatFragment& fragment);
+#ifdef FORMAT_HAS_STRING_VIEW
+inline bool ReferenceStringArgument(std::string_view value, FormatFragment& fragment)
+{
+    return ReferenceStringArgument(StringSlice(value), fragment);
+}
+#endif  // FORMAT_HAS_STRING_VIEW
+
+/**
+ * Formats a value by the format specifier of a fragment, using the element limit and delimiters the fragment keeps
+ * for a container wrapped by Limit or Delimit, see FormatFragment::delimiters.
+ *
+ * @param[in]  value  The value to format.
+ * @param[in]  fragment  The format fragment, holding the format specifier.
+ * @param[out]  output  The output stream, to write the formatted output to.
+ */
+template <typename T>
+void FormatFragmentValue(const T& value, const FormatFragment& fragment, std::ostream& output)
+{
+    if (fragment.delimiters == nullptr) {
+        FormatType(value, fragment.formatSpecifier, output);
+        return;
+    }
+
+    ParsedFormatSpecifier parsed;
+    ParseFormatSpecifier(fragment.formatSpecifier.c_str(), fragment.elementLimit, *fragment.delimiters, parsed);
+    std::string buffer;
+    AppendType(value, parsed, buffer);
+    output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
+
+/**
+ * Formats the value chosen by a selector, applying the remaining selectors and the explicit conversion of the fragment
+ * to it if its type supports them.
+ *
+ * @param[in]  value  The selected value.
+ * @param[in,out]  fragment  The format fragment, holding the remaining selectors.
+ * @param[out]  output  The output stream, to write the formatted output to.
+ */
+template <typename T>
+void FormatSelectedValue(const T& value, FormatFragment& fragment, std::ostream& output)
+{
+    if (!ConvertAndFormatType(value, fragment, output)) {
+        FormatFragmentValue(value, fragment, output);
+    }
+}
+
+/**
+ * Advances @p it by up to @p count elements without passing @p last, in constant time for random access iterators.
+ */
+template <typename Iterator>
+void AdvanceBounded(Iterator& it, Iterator last, std::ptrdiff_t count, std::random_access_iterator_tag)
+{
+    it += std::min(count, static_cast<std::ptrdiff_t>(last - it));
+}
+
+template <typename Iterator>
+void AdvanceBounded(Iterator& it, Iterator last, std::ptrdiff_t count, std::input_iterator_tag)
+{
+    for (; count > 0 && it != last; --count) {
+        ++it;
+    }
+}
+
+/**
+ * Resolves a position of a slice against the size of its container, negative positions count from the end, and
+ * positions outside of the container are clamped to it, like in Python.
+ */
+inline std::ptrdiff_t ResolveSliceBound(std::ptrdiff_t bound, std::ptrdiff_t size)
+{
+    if (bound < 0) {
+        return bound + size < 0 ? 0 : bound + size;
+    }
+    return bound > size ? size : bound;
+}
+
+/**
+ * Applies a slice selector, such as {0[10:20]} or {0[-5:]}, formatting only the elements within the slice, in place,
+ * using the delimiters of the container.  The size of the container is only counted if a position is negative, and
+ * the elements after the slice are never visited.
+ *
+ * @param[in]  container  The container we wish to output a slice of.
+ * @param[in]  fragment  The format fragment, holding the slice selector first and the format specifier.
+ * @param[out]  output  The output stream, to write the formatted output to.
+ */
+template <typename T>
+void FormatSlice(const T& container, const FormatFragment& fragment, std::ostream& output)
+{
+    typedef typename T::const_iterator Iterator;
+    typedef typename std::iterator_traits<Iterator>::iterator_category Category;
+
+    const FormatSelector& selector = fragment.selectors.front();
+    std::ptrdiff_t first = selector.sliceBegin;
+    std::ptrdiff_t last = selector.sliceEnd;
+    if (first < 0 || last < 0) {
+        const std::ptrdiff_t size = std::distance(container.begin(), container.end());
+        first = ResolveSliceBound(first, size);
+        last = ResolveSliceBound(last, size);
+    }
+
+    Iterator begin = container.begin();
+    AdvanceBounded(begin, container.end(), first, Category());
+    Iterator end = begin;
+    if (last > first) {
+        AdvanceBounded(end, container.end(), last - first, Category());
+    }
+
+    ParsedFormatSpecifier parsed;
+    if (fragment.delimiters == nullptr) {
+        ParseFormatSpecifier(fragment.formatSpecifier.c_str(), parsed);
+    }
+    else {
+        ParseFormatSpecifier(fragment.formatSpecifier.c_str(), fragment.elementLimit, *fragment.delimiters, parsed);
+    }
+    std::string buffer;
+    const std::size_t size = std::is_same<Category, std::random_access_iterator_tag>::value
+                             ? static_cast<std::size_t>(std::distance(begin, end)) : FORMAT_UNKNOWN_SIZE;
+    const FormatDelimiters& delimiters = helper::IsMapType<T>::value ? parsed.delimiters->map
+                                                                     : parsed.delimiters->array;
+    AppendRange(begin, end, size, delimiters, parsed, buffer);
+    output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
+
+/**
+ * Looks up the key of a selector in a map with string keys, the selector is used as key as is, without copying it.
+ *
+ * @param[in]  map  The map to search.
+ * @param[in]  selector  The selector holding the key.
+ *
+ * @return Returns an iterator to the matching element, or the end of @p map if the key does not exist.
+ */
+template <typename T>
+typename std::enable_if<helper::HasStringKey<T>::value, typename T::const_iterator>::type
+FindSelectedKey(const T& map, const FormatSelector& selector)
+{
+    return map.find(selector.name);
+}
+
+/**
+ * Looks up the key of a selector in a map with integer or enum keys, using the index parsed from the selector with
+ * the format string.  Selectors that are not indexes, or that are out of range of the key type, match no element.
+ *
+ * @param[in]  map  The map to search.
+ * @param[in]  selector  The selector holding the key.
+ *
+ * @return Returns an iterator to the matching element, or the end of @p map if the key does not exist.
+ */
+template <typename T>
+typename std::enable_if<helper::HasIntegerKey<T>::value, typename T::const_iterator>::type
+FindSelectedKey(const T& map, const FormatSelector& selector)
+{
+    typedef typename helper::KeyInteger<typename T::key_type>::type Integer;
+    if (!selector.isIndex || static_cast<unsigned long long>(selector.index)
+                             > static_cast<unsigned long long>(std::numeric_limits<Integer>::max())) {
+        return map.end();
+    }
+    return map.find(static_cast<typename T::key_type>(static_cast<Integer>(selector.index)));
+}
 
+/**
+ * Applies a key selector to a map, such as {0[name]} or {0[404]}, formatting only the value of the key.  The key is
+ * looked up once with find, see FindSelectedKey.  If the key does not exist the selector is ignored and the whole map
+ * is formatted.  Slice selectors format the pairs within the slice, in the order of the map, see FormatSlice.
+ *
+ * @param[in]  value  The map we wish to output.
+ * @param[in,out]  fragment  The format fragment, holding the selectors.
+ * @param[out]  output  The output stream, to write the formatted output to.
+ *
+ * @return Returns true, since the value is always formatted.
+ */
 template <typename T>
-typename std::enable_if<helper::MapHasKeyType<T, std::string>::value, bool>::type
+typename std::enable_if<helper::HasStringKey<T>::value || helper::HasIntegerKey<T>::value, bool>::type
 ConvertAndFormatType(const T& value, FormatFragment& fragment, std::ostream& output)
 {
+    if (!fragment.selectors.empty() && fragment.selectors.front().isSlice) {
+        FormatSlice(value, fragment, output);
+        return true;
+    }
     if (!fragment.selectors.empty()) {
-        std::string selector = fragment.selectors.front();
+        typename T::const_iterator match = FindSelectedKey(value, fragment.selectors.front());
         fragment.selectors.pop();
 
-        if (value.count(selector) > 0) {
-            ConvertAndFormatType(value.at(selector), fragment, output);
+        if (match != value.end()) {
+            FormatSelectedValue(match->second, fragment, output);
             return true;
         }
     }
 
-    FormatType(value, fragment.formatSpecifier, output);
+    FormatFragmentValue(value, fragment, output);
     return true;
 }
 
+/**
+ * Applies an index selector to a random access container, such as {0[3]}, formatting only the element at the index.
+ * The index is parsed with the format string and the element is reached in constant time.  If the selector is not an
+ * index, or the index is out of range, the selector is ignored and the whole container is formatted, like a key that
+ * is missing from a map.  Slice selectors format the elements within the slice, see FormatSlice.
+ *
+ * @param[in]  value  The container we wish to output.
+ * @param[in,out]  fragment  The format fragment, holding the selectors.
+ * @param[out]  output  The output stream, to write the formatted output to.
+ *
+ * @return Returns true, since the value is always formatted.
+ */
 template <typename T>
-typename std::enable_if<!helper::MapHasKeyType<T, std::string>::value, bool>::type
+typename std::enable_if<helper::IsRandomAccessType<T>::value, bool>::type
+ConvertAndFormatType(const T& value, FormatFragment& fragment, std::ostream& output)
+{
+    if (!fragment.selectors.empty() && fragment.selectors.front().isSlice) {
+        FormatSlice(value, fragment, output);
+        return true;
+    }
+    if (!fragment.selectors.empty()) {
+        const bool isIndex = fragment.selectors.front().isIndex;
+        const std::size_t index = fragment.selectors.front().index;
+        fragment.selectors.pop();
+
+        if (isIndex && index < static_cast<std::size_t>(value.size())) {
+            FormatSelectedValue(value[index], fragment, output);
+            return true;
+        }
+    }
+
+    FormatFragmentValue(value, fragment, output);
+    return true;
+}
+
+/**
+ * Applies a slice selector to a container without random access, such as {0[-5:]} on a std::list, reaching the
+ * elements of the slice by advancing an iterator, see FormatSlice.  Other selectors are ignored and the whole
+ * container is formatted.
+ *
+ * @param[in]  value  The container we wish to output.
+ * @param[in,out]  fragment  The format fragment, holding the selectors.
+ * @param[out]  output  The output stream, to write the formatted output to.
+ *
+ * @return Returns true, since the value is always formatted.
+ */
+template <typename T>
+typename std::enable_if<helper::IsListType<T>::value, bool>::type
+ConvertAndFormatType(const T& value, FormatFragment& fragment, std::ostream& output)
+{
+    if (!fragment.selectors.empty() && fragment.selectors.front().isSlice) {
+        FormatSlice(value, fragment, output);
+        return true;
+    }
+
+    FormatFragmentValue(value, fragment, output);
+    return true;
+}
+
+template <typename T>
+typename std::enable_if<!helper::HasStringKey<T>::value && !helper::HasIntegerKey<T>::value
+                        && !helper::IsRandomAccessType<T>::value && !helper::IsListType<T>::value, bool>::type
 ConvertAndFormatType(const T&, FormatFragment&, std::ostream&)
 {
     return false;
 }
 
+/**
+ * Applies the selectors of a container wrapped by Parallel, Limit or Delimit to the container itself, such as
+ * {0[1:3]} on Delimit(row, GetCsvDelimiters()).  The element limit and delimiters of the wrapper are kept for the
+ * part of the container chosen, see FormatFragment::delimiters.  A container wrapped by Parallel is formatted by the
+ * calling thread once selectors apply to it.  Without selectors the wrapper is formatted by its FormatType function.
+ *
+ * @param[in]  value  The wrapped container we wish to output.
+ * @param[in,out]  fragment  The format fragment, holding the selectors.
+ * @param[out]  output  The output stream, to write the formatted output to.
+ *
+ * @return Returns true if the selectors were applied, otherwise false is returned.
+ */
+template <typename T>
+bool ConvertAndFormatType(const ParallelContainer<T>& value, FormatFragment& fragment, std::ostream& output)
+{
+    return !fragment.selectors.empty() && ConvertAndFormatType(value.container, fragment, output);
+}
+
+template <typename T>
+bool ConvertAndFormatType(const LimitedContainer<T>& value, FormatFragment& fragment, std::ostream& output)
+{
+    if (fragment.selectors.empty()) {
+        return false;
+    }
+    if (fragment.delimiters == nullptr) {
+        fragment.delimiters = &GetDefaultDelimiters();
+    }
+    fragment.elementLimit = value.elementLimit;
+    return ConvertAndFormatType(value.container, fragment, output);
+}
+
+template <typename T>
+bool ConvertAndFormatType(const DelimitedContainer<T>& value, FormatFragment& fragment, std::ostream& output)
+{
+    if (fragment.selectors.empty()) {
+        return false;
+    }
+    if (fragment.delimiters == nullptr) {
+        fragment.elementLimit = GetDefaultElementLimit();
+    }
+    fragment.delimiters = &value.delimiters;
+    return ConvertAndFormatType(value.container, fragment, output);
+}
+
 
 //
 // Parsing functions
@@ -710,24 +2175,40 @@ ConvertAndFormatType(const T&, FormatFragment&, std::ostream&)
  */
 void ParseFormatStr(const char* formatStr, std::ostream& ostr, std::vector<FormatFragment>& fragments);
 
+/**
+ * Formats an argument for one format fragment, storing the result in the fragment, or a reference to the argument if
+ * it is a string written as is.
+ *
+ * @param[in,out]  fragment  The format fragment to format the argument for.
+ * @param[in]  arg  The argument referred to by the fragment.
+ */
+template <typename T>
+void FormatArgument(FormatFragment& fragment, const T& arg)
+{
+    // Strings written as is are referenced and copied once, straight into the output.
+    if (!ReferenceStringArgument(arg, fragment)) {
+        std::stringstream buffer;
+        bool isHandled = ConvertAndFormatType(arg, fragment, buffer);
+        if (!isHandled) {
+            FormatType(arg, fragment.formatSpecifier, buffer);
+        }
+        // Set the text to use
+        fragment.text = buffer.str();
+    }
+
+#ifndef FORMAT_DISABLE_THROW_OUT_OF_RANGE
+    // Remember that we handled this fragment.
+    fragment.handled = true;
+#endif  // FORMAT_DISABLE_THROW_OUT_OF_RANGE
+}
+
 template <int ArgumentIndex, typename T>
 void FormatParameter(std::vector<FormatFragment>& fragments, const T& arg)
 {
     // Find all fragments that match this index and format them individually.
     for (FormatFragment& fragment : fragments) {
         if (fragment.index == ArgumentIndex) {
-            std::stringstream buffer;
-            bool isHandled = ConvertAndFormatType(arg, fragment, buffer);
-            if (!isHandled) {
-                FormatType(arg, fragment.formatSpecifier, buffer);
-            }
-            // Set the text to use
-            fragment.text = buffer.str();
-
-#ifndef FORMAT_DISABLE_THROW_OUT_OF_RANGE
-            // Remember that we handled this fragment.
-            fragment.handled = true;
-#endif  // FORMAT_DISABLE_THROW_OUT_OF_RANGE
+            FormatArgument(fragment, arg);
         }
     }
 }
@@ -752,6 +2233,17 @@ void FormatParameters(std::vector<FormatFragment>& fragments, T&& arg, Args&&...
 
 void OutputFragments(const std::vector<FormatFragment>& fragments, std::ostream& ostr);
 
+/**
+ * Joins the formatted fragments into the resulting string, the string is allocated once and every fragment, including
+ * the referenced string arguments, is copied straight into it.
+ *
+ * @param[in]  head  The text written before the first fragment.
+ * @param[in]  fragments  A vector of format fragments to join.
+ *
+ * @return Returns the formatted string.
+ */
+std::string JoinFragments(const std::string& head, const std::vector<FormatFragment>& fragments);
+
 //
 // Functions generally used for standard formatting of a format string
 //
@@ -765,8 +2257,7 @@ std::string Format(const char* formatStr, Args&&... args)
     if (!fragments.empty()) {
         FormatParameters<0>(fragments, args...);
     }
-    OutputFragments(fragments, ostr);
-    return ostr.str();
+    return JoinFragments(ostr.str(), fragments);
 }
 
 
@@ -0,0 +1,497 @@
+/*
+
+Copyright (c) 2014, Tommy Andersen
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "log.h"
+
+#include <exception>
+#include <istream>
+#include <sstream>
+#include <stdexcept>
+
+namespace utils {
+namespace str {
+
+namespace {
+
+/**
+ * Decodes a captured value of type @p T and formats it for every format fragment referring to it.
+ *
+ * @param[in,out]  fragments  The format fragments to format the value for.
+ * @param[in]  index  The argument index of the value.
+ * @param[in,out]  pos  The position of the captured value, following the type tag, it is moved past the value.
+ * @param[in]  end  The end of the captured arguments.
+ */
+template <typename T>
+void FormatCapturedValue(std::vector<FormatFragment>& fragments, int index, const char*& pos, const char* end)
+{
+    if (static_cast<std::size_t>(end - pos) < sizeof(T)) {
+        throw std::invalid_argument("Captured argument is truncated.");
+    }
+    T value;
+    std::memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+
+    for (FormatFragment& fragment : fragments) {
+        if (fragment.index == index) {
+            FormatArgument(fragment, value);
+        }
+    }
+}
+
+/**
+ * Decodes a captured string and formats it for every format fragment referring to it, the string is formatted as a
+ * StringSlice referring to the captured characters.
+ *
+ * @param[in,out]  fragments  The format fragments to format the string for.
+ * @param[in]  index  The argument index of the string.
+ * @param[in,out]  pos  The position of the captured string, following the type tag, it is moved past the string.
+ * @param[in]  end  The end of the captured arguments.
+ */
+void FormatCapturedString(std::vector<FormatFragment>& fragments, int index, const char*& pos, const char* end)
+{
+    std::uint32_t length;
+    if (static_cast<std::size_t>(end - pos) < sizeof(length)) {
+        throw std::invalid_argument("Captured argument is truncated.");
+    }
+    std::memcpy(&length, pos, sizeof(length));
+    pos += sizeof(length);
+    if (static_cast<std::size_t>(end - pos) < length) {
+        throw std::invalid_argument("Captured argument is truncated.");
+    }
+    StringSlice value(pos, length);
+    pos += length;
+
+    for (FormatFragment& fragment : fragments) {
+        if (fragment.index == index) {
+            FormatArgument(fragment, value);
+        }
+    }
+}
+
+/**
+ * The number of bytes of text DecodeBinaryLog collects before writing it to its output stream.
+ */
+const std::size_t DECODE_OUTPUT_SIZE = 64 * 1024;
+
+/**
+ * Returns the header written at the start of every binary log, it identifies the format, its version and the byte
+ * order and type sizes of the platform writing it.
+ */
+std::string GetBinaryLogHeader()
+{
+    const std::uint32_t byteOrder = 0x01020304;
+    std::string header("FMTLOG", 6);
+    header += static_cast<char>(1);
+    header += static_cast<char>(sizeof(bool));
+    header += static_cast<char>(sizeof(short));
+    header += static_cast<char>(sizeof(int));
+    header += static_cast<char>(sizeof(long));
+    header += static_cast<char>(sizeof(long long));
+    header += static_cast<char>(sizeof(float));
+    header += static_cast<char>(sizeof(double));
+    header += static_cast<char>(sizeof(long double));
+    header.append(reinterpret_cast<const char*>(&byteOrder), sizeof(byteOrder));
+    return header;
+}
+
+/**
+ * Reads @p size bytes of a binary log.
+ *
+ * @param[in]  input  The binary log.
+ * @param[out]  destination  The memory to read to.
+ * @param[in]  size  The number of bytes to read.
+ *
+ * @throws std::runtime_error  If the binary log ends before @p size bytes are read.
+ */
+void ReadBinaryLog(std::istream& input, void* destination, std::size_t size)
+{
+    if (!input.read(static_cast<char*>(destination), static_cast<std::streamsize>(size))) {
+        throw std::runtime_error("The binary log is truncated.");
+    }
+}
+
+}
+
+void ParseFormat(const char* formatStr, ParsedFormat& format)
+{
+    std::stringstream head;
+    format.fragments.clear();
+    ParseFormatStr(formatStr, head, format.fragments);
+    format.head = head.str();
+}
+
+void FormatRecord(const ParsedFormat& format, const char* arguments, std::size_t size, std::string& sink)
+{
+    // The fragments hold the formatted text of the arguments, so every record needs its own copy.
+    std::vector<FormatFragment> fragments(format.fragments);
+    const char* pos = arguments;
+    const char* end = arguments + size;
+    for (int index = 0; pos < end; ++index) {
+        switch (static_cast<ArgumentType>(*pos++)) {
+            case ArgumentType::Bool:
+                FormatCapturedValue<bool>(fragments, index, pos, end);
+                break;
+            case ArgumentType::Char:
+                FormatCapturedValue<char>(fragments, index, pos, end);
+                break;
+            case ArgumentType::SignedChar:
+                FormatCapturedValue<signed char>(fragments, index, pos, end);
+                break;
+            case ArgumentType::UnsignedChar:
+                FormatCapturedValue<unsigned char>(fragments, index, pos, end);
+                break;
+            case ArgumentType::Short:
+                FormatCapturedValue<short>(fragments, index, pos, end);
+                break;
+            case ArgumentType::UnsignedShort:
+                FormatCapturedValue<unsigned short>(fragments, index, pos, end);
+                break;
+            case ArgumentType::Int:
+                FormatCapturedValue<int>(fragments, index, pos, end);
+                break;
+            case ArgumentType::UnsignedInt:
+                FormatCapturedValue<unsigned int>(fragments, index, pos, end);
+                break;
+            case ArgumentType::Long:
+                FormatCapturedValue<long>(fragments, index, pos, end);
+                break;
+            case ArgumentType::UnsignedLong:
+                FormatCapturedValue<unsigned long>(fragments, index, pos, end);
+                break;
+            case ArgumentType::LongLong:
+                FormatCapturedValue<long long>(fragments, index, pos, end);
+                break;
+            case ArgumentType::UnsignedLongLong:
+                FormatCapturedValue<unsigned long long>(fragments, index, pos, end);
+                break;
+#ifdef FORMAT_HAS_INT128
+            case ArgumentType::Int128:
+                FormatCapturedValue<__int128>(fragments, index, pos, end);
+                break;
+            case ArgumentType::UnsignedInt128:
+                FormatCapturedValue<unsigned __int128>(fragments, index, pos, end);
+                break;
+#endif  // FORMAT_HAS_INT128
+            case ArgumentType::Float:
+                FormatCapturedValue<float>(fragments, index, pos, end);
+                break;
+            case ArgumentType::Double:
+                FormatCapturedValue<double>(fragments, index, pos, end);
+                break;
+            case ArgumentType::LongDouble:
+                FormatCapturedValue<long double>(fragments, index, pos, end);
+                break;
+            case ArgumentType::String:
+                FormatCapturedString(fragments, index, pos, end);
+                break;
+            default:
+                throw std::invalid_argument("Unknown type of captured argument.");
+        }
+    }
+    sink += JoinFragments(format.head, fragments);
+}
+
+DeferredLog::DeferredLog(std::ostream& sink, std::size_t capacity)
+    : sink(sink),
+      buffer(capacity),
+      pending(capacity),
+      used(0),
+      loggedCount(0),
+      writtenCount(0),
+      stopping(false)
+{
+    thread = std::thread(&DeferredLog::Run, this);
+}
+
+DeferredLog::~DeferredLog()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    logged.notify_one();
+    thread.join();
+}
+
+void DeferredLog::Flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    const std::uint64_t target = loggedCount;
+    written.wait(lock, [&] { return writtenCount >= target; });
+}
+
+/**
+ * Reserves room for a record of @p size bytes at the end of the buffer, waiting for the background thread to take
+ * the buffered records if there is not enough room.  Records larger than the capacity grow the buffer.
+ *
+ * @param[in]  lock  The lock held on the mutex of the log.
+ * @param[in]  size  The size of the record in bytes.
+ *
+ * @return Returns a pointer to the reserved room.
+ */
+char* DeferredLog::Reserve(std::unique_lock<std::mutex>& lock, std::size_t size)
+{
+    if (used + size > buffer.size()) {
+        written.wait(lock, [&] { return used == 0; });
+        if (size > buffer.size()) {
+            buffer.resize(size);
+        }
+    }
+    if (used == 0) {
+        logged.notify_one();
+    }
+    char* record = buffer.data() + used;
+    used += size;
+    ++loggedCount;
+    return record;
+}
+
+/**
+ * The background thread, it swaps the buffer of captured records with an empty one whenever records are logged, and
+ * writes them to the sink.
+ */
+void DeferredLog::Run()
+{
+    std::string output;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        logged.wait(lock, [&] { return used > 0 || stopping; });
+        if (used == 0) {
+            break;
+        }
+
+        const std::size_t size = used;
+        const std::uint64_t count = loggedCount;
+        buffer.swap(pending);
+        if (buffer.size() < pending.size()) {
+            buffer.resize(pending.size());
+        }
+        used = 0;
+        written.notify_all();
+        lock.unlock();
+
+        output.clear();
+        WriteRecords(pending.data(), size, output);
+        sink.write(output.data(), static_cast<std::streamsize>(output.size()));
+        sink.flush();
+
+        lock.lock();
+        writtenCount = count;
+        written.notify_all();
+    }
+}
+
+/**
+ * Formats the records of a buffer, appending their text to @p output.
+ *
+ * @param[in]  records  The captured records.
+ * @param[in]  size  The size of the captured records in bytes.
+ * @param[out]  output  The string to append the formatted text to.
+ */
+void DeferredLog::WriteRecords(const char* records, std::size_t size, std::string& output)
+{
+    const char* pos = records;
+    const char* end = records + size;
+    while (pos < end) {
+        const char* formatStr;
+        std::uint32_t argumentsSize;
+        std::memcpy(&formatStr, pos, sizeof(formatStr));
+        std::memcpy(&argumentsSize, pos + sizeof(formatStr), sizeof(argumentsSize));
+        const char* arguments = pos + sizeof(formatStr) + sizeof(argumentsSize);
+        pos = arguments + argumentsSize;
+
+        try {
+            auto format = formats.find(formatStr);
+            if (format == formats.end()) {
+                format = formats.emplace(formatStr, ParsedFormat()).first;
+                try {
+                    ParseFormat(formatStr, format->second);
+                }
+                catch (...) {
+                    formats.erase(format);
+                    throw;
+                }
+            }
+            FormatRecord(format->second, arguments, argumentsSize, output);
+        }
+        catch (const std::exception& e) {
+            output += e.what();
+        }
+    }
+}
+
+BinaryLog::BinaryLog(std::ostream& output, std::size_t capacity)
+    : output(output),
+      buffer(capacity),
+      used(0)
+{
+    const std::string header = GetBinaryLogHeader();
+    output.write(header.data(), static_cast<std::streamsize>(header.size()));
+}
+
+BinaryLog::~BinaryLog()
+{
+    WriteBuffer();
+    output.flush();
+}
+
+void BinaryLog::Flush()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    WriteBuffer();
+    output.flush();
+}
+
+/**
+ * Returns the ID of a format string, the format string is written to the log the first time it is used.
+ *
+ * @param[in]  formatStr  The format string.
+ *
+ * @return Returns the ID of the format string.
+ */
+std::uint32_t BinaryLog::GetFormatId(const char* formatStr)
+{
+    auto formatId = formatIds.find(formatStr);
+    if (formatId != formatIds.end()) {
+        return formatId->second;
+    }
+
+    const std::uint32_t id = static_cast<std::uint32_t>(formatIds.size());
+    const std::uint32_t length = GetEncodedLength(std::strlen(formatStr));
+    char* entry = Reserve(1 + sizeof(id) + sizeof(length) + length);
+    *entry++ = static_cast<char>(BinaryLogEntry::Format);
+    std::memcpy(entry, &id, sizeof(id));
+    std::memcpy(entry + sizeof(id), &length, sizeof(length));
+    std::memcpy(entry + sizeof(id) + sizeof(length), formatStr, length);
+    formatIds.emplace(formatStr, id);
+    return id;
+}
+
+/**
+ * Reserves room for an entry of @p size bytes at the end of the buffer, writing the buffer to the output stream if
+ * there is not enough room.  Entries larger than the capacity grow the buffer.
+ *
+ * @param[in]  size  The size of the entry in bytes.
+ *
+ * @return Returns a pointer to the reserved room.
+ */
+char* BinaryLog::Reserve(std::size_t size)
+{
+    if (used + size > buffer.size()) {
+        WriteBuffer();
+        if (size > buffer.size()) {
+            buffer.resize(size);
+        }
+    }
+    char* entry = buffer.data() + used;
+    used += size;
+    return entry;
+}
+
+/**
+ * Writes the buffered entries to the output stream.
+ */
+void BinaryLog::WriteBuffer()
+{
+    output.write(buffer.data(), static_cast<std::streamsize>(used));
+    used = 0;
+}
+
+void DecodeBinaryLog(std::istream& input, std::ostream& output)
+{
+    const std::string expectedHeader = GetBinaryLogHeader();
+    std::string header(expectedHeader.size(), '\0');
+    ReadBinaryLog(input, &header[0], header.size());
+    if (header.compare(0, 6, expectedHeader, 0, 6) != 0) {
+        throw std::runtime_error("The input is not a binary log.");
+    }
+    if (header != expectedHeader) {
+        throw std::runtime_error("The binary log was written by another version, or on a platform with another byte "
+                                 "order or other type sizes.");
+    }
+
+    std::vector<std::string> formatStrings;
+    std::vector<ParsedFormat> formats;
+    std::vector<bool> isParsed;
+    std::vector<char> arguments;
+    std::string text;
+    char kind;
+    try {
+        while (input.get(kind)) {
+            std::uint32_t id;
+            std::uint32_t size;
+            ReadBinaryLog(input, &id, sizeof(id));
+            ReadBinaryLog(input, &size, sizeof(size));
+
+            if (kind == static_cast<char>(BinaryLogEntry::Format)) {
+                if (id != formatStrings.size()) {
+                    throw std::runtime_error("The binary log defines its format strings out of order.");
+                }
+                formatStrings.push_back(std::string(size, '\0'));
+                ReadBinaryLog(input, &formatStrings.back()[0], size);
+                formats.push_back(ParsedFormat());
+                isParsed.push_back(false);
+                continue;
+            }
+            if (kind != static_cast<char>(BinaryLogEntry::Message)) {
+                throw std::runtime_error("The binary log contains an unknown kind of entry.");
+            }
+            if (id >= formats.size()) {
+                throw std::runtime_error("The binary log refers to an undefined format string.");
+            }
+
+            arguments.resize(size);
+            ReadBinaryLog(input, arguments.data(), size);
+            try {
+                // Format strings are parsed the first time they are used, so an illegal one only affects its messages.
+                if (!isParsed[id]) {
+                    ParseFormat(formatStrings[id].c_str(), formats[id]);
+                    isParsed[id] = true;
+                }
+                FormatRecord(formats[id], arguments.data(), size, text);
+            }
+            catch (const std::exception& e) {
+                text += e.what();
+            }
+
+            if (text.size() >= DECODE_OUTPUT_SIZE) {
+                output.write(text.data(), static_cast<std::streamsize>(text.size()));
+                text.clear();
+            }
+        }
+    }
+    catch (...) {
+        // A truncated or malformed log still gives the messages decoded before the error.
+        output.write(text.data(), static_cast<std::streamsize>(text.size()));
+        throw;
+    }
+    output.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+}
+}
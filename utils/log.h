@@ -0,0 +1,506 @@
+#ifndef UTILS_STR_LOG_H_
+#define UTILS_STR_LOG_H_
+
+/*
+
+Copyright (c) 2014, Tommy Andersen
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "format.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// The macro FORMAT_LOG_BUFFER_SIZE is the default number of bytes a DeferredLog buffers before producers have to wait
+// for the background thread to catch up, and the default number of bytes a BinaryLog buffers before writing them.
+#ifndef FORMAT_LOG_BUFFER_SIZE
+#  define FORMAT_LOG_BUFFER_SIZE (1024 * 1024)
+#endif  // FORMAT_LOG_BUFFER_SIZE
+
+namespace utils {
+namespace str {
+
+//
+// Encoding of arguments
+//
+
+/**
+ * The type tag written in front of every captured argument.  Values are captured with their exact type, so the
+ * formatting of the decoded value picks the same overloads as formatting the original value would.  Strings of any
+ * kind are captured as their characters and decoded as a StringSlice.
+ */
+enum class ArgumentType : unsigned char
+{
+    Bool,
+    Char,
+    SignedChar,
+    UnsignedChar,
+    Short,
+    UnsignedShort,
+    Int,
+    UnsignedInt,
+    Long,
+    UnsignedLong,
+    LongLong,
+    UnsignedLongLong,
+    Int128,
+    UnsignedInt128,
+    Float,
+    Double,
+    LongDouble,
+    String
+};
+
+namespace helper {
+
+/**
+ * Maps the types captured by their raw bytes to their type tag, isValue is false for any other type.
+ */
+template <typename T>
+struct ArgumentTraits
+{
+    static const bool isValue = false;
+};
+
+template <typename T, ArgumentType Type>
+struct ValueArgumentTraits
+{
+    static const bool isValue = true;
+    static const ArgumentType type = Type;
+};
+
+template <> struct ArgumentTraits<bool> : ValueArgumentTraits<bool, ArgumentType::Bool> {};
+template <> struct ArgumentTraits<char> : ValueArgumentTraits<char, ArgumentType::Char> {};
+template <> struct ArgumentTraits<signed char> : ValueArgumentTraits<signed char, ArgumentType::SignedChar> {};
+template <> struct ArgumentTraits<unsigned char> : ValueArgumentTraits<unsigned char, ArgumentType::UnsignedChar> {};
+template <> struct ArgumentTraits<short> : ValueArgumentTraits<short, ArgumentType::Short> {};
+template <> struct ArgumentTraits<unsigned short>
+    : ValueArgumentTraits<unsigned short, ArgumentType::UnsignedShort> {};
+template <> struct ArgumentTraits<int> : ValueArgumentTraits<int, ArgumentType::Int> {};
+template <> struct ArgumentTraits<unsigned int> : ValueArgumentTraits<unsigned int, ArgumentType::UnsignedInt> {};
+template <> struct ArgumentTraits<long> : ValueArgumentTraits<long, ArgumentType::Long> {};
+template <> struct ArgumentTraits<unsigned long> : ValueArgumentTraits<unsigned long, ArgumentType::UnsignedLong> {};
+template <> struct ArgumentTraits<long long> : ValueArgumentTraits<long long, ArgumentType::LongLong> {};
+template <> struct ArgumentTraits<unsigned long long>
+    : ValueArgumentTraits<unsigned long long, ArgumentType::UnsignedLongLong> {};
+#ifdef FORMAT_HAS_INT128
+template <> struct ArgumentTraits<__int128> : ValueArgumentTraits<__int128, ArgumentType::Int128> {};
+template <> struct ArgumentTraits<unsigned __int128>
+    : ValueArgumentTraits<unsigned __int128, ArgumentType::UnsignedInt128> {};
+#endif  // FORMAT_HAS_INT128
+template <> struct ArgumentTraits<float> : ValueArgumentTraits<float, ArgumentType::Float> {};
+template <> struct ArgumentTraits<double> : ValueArgumentTraits<double, ArgumentType::Double> {};
+template <> struct ArgumentTraits<long double> : ValueArgumentTraits<long double, ArgumentType::LongDouble> {};
+
+}
+
+/**
+ * Converts the length of a captured string, or the size of captured arguments, to the 32-bit size it is stored as.
+ *
+ * @param[in]  size  The length or size in bytes.
+ *
+ * @return Returns @p size as a 32-bit size.
+ *
+ * @throws std::length_error  If @p size is 4 GiB or more, and does not fit in 32 bits.
+ */
+inline std::uint32_t GetEncodedLength(std::size_t size)
+{
+    if (size > std::numeric_limits<std::uint32_t>::max()) {
+        throw std::length_error("A captured string or message of 4 GiB or more cannot be logged.");
+    }
+    return static_cast<std::uint32_t>(size);
+}
+
+/**
+ * Returns the number of bytes an argument takes up when captured, including its type tag.  Only numbers, booleans,
+ * characters and strings can be captured, as every other type would have to be copied as a whole.
+ *
+ * @param[in]  value  The argument to capture.
+ *
+ * @return Returns the size of the captured argument in bytes.
+ *
+ * @throws std::length_error  If a string argument is 4 GiB or longer, see GetEncodedLength.
+ */
+template <typename T>
+typename std::enable_if<helper::ArgumentTraits<T>::isValue, std::size_t>::type
+GetEncodedSize(const T&)
+{
+    return 1 + sizeof(T);
+}
+
+template <typename T>
+typename std::enable_if<!helper::ArgumentTraits<T>::isValue, std::size_t>::type
+GetEncodedSize(const T&)
+{
+    static_assert(sizeof(T) == 0, "Only numbers, booleans, characters and strings can be captured for later formatting.");
+    return 0;
+}
+
+inline std::size_t GetEncodedSize(StringSlice value)
+{
+    return 1 + sizeof(std::uint32_t) + GetEncodedLength(value.size);
+}
+
+inline std::size_t GetEncodedSize(const char* value)
+{
+    return GetEncodedSize(StringSlice(value, std::strlen(value)));
+}
+
+inline std::size_t GetEncodedSize(char* value)
+{
+    return GetEncodedSize(static_cast<const char*>(value));
+}
+
+inline std::size_t GetEncodedSize(const std::string& value)
+{
+    return GetEncodedSize(StringSlice(value));
+}
+
+#ifdef FORMAT_HAS_STRING_VIEW
+inline std::size_t GetEncodedSize(std::string_view value)
+{
+    return GetEncodedSize(StringSlice(value));
+}
+#endif  // FORMAT_HAS_STRING_VIEW
+
+inline std::size_t GetEncodedArgumentsSize()
+{
+    return 0;
+}
+
+template <typename T, typename... Args>
+std::size_t GetEncodedArgumentsSize(const T& arg, const Args&... args)
+{
+    return GetEncodedSize(arg) + GetEncodedArgumentsSize(args...);
+}
+
+/**
+ * Captures an argument by writing its type tag followed by its raw bytes, strings are written as their length
+ * followed by their characters.  The destination must have room for GetEncodedSize(value) bytes.
+ *
+ * @param[out]  destination  The memory to write the captured argument to.
+ * @param[in]  value  The argument to capture.
+ *
+ * @return Returns a pointer to the byte following the captured argument.
+ */
+template <typename T>
+typename std::enable_if<helper::ArgumentTraits<T>::isValue, char*>::type
+EncodeArgument(char* destination, const T& value)
+{
+    *destination++ = static_cast<char>(helper::ArgumentTraits<T>::type);
+    std::memcpy(destination, &value, sizeof(T));
+    return destination + sizeof(T);
+}
+
+inline char* EncodeArgument(char* destination, StringSlice value)
+{
+    // The length is checked by GetEncodedSize, before any room is reserved for the record.
+    const std::uint32_t length = static_cast<std::uint32_t>(value.size);
+    *destination++ = static_cast<char>(ArgumentType::String);
+    std::memcpy(destination, &length, sizeof(length));
+    destination += sizeof(length);
+    std::memcpy(destination, value.data, value.size);
+    return destination + value.size;
+}
+
+inline char* EncodeArgument(char* destination, const char* value)
+{
+    return EncodeArgument(destination, StringSlice(value, std::strlen(value)));
+}
+
+inline char* EncodeArgument(char* destination, char* value)
+{
+    return EncodeArgument(destination, static_cast<const char*>(value));
+}
+
+inline char* EncodeArgument(char* destination, const std::string& value)
+{
+    return EncodeArgument(destination, StringSlice(value));
+}
+
+#ifdef FORMAT_HAS_STRING_VIEW
+inline char* EncodeArgument(char* destination, std::string_view value)
+{
+    return EncodeArgument(destination, StringSlice(value));
+}
+#endif  // FORMAT_HAS_STRING_VIEW
+
+inline char* EncodeArguments(char* destination)
+{
+    return destination;
+}
+
+template <typename T, typename... Args>
+char* EncodeArguments(char* destination, const T& arg, const Args&... args)
+{
+    return EncodeArguments(EncodeArgument(destination, arg), args...);
+}
+
+//
+// Formatting of captured arguments
+//
+
+/**
+ * A format string parsed once, so it can be used for any number of captured records without parsing it again.  Note
+ * that environment variables in the format string are replaced when it is parsed.
+ */
+struct ParsedFormat
+{
+    /**
+     * The text written before the first format fragment.
+     */
+    std::string head;
+
+    /**
+     * The format fragments of the format string, as returned by ParseFormatStr.
+     */
+    std::vector<FormatFragment> fragments;
+};
+
+/**
+ * Parses a format string for formatting captured arguments, see FormatRecord.
+ *
+ * @param[in]  formatStr  The format string to parse.
+ * @param[out]  format  The parsed format string.
+ */
+void ParseFormat(const char* formatStr, ParsedFormat& format);
+
+/**
+ * Formats captured arguments using a parsed format string, the result is the same as calling Format with the format
+ * string and the original arguments.
+ *
+ * @param[in]  format  The parsed format string.
+ * @param[in]  arguments  The captured arguments, as written by EncodeArguments.
+ * @param[in]  size  The number of bytes of captured arguments.
+ * @param[out]  sink  The string to append the formatted text to.
+ *
+ * @throws std::invalid_argument  If the captured arguments are malformed.
+ */
+void FormatRecord(const ParsedFormat& format, const char* arguments, std::size_t size, std::string& sink);
+
+//
+// Deferred formatting
+//
+
+/**
+ * A log formatting its messages on a background thread.  Calling Log only copies the arguments into a buffer, the
+ * formatting and the writing to the sink is done by the background thread, in the order the messages were logged.
+ * The text written for every message is identical to the text returned by Format for the same format string and
+ * arguments, no line breaks are added.
+ *
+ * Format strings are remembered by their address, so they must stay valid, and unchanged, for the lifetime of the
+ * log, this is the case for string literals.  Every format string is parsed once, the first time it is formatted.
+ *
+ * If formatting a message throws an exception, the message of the exception is written in place of the message.
+ */
+class DeferredLog
+{
+public:
+    /**
+     * Constructs a log writing to @p sink and starts its background thread.
+     *
+     * @param[in]  sink  The output stream to write messages to, it is only used by the background thread.
+     * @param[in]  capacity  The number of bytes of captured messages buffered before Log waits for the background
+     *                       thread to catch up.
+     */
+    explicit DeferredLog(std::ostream& sink, std::size_t capacity = FORMAT_LOG_BUFFER_SIZE);
+
+    /**
+     * Writes all logged messages and stops the background thread.
+     */
+    ~DeferredLog();
+
+    DeferredLog(const DeferredLog&) = delete;
+    DeferredLog& operator=(const DeferredLog&) = delete;
+
+    /**
+     * Logs a message, the arguments are captured by value and formatted later on the background thread.
+     *
+     * @param[in]  formatStr  The format string, it must outlive the log.
+     * @param[in]  args  The arguments, only numbers, booleans, characters and strings are supported.
+     *
+     * @throws std::length_error  If a string, or all arguments together, take up 4 GiB or more, nothing is logged.
+     */
+    template <typename... Args>
+    void Log(const char* formatStr, const Args&... args)
+    {
+        const std::size_t argumentsSize = GetEncodedArgumentsSize(args...);
+        const std::size_t size = sizeof(formatStr) + sizeof(std::uint32_t) + argumentsSize;
+        const std::uint32_t encodedSize = GetEncodedLength(argumentsSize);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        char* record = Reserve(lock, size);
+        std::memcpy(record, &formatStr, sizeof(formatStr));
+        std::memcpy(record + sizeof(formatStr), &encodedSize, sizeof(encodedSize));
+        EncodeArguments(record + sizeof(formatStr) + sizeof(encodedSize), args...);
+    }
+
+    /**
+     * Waits until every message logged before the call is written to the sink, and the sink is flushed.
+     */
+    void Flush();
+
+private:
+    char* Reserve(std::unique_lock<std::mutex>& lock, std::size_t size);
+    void Run();
+    void WriteRecords(const char* records, std::size_t size, std::string& output);
+
+    std::ostream& sink;
+    std::mutex mutex;
+    std::condition_variable logged;
+    std::condition_variable written;
+    std::vector<char> buffer;
+    std::vector<char> pending;
+    std::size_t used;
+    std::uint64_t loggedCount;
+    std::uint64_t writtenCount;
+    bool stopping;
+    std::unordered_map<const char*, ParsedFormat> formats;
+    std::thread thread;
+};
+
+//
+// Binary logging
+//
+
+/**
+ * The kinds of entries in a binary log, see BinaryLog.
+ */
+enum class BinaryLogEntry : unsigned char
+{
+    /**
+     * A format string, followed by its 32-bit format ID, its 32-bit length and its characters.
+     */
+    Format,
+
+    /**
+     * A logged message, followed by the 32-bit ID of its format string, the 32-bit size of its captured arguments
+     * and the captured arguments.
+     */
+    Message
+};
+
+/**
+ * A log writing its messages in binary form, leaving all formatting to DecodeBinaryLog, which may run later and on
+ * another machine.  Every message is written as the ID of its format string followed by its captured arguments, see
+ * EncodeArguments, and every format string is written once, in front of the first message using it.
+ *
+ * The log starts with a header identifying the byte order and type sizes of the platform, the log can only be decoded
+ * on a platform where these are the same.  Format strings are remembered by their address, so they must stay valid,
+ * and unchanged, for the lifetime of the log, this is the case for string literals.
+ *
+ * Messages are collected in a buffer.  There is no background thread: the buffer is written to the output stream
+ * synchronously, by the thread calling Log when the message does not fit, and by Flush and the destructor.  Log and
+ * Flush write while holding the lock of the log, so other threads logging at the same time wait for the write.
+ */
+class BinaryLog
+{
+public:
+    /**
+     * Constructs a log writing to @p output, the header of the log is written immediately.
+     *
+     * @param[in]  output  The output stream to write the log to, it should be opened in binary mode.
+     * @param[in]  capacity  The number of bytes of messages buffered before they are written to @p output.
+     */
+    explicit BinaryLog(std::ostream& output, std::size_t capacity = FORMAT_LOG_BUFFER_SIZE);
+
+    /**
+     * Writes all buffered messages to the output stream and flushes it.
+     */
+    ~BinaryLog();
+
+    BinaryLog(const BinaryLog&) = delete;
+    BinaryLog& operator=(const BinaryLog&) = delete;
+
+    /**
+     * Logs a message, the arguments are captured by value and written along with the ID of the format string.
+     *
+     * @param[in]  formatStr  The format string, it must outlive the log.
+     * @param[in]  args  The arguments, only numbers, booleans, characters and strings are supported.
+     *
+     * @throws std::length_error  If a string, or all arguments together, take up 4 GiB or more, nothing is logged.
+     */
+    template <typename... Args>
+    void Log(const char* formatStr, const Args&... args)
+    {
+        const std::size_t argumentsSize = GetEncodedArgumentsSize(args...);
+        const std::uint32_t encodedSize = GetEncodedLength(argumentsSize);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        const std::uint32_t id = GetFormatId(formatStr);
+        char* record = Reserve(1 + sizeof(id) + sizeof(encodedSize) + argumentsSize);
+        *record++ = static_cast<char>(BinaryLogEntry::Message);
+        std::memcpy(record, &id, sizeof(id));
+        std::memcpy(record + sizeof(id), &encodedSize, sizeof(encodedSize));
+        EncodeArguments(record + sizeof(id) + sizeof(encodedSize), args...);
+    }
+
+    /**
+     * Writes all buffered messages to the output stream and flushes it.
+     */
+    void Flush();
+
+private:
+    std::uint32_t GetFormatId(const char* formatStr);
+    char* Reserve(std::size_t size);
+    void WriteBuffer();
+
+    std::ostream& output;
+    std::mutex mutex;
+    std::vector<char> buffer;
+    std::size_t used;
+    std::unordered_map<const char*, std::uint32_t> formatIds;
+};
+
+/**
+ * Decodes a log written by BinaryLog, writing the text of every message to @p output.  The text of a message is the
+ * same as the text returned by Format for its format string and arguments, no line breaks are added.  If formatting
+ * a message throws an exception, the message of the exception is written in place of the message.  If the log is
+ * malformed, for instance truncated in the middle of an entry, the messages decoded before are written to @p output
+ * before the exception is thrown.
+ *
+ * @param[in]  input  The binary log to decode, it should be opened in binary mode.
+ * @param[out]  output  The output stream to write the messages to.
+ *
+ * @throws std::runtime_error  If @p input is not a binary log, if it was written on an incompatible platform, or if
+ *                             it is malformed.
+ */
+void DecodeBinaryLog(std::istream& input, std::ostream& output);
+
+}
+}
+
+#endif  /* UTILS_STR_LOG_H_ */